@@ -0,0 +1,102 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "algorithms/bounded-mean.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+
+namespace differential_privacy {
+namespace {
+
+// The base class of an algorithm class template instance.
+template <typename Algorithm>
+struct AlgorithmBase;
+
+template <template <typename> class Algorithm, typename T>
+struct AlgorithmBase<Algorithm<T>> {
+  using Type = differential_privacy::Algorithm<T>;
+};
+
+// Sets the parameters shared by all partitions, with manual bounds for the
+// bounded algorithms.
+template <typename Algorithm>
+void Configure(typename Algorithm::Builder& builder) {
+  builder.SetEpsilon(1.0).SetMaxPartitionsContributed(4);
+  if constexpr (!std::is_same<Algorithm, Count<int64_t>>::value) {
+    builder.SetLower(0).SetUpper(10);
+  }
+}
+
+// Construction time and memory of one algorithm per partition, all alive at
+// the same time, as when aggregating many partitions with identical
+// parameters. The first argument is the number of partitions. The second is 0
+// to build every algorithm with the same builder, and 1 to build one prototype
+// and clone every algorithm from it with CloneEmpty(). Memory is reported by
+// MemoryUsed().
+template <typename Algorithm>
+void BM_BuildPartitions(benchmark::State& state) {
+  const int64_t num_partitions = state.range(0);
+  const bool clone = state.range(1);
+  typename Algorithm::Builder builder;
+  Configure<Algorithm>(builder);
+  std::unique_ptr<Algorithm> prototype = builder.Build().ValueOrDie();
+  std::vector<std::unique_ptr<typename AlgorithmBase<Algorithm>::Type>>
+      algorithms;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    algorithms.clear();
+    algorithms.reserve(num_partitions);
+    state.ResumeTiming();
+
+    for (int64_t i = 0; i < num_partitions; ++i) {
+      if (clone) {
+        algorithms.push_back(prototype->CloneEmpty().ValueOrDie());
+      } else {
+        algorithms.push_back(builder.Build().ValueOrDie());
+      }
+    }
+  }
+
+  int64_t total_bytes = 0;
+  for (const auto& algorithm : algorithms) {
+    total_bytes += algorithm->MemoryUsed();
+  }
+  state.SetItemsProcessed(state.iterations() * num_partitions);
+  state.counters["bytes_per_partition"] =
+      static_cast<double>(total_bytes) / num_partitions;
+}
+
+void PartitionArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"partitions", "clone"})
+      ->ArgsProduct({{1 << 20}, {0, 1}})
+      ->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK_TEMPLATE(BM_BuildPartitions, Count<int64_t>)->Apply(PartitionArgs);
+BENCHMARK_TEMPLATE(BM_BuildPartitions, BoundedSum<double>)
+    ->Apply(PartitionArgs);
+BENCHMARK_TEMPLATE(BM_BuildPartitions, BoundedMean<double>)
+    ->Apply(PartitionArgs);
+
+}  // namespace
+}  // namespace differential_privacy
@@ -21,8 +21,11 @@
 #include <iterator>
 #include <memory>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/types/span.h"
 #include "base/status.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/util.h"
@@ -39,6 +42,22 @@ namespace differential_privacy {
 constexpr double kDefaultDelta = 0.0;
 constexpr double kDefaultConfidenceLevel = .95;
 
+namespace internal {
+
+// Whether Iterator points into contiguous storage of T.
+template <typename Iterator, typename T>
+struct IsContiguousIterator
+    : std::integral_constant<
+          bool,
+          std::is_same<Iterator, T*>::value ||
+              std::is_same<Iterator, const T*>::value ||
+              std::is_same<Iterator,
+                           typename std::vector<T>::iterator>::value ||
+              std::is_same<Iterator,
+                           typename std::vector<T>::const_iterator>::value> {};
+
+}  // namespace internal
+
 // Abstract superclass for differentially private algorithms.
 //
 // Includes a notion of privacy budget in addition to epsilon to allow for
@@ -66,11 +85,27 @@ class Algorithm {
   // Adds one input to the algorithm.
   virtual void AddEntry(const T& t) = 0;
 
-  // Adds multiple inputs to the algorithm.
+  // Adds multiple inputs to the algorithm. Algorithms override this to process
+  // contiguous inputs in bulk. Subclasses that override it should also add
+  // `using Algorithm<T>::AddEntries;` so that the iterator overload stays
+  // visible.
+  virtual void AddEntries(absl::Span<const T> entries) {
+    for (const T& entry : entries) {
+      AddEntry(entry);
+    }
+  }
+
+  // Adds multiple inputs to the algorithm. Ranges of contiguous T, e.g., from a
+  // std::vector<T>, are passed to AddEntries(absl::Span<const T>).
   template <typename Iterator>
   void AddEntries(Iterator begin, Iterator end) {
-    for (auto it = begin; it != end; ++it) {
-      AddEntry(*it);
+    if constexpr (internal::IsContiguousIterator<Iterator, T>::value) {
+      if (begin == end) return;
+      AddEntries(absl::Span<const T>(&*begin, std::distance(begin, end)));
+    } else {
+      for (auto it = begin; it != end; ++it) {
+        AddEntry(*it);
+      }
     }
   }
 
@@ -163,6 +198,21 @@ class Algorithm {
 
   virtual double GetEpsilon() const { return epsilon_; }
 
+  // Returns a new algorithm with the parameters of this one, in the state of a
+  // newly built algorithm: without input and with the full privacy budget. It
+  // shares the immutable state of this algorithm, e.g. its mechanisms, instead
+  // of validating the parameters and building that state again, so that this
+  // is much cheaper than Builder::Build() when building one algorithm per
+  // partition from a prototype. Only reads this algorithm, so it may be called
+  // concurrently.
+  //
+  // By default, CloneEmpty() returns an error. Algorithms that support it
+  // override it.
+  virtual base::StatusOr<std::unique_ptr<Algorithm<T>>> CloneEmpty() const {
+    return base::UnimplementedError(
+        "CloneEmpty() unsupported for this algorithm");
+  }
+
  protected:
   // Returns the result of the algorithm when run on all the input that has been
   // provided via AddEntr[y|ies] since the last call to Reset.
@@ -224,6 +274,7 @@ class AlgorithmBuilder {
   Builder& SetLaplaceMechanism(
       std::unique_ptr<NumericalMechanismBuilder> mechanism_builder) {
     mechanism_builder_ = std::move(mechanism_builder);
+    shared_mechanism_builder_.reset();
     return *static_cast<Builder*>(this);
   }
 
@@ -237,6 +288,10 @@ class AlgorithmBuilder {
   std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
       absl::make_unique<LaplaceMechanism::Builder>();
 
+  // Copy of the mechanism builder shared by the algorithms built by this
+  // builder. Made on first use, and dropped when the mechanism builder is set.
+  std::shared_ptr<const NumericalMechanismBuilder> shared_mechanism_builder_;
+
  protected:
   absl::optional<double> GetEpsilon() const { return epsilon_; }
   absl::optional<double> GetDelta() const { return delta_; }
@@ -251,11 +306,29 @@ class AlgorithmBuilder {
     return mechanism_builder_->Clone();
   }
 
+  // Returns an immutable copy of the mechanism builder, which all algorithms
+  // built by this builder share to build mechanisms after they are built.
+  std::shared_ptr<const NumericalMechanismBuilder> GetSharedMechanismBuilder() {
+    if (shared_mechanism_builder_ == nullptr) {
+      shared_mechanism_builder_ = mechanism_builder_->Clone();
+    }
+    return shared_mechanism_builder_;
+  }
+
   virtual base::StatusOr<std::unique_ptr<Algorithm>> BuildAlgorithm() = 0;
 
-  base::StatusOr<std::unique_ptr<NumericalMechanism>>
+  // Returns the mechanism for the parameters of the builder. Mechanisms are
+  // immutable, so algorithms with the same parameters share one mechanism.
+  base::StatusOr<std::shared_ptr<NumericalMechanism>>
   UpdateAndBuildMechanism() {
-    auto clone = mechanism_builder_->Clone();
+    return UpdateAndBuildMechanism(mechanism_builder_->Clone());
+  }
+
+  // Same as above, but builds the mechanism with clone, a copy of the
+  // mechanism builder that the caller may have modified, instead of a new copy.
+  // The mechanism builder of this builder is left unchanged.
+  base::StatusOr<std::shared_ptr<NumericalMechanism>> UpdateAndBuildMechanism(
+      std::unique_ptr<NumericalMechanismBuilder> clone) {
     if (epsilon_.has_value()) {
       clone->SetEpsilon(epsilon_.value());
     }
@@ -266,7 +339,7 @@ class AlgorithmBuilder {
     // fallback for existing clients.
     return clone->SetL0Sensitivity(l0_sensitivity_.value_or(1))
         .SetLInfSensitivity(max_contributions_per_partition_.value_or(1))
-        .Build();
+        .BuildShared();
   }
 };
 
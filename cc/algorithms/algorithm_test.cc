@@ -106,6 +106,12 @@ TEST(IncrementalAlgorithmTest, MergedPartialResultConsumesBudget) {
   EXPECT_THAT(alg_2.RemainingPrivacyBudget(), DoubleNear(0.0, kTestPrecision));
 }
 
+TEST(IncrementalAlgorithmTest, CloneEmptyIsUnimplementedByDefault) {
+  TestAlgorithm<double> alg;
+  EXPECT_EQ(alg.CloneEmpty().status().code(),
+            base::StatusCode::kUnimplemented);
+}
+
 TEST(IncrementalAlgorithmDeathTest, BudgetTooHigh) {
   TestAlgorithm<double> alg;
   alg.PartialResult(0.5).ValueOrDie();
@@ -0,0 +1,74 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/random/random.h"
+#include "algorithms/bounded-mean.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/bounded-variance.h"
+
+namespace differential_privacy {
+namespace {
+
+// Memory of auto-bounded algorithms over many small partitions, as reported by
+// MemoryUsed(). The first argument is the number of partitions and the second
+// the number of entries per partition. The partitions are built and filled one
+// at a time, so that the benchmark itself does not need the memory.
+template <typename Algorithm>
+void BM_AutoBoundedPartitionMemory(benchmark::State& state) {
+  const int64_t num_partitions = state.range(0);
+  const int64_t entries_per_partition = state.range(1);
+  absl::BitGen gen;
+  std::vector<double> entries(entries_per_partition);
+  for (double& entry : entries) {
+    entry = std::exp2(absl::Uniform(gen, -5.0, 20.0));
+  }
+
+  int64_t total_bytes = 0;
+  for (auto _ : state) {
+    total_bytes = 0;
+    for (int64_t i = 0; i < num_partitions; ++i) {
+      std::unique_ptr<Algorithm> algorithm =
+          typename Algorithm::Builder().SetEpsilon(1.0).Build().ValueOrDie();
+      algorithm->AddEntries(entries.begin(), entries.end());
+      total_bytes += algorithm->MemoryUsed();
+    }
+  }
+  state.counters["total_bytes"] = total_bytes;
+  state.counters["bytes_per_partition"] =
+      static_cast<double>(total_bytes) / num_partitions;
+}
+
+void PartitionArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"partitions", "entries"})
+      ->ArgsProduct({{1 << 20}, {1, 16}})
+      ->Iterations(1)
+      ->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK_TEMPLATE(BM_AutoBoundedPartitionMemory, BoundedSum<double>)
+    ->Apply(PartitionArgs);
+BENCHMARK_TEMPLATE(BM_AutoBoundedPartitionMemory, BoundedMean<double>)
+    ->Apply(PartitionArgs);
+BENCHMARK_TEMPLATE(BM_AutoBoundedPartitionMemory, BoundedVariance<double>)
+    ->Apply(PartitionArgs);
+
+}  // namespace
+}  // namespace differential_privacy
@@ -18,12 +18,20 @@
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_APPROX_BOUNDS_H_
 
 #include <cmath>
+#include <cstdint>
 #include <limits>
+#include <type_traits>
+#include <vector>
 
 #include "google/protobuf/any.pb.h"
+#include "absl/base/casts.h"
+#include "absl/numeric/bits.h"
+#include "absl/types/span.h"
 #include "base/status.h"
 #include "algorithms/algorithm.h"
+#include "algorithms/bin-boundaries.h"
 #include "algorithms/numerical-mechanisms.h"
+#include "algorithms/sparse-bins.h"
 #include "algorithms/util.h"
 #include "proto/util.h"
 #include "base/canonical_errors.h"
@@ -85,16 +93,13 @@ class ApproxBounds : public Algorithm<T> {
 
    public:
     // Constructor sets default values depending on the input type. Bins are
-    // created to cover entire range of type T.
+    // created to cover entire range of type T. Their boundaries are computed at
+    // compile time, see internal::DefaultBinBoundaries.
     Builder()
         : AlgorithmBuilder(),
-          base_(2),
+          scale_(internal::DefaultBinBoundaries<T>::kScale),
+          base_(internal::DefaultBinBoundaries<T>::kBase),
           success_probability_(1 - std::pow(10, -9)) {
-      if (std::is_integral<T>::value) {
-        scale_ = 1.0;
-      } else {
-        scale_ = std::numeric_limits<T>::min();
-      }
       // Take the subtraction of two logarithms to prevent overflow.
       num_bins_ = std::ceil((std::log(std::numeric_limits<T>::max()) -
                              std::log(scale_)) /
@@ -133,8 +138,20 @@ class ApproxBounds : public Algorithm<T> {
 
    private:
     base::StatusOr<std::unique_ptr<ApproxBounds<T>>> BuildAlgorithm() override {
-      std::unique_ptr<NumericalMechanism> mechanism;
-      ASSIGN_OR_RETURN(mechanism, AlgorithmBuilder::UpdateAndBuildMechanism());
+      // Every result adds noise to all 2 * num_bins bins, so draw Laplace noise
+      // with the geometric sampler that takes a constant number of uniform
+      // draws per sample. It samples the same distribution as the default one.
+      // The sampler is set on a copy, so the builder is not modified.
+      std::unique_ptr<NumericalMechanismBuilder> mechanism_builder =
+          AlgorithmBuilder::GetMechanismBuilderClone();
+      if (auto* laplace_builder = dynamic_cast<LaplaceMechanism::Builder*>(
+              mechanism_builder.get())) {
+        laplace_builder->SetGeometricSampler(
+            internal::GeometricSampler::kDecomposition);
+      }
+      std::shared_ptr<NumericalMechanism> mechanism;
+      ASSIGN_OR_RETURN(mechanism, AlgorithmBuilder::UpdateAndBuildMechanism(
+                                      std::move(mechanism_builder)));
 
       // Check the validity of the histogram parameters. num_bin and
       // success_probability restrictions prevent undefined threshold
@@ -198,17 +215,53 @@ class ApproxBounds : public Algorithm<T> {
     // that MostSignificantBit returns 0 for 0.
     int index = MostSignificantBit(input);
     if (input >= 0) {
-      ++pos_bins_[index];
+      ++pos_bins_.Mutable(index);
     } else {  // value < 0
-      ++neg_bins_[index];
+      ++neg_bins_.Mutable(index);
+    }
+  }
+
+  using Algorithm<T>::AddEntries;
+
+  // With base 2, the candidate bin indices of a chunk of entries are computed
+  // in a branch-free loop that the compiler can vectorize. Then they are
+  // corrected and counted one at a time.
+  void AddEntries(absl::Span<const T> entries) override {
+    if (base_ != 2) {
+      Algorithm<T>::AddEntries(entries);
+      return;
+    }
+    constexpr size_t kChunkSize = 256;
+    Magnitude magnitudes[kChunkSize];
+    int candidates[kChunkSize];
+    internal::SparseBins<int64_t>* const bins_by_sign[2] = {&pos_bins_,
+                                                            &neg_bins_};
+    for (size_t start = 0; start < entries.size(); start += kChunkSize) {
+      const size_t chunk_size = std::min(kChunkSize, entries.size() - start);
+      const T* chunk = entries.data() + start;
+      for (size_t i = 0; i < chunk_size; ++i) {
+        magnitudes[i] = ClampedMagnitude(chunk[i]);
+      }
+      for (size_t i = 0; i < chunk_size; ++i) {
+        candidates[i] = CeilLog2(magnitudes[i]) - scale_exponent_;
+      }
+      for (size_t i = 0; i < chunk_size; ++i) {
+        if constexpr (std::is_floating_point<T>::value) {
+          if (std::isnan(chunk[i])) continue;
+        }
+        int index = CorrectBinIndex(magnitudes[i], candidates[i]);
+        ++bins_by_sign[chunk[i] < 0]->Mutable(index);
+      }
     }
   }
 
   // Serialize the positive and negative bin counts.
   Summary Serialize() override {
     ApproxBoundsSummary am_summary;
-    *am_summary.mutable_pos_bin_count() = {pos_bins_.begin(), pos_bins_.end()};
-    *am_summary.mutable_neg_bin_count() = {neg_bins_.begin(), neg_bins_.end()};
+    std::vector<int64_t> pos_bins = pos_bins_.ToVector();
+    std::vector<int64_t> neg_bins = neg_bins_.ToVector();
+    *am_summary.mutable_pos_bin_count() = {pos_bins.begin(), pos_bins.end()};
+    *am_summary.mutable_neg_bin_count() = {neg_bins.begin(), neg_bins.end()};
     Summary summary;
     summary.mutable_data()->PackFrom(am_summary);
     return summary;
@@ -233,24 +286,35 @@ class ApproxBounds : public Algorithm<T> {
           "bin counts as this histogram.");
     }
 
-    // Add bin count from summary to each bin.
+    // Add bin count from summary to each bin. Empty bins are skipped so that
+    // they are not stored.
     for (int i = 0; i < pos_bins_.size(); ++i) {
-      pos_bins_[i] += am_summary.pos_bin_count(i);
-      neg_bins_[i] += am_summary.neg_bin_count(i);
+      if (am_summary.pos_bin_count(i) != 0) {
+        pos_bins_.Mutable(i) += am_summary.pos_bin_count(i);
+      }
+      if (am_summary.neg_bin_count(i) != 0) {
+        neg_bins_.Mutable(i) += am_summary.neg_bin_count(i);
+      }
     }
     return base::OkStatus();
   }
 
+  base::StatusOr<std::unique_ptr<Algorithm<T>>> CloneEmpty() const override {
+    return std::unique_ptr<Algorithm<T>>(CloneEmptyApproxBounds());
+  }
+
+  // Same as CloneEmpty(), for the algorithms that use ApproxBounds.
+  std::unique_ptr<ApproxBounds<T>> CloneEmptyApproxBounds() const {
+    return absl::WrapUnique(new ApproxBounds<T>(
+        Algorithm<T>::GetEpsilon(), pos_bins_.size(), scale_, base_, k_,
+        preset_k_, mechanism_));
+  }
+
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(ApproxBounds<T>) +
-                   sizeof(int64_t) * neg_bins_.capacity() +
-                   sizeof(int64_t) * pos_bins_.capacity() +
-                   sizeof(T) * noisy_neg_bins_.capacity() +
-                   sizeof(T) * noisy_pos_bins_.capacity();
-    if (mechanism_) {
-      memory += mechanism_->MemoryUsed();
-    }
-    return memory;
+    return sizeof(ApproxBounds<T>) + neg_bins_.MemoryUsed() +
+           pos_bins_.MemoryUsed() + bin_boundaries_.MemoryUsed() +
+           sizeof(T) * noisy_bins_.capacity() +
+           NumericalMechanism::MemoryUsedPerOwner(mechanism_);
   }
 
   // Return the number of positive bins. This function and the following
@@ -266,6 +330,14 @@ class ApproxBounds : public Algorithm<T> {
       return 0;
     }
 
+    // For base 2, the bin index can be read from the binary representation of
+    // the magnitude. It is exact if scale_ is a power of 2 and otherwise
+    // within one bin.
+    if (base_ == 2) {
+      Magnitude magnitude = ClampedMagnitude(value);
+      return CorrectBinIndex(magnitude, CeilLog2(magnitude) - scale_exponent_);
+    }
+
     // Clamp infinities to highest and lowest value.
     value = Clamp(std::numeric_limits<T>::lowest(),
                   std::numeric_limits<T>::max(), value);
@@ -320,36 +392,54 @@ class ApproxBounds : public Algorithm<T> {
 
     // Each bin of the logarithmic histograms in ApproxBounds can be a candidate
     // for auto-determined upper and lower bounds. Thus, we store a contribution
-    // of the value from the value for each bin.
-    for (int i = 0; i <= msb; ++i) {
-      // The maximum contribution to the bin is the partial between boundaries.
-      T2 partial = 0;
-      if (value >= 0) {
-        partial = make_partial(PosRightBinBoundary(i), PosLeftBinBoundary(i));
-      } else {
-        partial = make_partial(NegRightBinBoundary(i), NegLeftBinBoundary(i));
-      }
+    // of the value from the value for each bin. For indices below the msb, add
+    // the maximum contribution to the partial.
+    for (int i = 0; i < msb; ++i) {
+      (*partials)[i] += MaxPartialOfBin<T2>(i, value < 0, make_partial);
+    }
+    (*partials)[msb] += PartialOfBin<T2>(value, msb, make_partial);
+  }
 
-      if (i < msb) {
-        // For indices below the msb, add the maximum contribution to the
-        // partial.
-        (*partials)[i] += partial;
-      } else {
-        // For i = msb, add the remaining contribution, but not more than the
-        // maximum contribution to the partial for this bin. This may occur if
-        // the msb was clamped by the ApproxBounds not having enough bins.
-        T2 remainder;
-        if (value > 0) {
-          remainder = make_partial(value, PosLeftBinBoundary(i));
-        } else {
-          remainder = make_partial(value, NegLeftBinBoundary(i));
-        }
-        if (std::abs(partial) < std::abs(remainder)) {
-          (*partials)[msb] += partial;
-        } else {
-          (*partials)[msb] += remainder;
-        }
+  // Returns the contribution of value to the partial of its own bin,
+  // bin_index = MostSignificantBit(value), as added by AddToPartials. This is
+  // the only contribution that depends on the value itself: the value
+  // contributes the maximum contribution to each lower bin. Callers that count
+  // the values per bin can add those for all values at once with
+  // AddToLowerPartials, which makes adding a value O(1) instead of O(msb).
+  template <typename T2, typename MakePartial>
+  T2 PartialOfBin(T value, int bin_index, MakePartial make_partial) {
+    // Return the remaining contribution, but not more than the maximum
+    // contribution to the partial for this bin. This may occur if the msb was
+    // clamped by the ApproxBounds not having enough bins.
+    T2 partial = MaxPartialOfBin<T2>(bin_index, value < 0, make_partial);
+    T2 remainder;
+    if (value > 0) {
+      remainder = make_partial(value, PosLeftBinBoundary(bin_index));
+    } else {
+      remainder = make_partial(value, NegLeftBinBoundary(bin_index));
+    }
+    if (std::abs(partial) < std::abs(remainder)) {
+      return partial;
+    }
+    return remainder;
+  }
+
+  // Completes partials that only hold the PartialOfBin of each value. counts
+  // holds the number of those values per bin, which must all be negative if
+  // negative is set and non-negative otherwise. Each of them contributes the
+  // maximum contribution to every bin below its own.
+  template <typename T2, typename MakePartial>
+  void AddToLowerPartials(std::vector<T2>* partials,
+                          const internal::SparseBins<int64_t>& counts,
+                          bool negative, MakePartial make_partial) {
+    std::vector<int64_t> bin_counts = counts.ToVector();
+    int64_t count_above = 0;
+    for (int i = static_cast<int>(partials->size()) - 1; i >= 0; --i) {
+      if (count_above > 0) {
+        (*partials)[i] += static_cast<T2>(count_above) *
+                          MaxPartialOfBin<T2>(i, negative, make_partial);
       }
+      count_above += bin_counts[i];
     }
   }
 
@@ -430,28 +520,18 @@ class ApproxBounds : public Algorithm<T> {
  protected:
   ApproxBounds(double epsilon, int64_t num_bins, double scale, double base,
                double k, bool preset_k,
-               std::unique_ptr<NumericalMechanism> mechanism)
+               std::shared_ptr<NumericalMechanism> mechanism)
       : Algorithm<T>(epsilon),
-        pos_bins_(num_bins, 0),
-        neg_bins_(num_bins, 0),
-        bin_boundaries_(num_bins, 0),
+        pos_bins_(num_bins),
+        neg_bins_(num_bins),
+        bin_boundaries_(
+            internal::BinBoundaryTable<T>::Get(scale, base, num_bins)),
         scale_(scale),
+        scale_exponent_(std::ilogb(scale)),
         base_(base),
         k_(k),
         preset_k_(preset_k),
-        mechanism_(std::move(mechanism)) {
-    // Cache the bin boundary magnitudes for performance. Note that casting
-    // numeric limits lead to inconsistencies.
-    auto get_boundary = [boundary = scale_, base = base_]() mutable {
-      if (boundary >= std::numeric_limits<T>::max() / base) {
-        return std::numeric_limits<T>::max();
-      }
-      double this_boundary = boundary;
-      boundary *= base;
-      return static_cast<T>(this_boundary);
-    };
-    std::generate(bin_boundaries_.begin(), bin_boundaries_.end(), get_boundary);
-  }
+        mechanism_(std::move(mechanism)) {}
 
   // Returns an output containing approximate min as the first element and
   // approximate max as the second element. If not enough inputs exist to pass
@@ -470,57 +550,43 @@ class ApproxBounds : public Algorithm<T> {
     }
 
     // Populate noisy versions of the histogram bins.
-    noisy_pos_bins_ = AddNoise(privacy_budget, pos_bins_);
-    noisy_neg_bins_ = AddNoise(privacy_budget, neg_bins_);
-
-    Output output;
-
-    // Find first bin above threshold for minimum.
-    for (int i = neg_bins_.size() - 1; i >= 0; --i) {
-      if (noisy_neg_bins_[i] >= threshold) {
-        AddToOutput<T>(&output, NegRightBinBoundary(i));
-        break;
-      }
-    }
-    if (output.elements_size() == 0) {
-      for (int i = 0; i < pos_bins_.size(); ++i) {
-        if (noisy_pos_bins_[i] >= threshold) {
-          AddToOutput<T>(&output, PosLeftBinBoundary(i));
-          break;
-        }
-      }
-    }
-
-    // Find first bin above threshold for maximum.
-    for (int i = pos_bins_.size() - 1; i >= 0; --i) {
-      if (noisy_pos_bins_[i] >= threshold) {
-        AddToOutput<T>(&output, PosRightBinBoundary(i));
-        break;
-      }
-    }
-    if (output.elements_size() < 2) {
-      for (int i = 0; i < neg_bins_.size(); ++i) {
-        if (noisy_neg_bins_[i] >= threshold) {
-          AddToOutput<T>(&output, NegLeftBinBoundary(i));
-          break;
-        }
-      }
-    }
-
-    // Record error status if approx min or max was not found.
-    if (output.elements_size() < 2) {
+    AddNoiseToBins(privacy_budget);
+
+    // Find the first and the last bin above threshold for the minimum and the
+    // maximum. Both bins exist if any bin is above threshold.
+    const int num_bins = pos_bins_.size();
+    const T* begin = noisy_bins_.data();
+    const T* end = begin + noisy_bins_.size();
+    const T* first = begin;
+    while (first != end && *first < threshold) ++first;
+    if (first == end) {
       return base::FailedPreconditionError(
           "Bin count threshold was too large to find approximate "
           "bounds. Either run over a larger dataset or decrease "
           "success_probability and try again.");
     }
+    const T* last = end - 1;
+    while (*last < threshold) --last;
 
+    Output output;
+    int min_index = first - begin;
+    if (min_index < num_bins) {
+      AddToOutput<T>(&output, NegRightBinBoundary(num_bins - 1 - min_index));
+    } else {
+      AddToOutput<T>(&output, PosLeftBinBoundary(min_index - num_bins));
+    }
+    int max_index = last - begin;
+    if (max_index >= num_bins) {
+      AddToOutput<T>(&output, PosRightBinBoundary(max_index - num_bins));
+    } else {
+      AddToOutput<T>(&output, NegLeftBinBoundary(num_bins - 1 - max_index));
+    }
     return output;
   }
 
   void ResetState() override {
-    std::fill(pos_bins_.begin(), pos_bins_.end(), 0);
-    std::fill(neg_bins_.begin(), neg_bins_.end(), 0);
+    pos_bins_.Clear();
+    neg_bins_.Clear();
   }
 
   // Given a bin index, finds the larger-magnitude boundary of the corresponding
@@ -538,16 +604,118 @@ class ApproxBounds : public Algorithm<T> {
   T PosRightBinBoundary(int bin_index) { return bin_boundaries_[bin_index]; }
 
  private:
-  // Add noise to each member of bins and return noisy vector.
-  const std::vector<T> AddNoise(double privacy_budget,
-                                const std::vector<int64_t>& bins) {
-    std::vector<T> noisy_bins(bins.size());
-    for (int i = 0; i < bins.size(); ++i) {
-      double noised_dbl =
-          mechanism_->AddNoise(static_cast<double>(bins[i]), privacy_budget);
-      SafeCastFromDouble<T>(noised_dbl, noisy_bins[i]);
-    }
-    return noisy_bins;
+  // Adds noise to all bins at once and stores the noisy counts in noisy_bins_.
+  // Every bin is noised, including the empty ones, since the noisy count of
+  // any of them can pass the threshold. Doubles are noised in place in
+  // noisy_bins_. Other types go through a per-thread scratch buffer, so that
+  // algorithms kept alive after their results do not each hold one.
+  void AddNoiseToBins(double privacy_budget) {
+    if constexpr (std::is_same<T, double>::value) {
+      FillBinCounts(&noisy_bins_);
+      mechanism_->AddNoiseBatch(noisy_bins_, absl::MakeSpan(noisy_bins_),
+                                privacy_budget);
+    } else {
+      static thread_local std::vector<double> noise_buffer;
+      FillBinCounts(&noise_buffer);
+      mechanism_->AddNoiseBatch(noise_buffer, absl::MakeSpan(noise_buffer),
+                                privacy_budget);
+      noisy_bins_.resize(noise_buffer.size());
+      for (int i = 0; i < noise_buffer.size(); ++i) {
+        SafeCastFromDouble<T>(noise_buffer[i], noisy_bins_[i]);
+      }
+    }
+  }
+
+  // Sets counts to the counts of the bins, in the order of noisy_bins_.
+  void FillBinCounts(std::vector<double>* counts) const {
+    const int num_bins = pos_bins_.size();
+    counts->assign(2 * num_bins, 0);
+    neg_bins_.ForEachStored([counts, num_bins](int index, int64_t count) {
+      (*counts)[num_bins - 1 - index] = count;
+    });
+    pos_bins_.ForEachStored([counts, num_bins](int index, int64_t count) {
+      (*counts)[num_bins + index] = count;
+    });
+  }
+
+  // Noisy counts of the bins from the most recent result generation.
+  T NoisyNegBin(int bin_index) const {
+    return noisy_bins_[pos_bins_.size() - 1 - bin_index];
+  }
+  T NoisyPosBin(int bin_index) const {
+    return noisy_bins_[pos_bins_.size() + bin_index];
+  }
+
+  // Magnitude of an input. Integers use the unsigned 64 bit magnitude so that
+  // the magnitude of the lowest value does not overflow.
+  using Magnitude =
+      std::conditional_t<std::is_integral<T>::value, uint64_t, T>;
+
+  // Returns the magnitude of the value, clamped to the maximum numeric limit
+  // like in MostSignificantBit.
+  static Magnitude ClampedMagnitude(T value) {
+    if constexpr (std::is_integral<T>::value) {
+      // Branch-free absolute value: flips the bits and adds one if negative.
+      uint64_t sign =
+          static_cast<uint64_t>(static_cast<int64_t>(value) >> 63);
+      uint64_t magnitude = (static_cast<uint64_t>(value) ^ sign) - sign;
+      return std::min<uint64_t>(magnitude, std::numeric_limits<T>::max());
+    } else {
+      return std::min<T>(std::abs(value), std::numeric_limits<T>::max());
+    }
+  }
+
+  // Returns ceil(log2(magnitude)) for positive normal magnitudes from the
+  // exponent and mantissa bits of floating point values and from the leading
+  // zeros of integers. Zero and subnormal magnitudes map to at most the
+  // exponent of the smallest normal magnitude.
+  static int CeilLog2(Magnitude magnitude) {
+    if constexpr (std::is_integral<T>::value) {
+      // ceil(log2(m)) is the bit width of m - 1. Computes it without the
+      // branches of the zero checks, mapping 0 to 0.
+      uint64_t x = magnitude - 1 + (magnitude == 0);
+      return (x != 0) + 63 - absl::countl_zero(x | 1);
+    } else if constexpr (std::is_same<T, double>::value) {
+      uint64_t bits = absl::bit_cast<uint64_t>(magnitude);
+      bool has_mantissa = (bits & ((uint64_t{1} << 52) - 1)) != 0;
+      return static_cast<int>(bits >> 52) - 1023 + has_mantissa;
+    } else if constexpr (std::is_same<T, float>::value) {
+      uint32_t bits = absl::bit_cast<uint32_t>(magnitude);
+      bool has_mantissa = (bits & ((uint32_t{1} << 23) - 1)) != 0;
+      return static_cast<int>(bits >> 23) - 127 + has_mantissa;
+    } else {
+      return magnitude == 0 ? std::numeric_limits<T>::min_exponent - 1
+                            : static_cast<int>(std::ceil(std::log2(magnitude)));
+    }
+  }
+
+  // Returns the smallest bin whose right boundary is at least the magnitude,
+  // or the last bin if there is none. The candidate index must be close to the
+  // result, since the search moves one bin at a time.
+  int CorrectBinIndex(Magnitude magnitude, int candidate) {
+    const int last_bin = static_cast<int>(bin_boundaries_.size()) - 1;
+    int index = std::max(0, std::min(candidate, last_bin));
+    while (index > 0 &&
+           magnitude <= static_cast<Magnitude>(bin_boundaries_[index - 1])) {
+      --index;
+    }
+    while (index < last_bin &&
+           magnitude > static_cast<Magnitude>(bin_boundaries_[index])) {
+      ++index;
+    }
+    return index;
+  }
+
+  // The maximum contribution of a value to the partial of the given bin, which
+  // is the partial between its boundaries.
+  template <typename T2, typename MakePartial>
+  T2 MaxPartialOfBin(int bin_index, bool negative, MakePartial make_partial) {
+    if (negative) {
+      return make_partial(NegRightBinBoundary(bin_index),
+                          NegLeftBinBoundary(bin_index));
+    }
+    return make_partial(PosRightBinBoundary(bin_index),
+                        PosLeftBinBoundary(bin_index));
   }
 
   // Given a bin index, finds the smaller-magnitude boundary of the
@@ -571,7 +739,7 @@ class ApproxBounds : public Algorithm<T> {
   // larger-magnitude bin boundary.
   base::StatusOr<double> NumInputsOutside(T lower, T upper) {
     // Check that noisy bins have been populated.
-    if (noisy_pos_bins_.empty()) {
+    if (noisy_bins_.empty()) {
       return base::InvalidArgumentError(
           "Noisy histogram bins have not been created. Try generating "
           "results first.");
@@ -583,7 +751,7 @@ class ApproxBounds : public Algorithm<T> {
 
     // Add the count of inputs below lower.
     int pos_i = 0;
-    int neg_i = noisy_neg_bins_.size();
+    int neg_i = neg_bins_.size();
     if (lower == 0) {
       neg_i = -1;
     } else if (lower < 0) {
@@ -592,15 +760,15 @@ class ApproxBounds : public Algorithm<T> {
       neg_i = -1;
       pos_i = lower_msb + 1;
     }
-    for (int i = noisy_neg_bins_.size() - 1; i > neg_i; --i) {
-      num_outside += noisy_neg_bins_[i];
+    for (int i = neg_bins_.size() - 1; i > neg_i; --i) {
+      num_outside += NoisyNegBin(i);
     }
     for (int i = 0; i < pos_i; ++i) {
-      num_outside += noisy_pos_bins_[i];
+      num_outside += NoisyPosBin(i);
     }
 
     // Add the count of inputs above upper.
-    pos_i = noisy_pos_bins_.size();
+    pos_i = pos_bins_.size();
     neg_i = -1;
     if (upper == 0) {
       pos_i = 0;
@@ -611,10 +779,10 @@ class ApproxBounds : public Algorithm<T> {
       pos_i = upper_msb + 1;
     }
     for (int i = neg_i; i >= 0; --i) {
-      num_outside += noisy_neg_bins_[i];
+      num_outside += NoisyNegBin(i);
     }
-    for (int i = pos_i; i < noisy_pos_bins_.size(); ++i) {
-      num_outside += noisy_pos_bins_[i];
+    for (int i = pos_i; i < pos_bins_.size(); ++i) {
+      num_outside += NoisyPosBin(i);
     }
 
     return num_outside;
@@ -628,20 +796,24 @@ class ApproxBounds : public Algorithm<T> {
 
  private:
   // Count the values in each logarithmic bin for positives and negatives.
-  std::vector<int64_t> pos_bins_;
-  std::vector<int64_t> neg_bins_;
+  internal::SparseBins<int64_t> pos_bins_;
+  internal::SparseBins<int64_t> neg_bins_;
 
-  // Noisy DP counts of the positive and negative bins. Populated upon
-  // generating the result.
-  std::vector<T> noisy_pos_bins_;
-  std::vector<T> noisy_neg_bins_;
+  // Noisy DP counts of the bins, populated upon generating the result. Ordered
+  // by the values of the bins: the negative bins from the largest magnitude
+  // down, followed by the positive bins from the smallest magnitude up.
+  std::vector<T> noisy_bins_;
 
   // The bin boundary magnitudes, starting from lowest positive magnitude.
-  std::vector<T> bin_boundaries_;
+  // Shared with the other instances with the same histogram parameters.
+  internal::BinBoundaryTable<T> bin_boundaries_;
 
   // Multiplicative factor for inputs
   double scale_;
 
+  // Binary exponent of scale_, i.e., floor(log2(scale_)).
+  int scale_exponent_;
+
   // Base of the logarithm.
   double base_;
 
@@ -652,7 +824,7 @@ class ApproxBounds : public Algorithm<T> {
   bool preset_k_;
 
   // Mechanism for adding noise to buckets.
-  std::unique_ptr<NumericalMechanism> mechanism_;
+  std::shared_ptr<NumericalMechanism> mechanism_;
 };
 
 }  // namespace differential_privacy
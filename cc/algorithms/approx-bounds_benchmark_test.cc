@@ -0,0 +1,114 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/random/random.h"
+#include "algorithms/approx-bounds.h"
+
+namespace differential_privacy {
+namespace {
+
+constexpr int64_t kNumEntries = 1 << 16;
+
+template <typename T>
+std::vector<T> MakeEntries() {
+  absl::BitGen gen;
+  std::vector<T> entries(kNumEntries);
+  for (T& entry : entries) {
+    // Spread the magnitudes over many bins.
+    double magnitude = std::exp2(absl::Uniform(gen, -10.0, 40.0));
+    entry = static_cast<T>(absl::Bernoulli(gen, 0.5) ? magnitude : -magnitude);
+  }
+  return entries;
+}
+
+// The benchmark argument is the base of the histogram. Base 2 uses the binary
+// exponent, other bases use logarithms.
+template <typename T>
+std::unique_ptr<ApproxBounds<T>> BuildApproxBounds(
+    const benchmark::State& state) {
+  return typename ApproxBounds<T>::Builder()
+      .SetEpsilon(1.0)
+      .SetBase(state.range(0))
+      .Build()
+      .ValueOrDie();
+}
+
+template <typename T>
+void BM_ApproxBoundsAddEntry(benchmark::State& state) {
+  const std::vector<T> entries = MakeEntries<T>();
+  std::unique_ptr<ApproxBounds<T>> bounds = BuildApproxBounds<T>(state);
+  for (auto _ : state) {
+    for (const T& entry : entries) {
+      bounds->AddEntry(entry);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK_TEMPLATE(BM_ApproxBoundsAddEntry, double)
+    ->ArgName("base")
+    ->Arg(2)
+    ->Arg(3);
+BENCHMARK_TEMPLATE(BM_ApproxBoundsAddEntry, int64_t)
+    ->ArgName("base")
+    ->Arg(2)
+    ->Arg(3);
+
+template <typename T>
+void BM_ApproxBoundsAddEntries(benchmark::State& state) {
+  const std::vector<T> entries = MakeEntries<T>();
+  std::unique_ptr<ApproxBounds<T>> bounds = BuildApproxBounds<T>(state);
+  for (auto _ : state) {
+    bounds->AddEntries(entries.begin(), entries.end());
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK_TEMPLATE(BM_ApproxBoundsAddEntries, double)
+    ->ArgName("base")
+    ->Arg(2)
+    ->Arg(3);
+BENCHMARK_TEMPLATE(BM_ApproxBoundsAddEntries, int64_t)
+    ->ArgName("base")
+    ->Arg(2)
+    ->Arg(3);
+
+// Latency of a result, which adds noise to every bin of the histogram. The
+// histogram is restored from a summary before each result, outside of the
+// timing, since every result consumes the privacy budget.
+template <typename T>
+void BM_ApproxBoundsResult(benchmark::State& state) {
+  const std::vector<T> entries = MakeEntries<T>();
+  std::unique_ptr<ApproxBounds<T>> bounds = BuildApproxBounds<T>(state);
+  bounds->AddEntries(entries.begin(), entries.end());
+  const Summary summary = bounds->Serialize();
+  for (auto _ : state) {
+    state.PauseTiming();
+    bounds->Reset();
+    bounds->Merge(summary);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(bounds->PartialResult());
+  }
+  state.counters["bins"] = 2 * bounds->NumPositiveBins();
+}
+BENCHMARK_TEMPLATE(BM_ApproxBoundsResult, double)->ArgName("base")->Arg(2);
+BENCHMARK_TEMPLATE(BM_ApproxBoundsResult, int64_t)->ArgName("base")->Arg(2);
+
+}  // namespace
+}  // namespace differential_privacy
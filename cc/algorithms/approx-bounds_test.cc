@@ -28,6 +28,7 @@
 namespace differential_privacy {
 namespace {
 
+using ::testing::ElementsAreArray;
 using ::differential_privacy::test_utils::ZeroNoiseMechanism;
 using ::differential_privacy::base::testing::EqualsProto;
 
@@ -119,6 +120,23 @@ TEST(ApproxBoundsTest, NegativeMax) {
   EXPECT_EQ(result.elements(1).value().float_value(), -2);
 }
 
+TEST(ApproxBoundsTest, PositiveMin) {
+  std::vector<double> a = {3, 3, 3, 3, 8, 8, 8, 8};
+  std::unique_ptr<ApproxBounds<double>> bounds =
+      ApproxBounds<double>::Builder()
+          .SetNumBins(4)
+          .SetBase(2)
+          .SetScale(1)
+          .SetThreshold(4)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  bounds->AddEntries(a.begin(), a.end());
+  auto result = bounds->PartialResult().ValueOrDie();
+  EXPECT_EQ(result.elements(0).value().float_value(), 2);
+  EXPECT_EQ(result.elements(1).value().float_value(), 8);
+}
+
 TYPED_TEST(ApproxBoundsTest, InvalidParameters) {
   EXPECT_FALSE(typename ApproxBounds<TypeParam>::Builder()
                    .SetNumBins(0)
@@ -287,6 +305,91 @@ TEST(ApproxBoundsTest, MostSignificantBit) {
   EXPECT_EQ(bounds->MostSignificantBit(-8), 3);
 }
 
+TEST(ApproxBoundsTest, MostSignificantBitBase2DefaultDouble) {
+  std::unique_ptr<ApproxBounds<double>> bounds =
+      ApproxBounds<double>::Builder().SetEpsilon(1).Build().ValueOrDie();
+  // Bin i has the right boundary 2^(i - 1022).
+  for (int exponent = -1022; exponent < 1023; ++exponent) {
+    double boundary = std::ldexp(1.0, exponent);
+    EXPECT_EQ(bounds->MostSignificantBit(boundary), exponent + 1022);
+    EXPECT_EQ(bounds->MostSignificantBit(-boundary), exponent + 1022);
+    EXPECT_EQ(bounds->MostSignificantBit(std::nextafter(boundary, 0)),
+              exponent + 1022);
+    EXPECT_EQ(bounds->MostSignificantBit(std::nextafter(boundary, INFINITY)),
+              exponent + 1023);
+  }
+  EXPECT_EQ(
+      bounds->MostSignificantBit(std::numeric_limits<double>::denorm_min()), 0);
+  EXPECT_EQ(bounds->MostSignificantBit(INFINITY),
+            bounds->MostSignificantBit(std::numeric_limits<double>::max()));
+  EXPECT_EQ(bounds->MostSignificantBit(-INFINITY),
+            bounds->MostSignificantBit(std::numeric_limits<double>::max()));
+}
+
+TEST(ApproxBoundsTest, MostSignificantBitBase2DefaultInt) {
+  std::unique_ptr<ApproxBounds<int64_t>> bounds =
+      ApproxBounds<int64_t>::Builder().SetEpsilon(1).Build().ValueOrDie();
+  EXPECT_EQ(bounds->MostSignificantBit(1), 0);
+  EXPECT_EQ(bounds->MostSignificantBit(-1), 0);
+  EXPECT_EQ(bounds->MostSignificantBit(2), 1);
+  for (int exponent = 2; exponent < 62; ++exponent) {
+    int64_t boundary = int64_t{1} << exponent;
+    EXPECT_EQ(bounds->MostSignificantBit(boundary), exponent);
+    EXPECT_EQ(bounds->MostSignificantBit(boundary - 1), exponent);
+    EXPECT_EQ(bounds->MostSignificantBit(-boundary - 1), exponent + 1);
+  }
+  EXPECT_EQ(bounds->MostSignificantBit(std::numeric_limits<int64_t>::lowest()),
+            bounds->MostSignificantBit(std::numeric_limits<int64_t>::max()));
+}
+
+TEST(ApproxBoundsTest, MostSignificantBitBase2NonPowerOfTwoScale) {
+  std::unique_ptr<ApproxBounds<int64_t>> bounds =
+      ApproxBounds<int64_t>::Builder()
+          .SetNumBins(6)
+          .SetBase(2)
+          .SetScale(3)
+          .SetSuccessProbability(.95)
+          .Build()
+          .ValueOrDie();
+  // The bin boundaries are 3, 6, 12, 24, 48 and 96.
+  EXPECT_EQ(bounds->MostSignificantBit(2), 0);
+  EXPECT_EQ(bounds->MostSignificantBit(3), 0);
+  EXPECT_EQ(bounds->MostSignificantBit(4), 1);
+  EXPECT_EQ(bounds->MostSignificantBit(6), 1);
+  EXPECT_EQ(bounds->MostSignificantBit(7), 2);
+  EXPECT_EQ(bounds->MostSignificantBit(-25), 4);
+  EXPECT_EQ(bounds->MostSignificantBit(1000), 5);
+}
+
+TYPED_TEST(ApproxBoundsTest, BulkAddEntriesMatchesAddEntry) {
+  std::vector<TypeParam> a = {0, 1, -1, 7, -8, 1000, -123456,
+                              std::numeric_limits<TypeParam>::max(),
+                              std::numeric_limits<TypeParam>::lowest()};
+  for (int i = 0; i < 1000; ++i) {
+    a.push_back(
+        static_cast<TypeParam>((i % 2 ? -1 : 1) * std::pow(1.7, i % 80)));
+  }
+  if (std::is_floating_point<TypeParam>::value) {
+    a.push_back(std::numeric_limits<TypeParam>::quiet_NaN());
+    a.push_back(std::numeric_limits<TypeParam>::infinity());
+    a.push_back(-std::numeric_limits<TypeParam>::infinity());
+    a.push_back(std::numeric_limits<TypeParam>::denorm_min());
+  }
+  auto build = []() {
+    return typename ApproxBounds<TypeParam>::Builder()
+        .SetEpsilon(1)
+        .Build()
+        .ValueOrDie();
+  };
+  std::unique_ptr<ApproxBounds<TypeParam>> bulk = build();
+  std::unique_ptr<ApproxBounds<TypeParam>> single = build();
+  bulk->AddEntries(absl::MakeConstSpan(a));
+  for (TypeParam entry : a) {
+    single->AddEntry(entry);
+  }
+  EXPECT_THAT(bulk->Serialize(), EqualsProto(single->Serialize()));
+}
+
 TEST(ApproxBoundsTest, ThresholdByPrivacyBudget) {
   typename ApproxBounds<int>::Builder builder;
   std::vector<int> a = {1, 1};
@@ -379,6 +482,43 @@ TYPED_TEST(ApproxBoundsTest, AddToPartialSums) {
   }
 }
 
+TYPED_TEST(ApproxBoundsTest, BinPartialsMatchAddToPartials) {
+  int n_bins = 4;
+  std::unique_ptr<ApproxBounds<TypeParam>> bounds =
+      typename ApproxBounds<TypeParam>::Builder()
+          .SetNumBins(n_bins)
+          .SetBase(2)
+          .SetScale(1)
+          .Build()
+          .ValueOrDie();
+  auto difference = [](TypeParam val1, TypeParam val2) { return val1 - val2; };
+
+  // Includes values larger in magnitude than the largest bin boundary.
+  std::vector<TypeParam> expected_pos(n_bins, 0), expected_neg(n_bins, 0);
+  std::vector<TypeParam> pos(n_bins, 0), neg(n_bins, 0);
+  internal::SparseBins<int64_t> pos_counts(n_bins), neg_counts(n_bins);
+  for (TypeParam value : {0, 1, 3, 6, 7, 20, -1, -2, -5, -8, -30}) {
+    int bin = bounds->MostSignificantBit(value);
+    if (value >= 0) {
+      bounds->template AddToPartials<TypeParam>(&expected_pos, value,
+                                                difference);
+      pos[bin] += bounds->template PartialOfBin<TypeParam>(value, bin,
+                                                           difference);
+      ++pos_counts.Mutable(bin);
+    } else {
+      bounds->template AddToPartials<TypeParam>(&expected_neg, value,
+                                                difference);
+      neg[bin] += bounds->template PartialOfBin<TypeParam>(value, bin,
+                                                           difference);
+      ++neg_counts.Mutable(bin);
+    }
+  }
+  bounds->AddToLowerPartials(&pos, pos_counts, /*negative=*/false, difference);
+  bounds->AddToLowerPartials(&neg, neg_counts, /*negative=*/true, difference);
+  EXPECT_THAT(pos, ElementsAreArray(expected_pos));
+  EXPECT_THAT(neg, ElementsAreArray(expected_neg));
+}
+
 TYPED_TEST(ApproxBoundsTest, ComputeSumFromPartials) {
   int n_bins = 4;
   std::unique_ptr<ApproxBounds<TypeParam>> bounds =
@@ -459,6 +599,70 @@ TYPED_TEST(ApproxBoundsTest, GetBoundingReport) {
   EXPECT_EQ(bounds->GetBoundingReport(-1, 0).num_outside(), 11);  // [-1, 0)
 }
 
+TEST(ApproxBoundsTest, CloneEmpty) {
+  std::unique_ptr<ApproxBounds<int64_t>> prototype =
+      ApproxBounds<int64_t>::Builder()
+          .SetNumBins(4)
+          .SetBase(2)
+          .SetThreshold(3)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  prototype->AddEntries({1, 1, 1});
+
+  std::unique_ptr<ApproxBounds<int64_t>> bounds =
+      prototype->CloneEmptyApproxBounds();
+  EXPECT_EQ(bounds->NumPositiveBins(), 4);
+  std::vector<int64_t> a = {-5, -5, -7, 7, 7, 6};
+  bounds->AddEntries(a.begin(), a.end());
+  auto result = bounds->PartialResult().ValueOrDie();
+  EXPECT_EQ(result.elements(0).value().int_value(), -8);
+  EXPECT_EQ(result.elements(1).value().int_value(), 8);
+
+  // The threshold is not met by the entries of the prototype.
+  EXPECT_FALSE(prototype->CloneEmpty().ValueOrDie()->PartialResult().ok());
+}
+
+// A Laplace mechanism builder that records whether it was destroyed.
+class TrackedLaplaceBuilder : public LaplaceMechanism::Builder {
+ public:
+  explicit TrackedLaplaceBuilder(bool* destroyed) : destroyed_(destroyed) {}
+  ~TrackedLaplaceBuilder() override {
+    if (destroyed_ != nullptr) *destroyed_ = true;
+  }
+
+ private:
+  bool* destroyed_;
+};
+
+TEST(ApproxBoundsTest, BuildKeepsMechanismBuilder) {
+  bool destroyed = false;
+  ApproxBounds<double>::Builder builder;
+  builder.SetLaplaceMechanism(
+      absl::make_unique<TrackedLaplaceBuilder>(&destroyed));
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(builder.Build().ok());
+  }
+  EXPECT_FALSE(destroyed);
+}
+
+TYPED_TEST(ApproxBoundsTest, ResultKeepsOnlyNoisyBins) {
+  const int num_bins = 1000;
+  std::unique_ptr<ApproxBounds<TypeParam>> bounds =
+      typename ApproxBounds<TypeParam>::Builder()
+          .SetNumBins(num_bins)
+          .SetThreshold(0)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  bounds->AddEntry(1);
+  const int64_t before = bounds->MemoryUsed();
+  ASSERT_TRUE(bounds->PartialResult().ok());
+  // Only the noisy counts of the negative and positive bins are kept.
+  EXPECT_LE(bounds->MemoryUsed() - before,
+            2 * num_bins * sizeof(TypeParam));
+}
+
 TYPED_TEST(ApproxBoundsTest, Memory) {
   std::unique_ptr<ApproxBounds<TypeParam>> bounds_small =
       typename ApproxBounds<TypeParam>::Builder()
@@ -0,0 +1,189 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_BIN_BOUNDARIES_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_BIN_BOUNDARIES_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// Fills boundaries with the right boundaries of the positive bins of a
+// logarithmic histogram: scale * base^i, or max() of T once that is at least
+// max() / base. Note that casting numeric limits leads to inconsistencies, so
+// the boundaries are computed as doubles.
+template <typename T, typename Container>
+constexpr void FillBinBoundaries(double scale, double base,
+                                 Container& boundaries) {
+  double boundary = scale;
+  for (size_t i = 0; i < boundaries.size(); ++i) {
+    if (boundary >= std::numeric_limits<T>::max() / base) {
+      boundaries[i] = std::numeric_limits<T>::max();
+    } else {
+      boundaries[i] = static_cast<T>(boundary);
+      boundary *= base;
+    }
+  }
+}
+
+// The default histogram of ApproxBounds<T>: base 2, starting at 1 for integral
+// types and at the smallest normal value for floating point types, with as
+// many bins as it takes to reach max() of T.
+template <typename T>
+struct DefaultBinBoundaries {
+  static constexpr double kBase = 2;
+  static constexpr double kScale =
+      std::is_integral<T>::value ? 1.0 : std::numeric_limits<T>::min();
+
+  // The number of boundaries that are less than max() of T, plus one for the
+  // first boundary that is max(), and one more that is max() too. The number of
+  // bins chosen by ApproxBounds<T>::Builder is computed with logarithms, and
+  // can round up to the latter.
+  static constexpr int64_t Size() {
+    constexpr double kMax = std::numeric_limits<T>::max();
+    int64_t n = 2;
+    for (double boundary = kScale; boundary < kMax; boundary *= kBase) {
+      ++n;
+      // Multiplying again could overflow, which is not a constant expression.
+      if (boundary >= kMax / kBase) break;
+    }
+    return n;
+  }
+
+  static constexpr std::array<T, Size()> Make() {
+    std::array<T, Size()> boundaries = {};
+    FillBinBoundaries<T>(kScale, kBase, boundaries);
+    return boundaries;
+  }
+
+  static constexpr std::array<T, Size()> kBoundaries = Make();
+};
+
+// Right boundaries of the positive bins of an ApproxBounds histogram, which
+// only depend on T, scale, base and the number of bins. Tables are immutable
+// and shared: with the default scale and base, a table is a prefix of the
+// boundaries computed at compile time. All other tables are interned in a
+// process-wide cache, so that all instances with the same parameters share one
+// table, which is freed with the last of them.
+template <typename T>
+class BinBoundaryTable {
+ public:
+  static BinBoundaryTable Get(double scale, double base, int64_t num_bins) {
+    using Default = DefaultBinBoundaries<T>;
+    if (scale == Default::kScale && base == Default::kBase &&
+        num_bins <= Default::kBoundaries.size()) {
+      return BinBoundaryTable(
+          absl::MakeConstSpan(Default::kBoundaries.data(), num_bins), nullptr);
+    }
+    std::shared_ptr<const std::vector<T>> table =
+        Cache::Get().GetOrCreate(scale, base, num_bins);
+    absl::Span<const T> boundaries(*table);
+    return BinBoundaryTable(boundaries, std::move(table));
+  }
+
+  T operator[](int64_t index) const { return boundaries_[index]; }
+
+  size_t size() const { return boundaries_.size(); }
+
+  // Whether the table is part of the default boundaries computed at compile
+  // time, rather than interned.
+  bool is_default() const { return owner_ == nullptr; }
+
+  // Memory of the table divided by the number of its users, in bytes.
+  int64_t MemoryUsed() const {
+    if (owner_ == nullptr) return 0;
+    return sizeof(T) * boundaries_.size() / owner_.use_count();
+  }
+
+ private:
+  class Cache {
+   public:
+    static Cache& Get() {
+      static Cache* cache = new Cache();
+      return *cache;
+    }
+
+    std::shared_ptr<const std::vector<T>> GetOrCreate(double scale,
+                                                      double base,
+                                                      int64_t num_bins) {
+      Key key(scale, base, num_bins);
+      absl::MutexLock lock(&mutex_);
+      auto it = tables_.find(key);
+      if (it != tables_.end()) {
+        if (std::shared_ptr<const std::vector<T>> table = it->second.lock()) {
+          return table;
+        }
+      }
+
+      // Drop the tables that are no longer used once the cache has doubled
+      // since the last time, so that dropping them takes amortized constant
+      // time.
+      if (tables_.size() >= next_purge_size_) {
+        for (auto entry = tables_.begin(); entry != tables_.end();) {
+          if (entry->second.expired()) {
+            tables_.erase(entry++);
+          } else {
+            ++entry;
+          }
+        }
+        next_purge_size_ = std::max(kMinPurgeSize, 2 * tables_.size());
+      }
+      auto table = std::make_shared<std::vector<T>>(num_bins);
+      FillBinBoundaries<T>(scale, base, *table);
+      tables_[key] = table;
+      return table;
+    }
+
+   private:
+    using Key = std::tuple<double, double, int64_t>;
+
+    static constexpr size_t kMinPurgeSize = 64;
+
+    Cache() = default;
+
+    absl::Mutex mutex_;
+    absl::flat_hash_map<Key, std::weak_ptr<const std::vector<T>>> tables_
+        ABSL_GUARDED_BY(mutex_);
+    size_t next_purge_size_ ABSL_GUARDED_BY(mutex_) = kMinPurgeSize;
+  };
+
+  BinBoundaryTable(absl::Span<const T> boundaries,
+                   std::shared_ptr<const std::vector<T>> owner)
+      : boundaries_(boundaries), owner_(std::move(owner)) {}
+
+  absl::Span<const T> boundaries_;
+
+  // Keeps interned tables alive. Null for the default tables.
+  std::shared_ptr<const std::vector<T>> owner_;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_BIN_BOUNDARIES_H_
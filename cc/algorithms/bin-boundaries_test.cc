@@ -0,0 +1,111 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/bin-boundaries.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+template <typename T>
+class BinBoundariesTest : public testing::Test {};
+
+typedef ::testing::Types<int, int64_t, float, double> NumericTypes;
+TYPED_TEST_SUITE(BinBoundariesTest, NumericTypes);
+
+TYPED_TEST(BinBoundariesTest, DefaultBoundariesCoverDefaultNumBins) {
+  using Default = DefaultBinBoundaries<TypeParam>;
+  // The number of bins chosen by ApproxBounds<T>::Builder by default.
+  int64_t num_bins =
+      std::ceil((std::log(std::numeric_limits<TypeParam>::max()) -
+                 std::log(Default::kScale)) /
+                std::log(Default::kBase)) +
+      1;
+  ASSERT_LE(num_bins, Default::kBoundaries.size());
+  EXPECT_EQ(Default::kBoundaries[num_bins - 1],
+            std::numeric_limits<TypeParam>::max());
+
+  BinBoundaryTable<TypeParam> table = BinBoundaryTable<TypeParam>::Get(
+      Default::kScale, Default::kBase, num_bins);
+  EXPECT_TRUE(table.is_default());
+  EXPECT_EQ(table.MemoryUsed(), 0);
+  EXPECT_EQ(table.size(), num_bins);
+}
+
+TYPED_TEST(BinBoundariesTest, DefaultBoundariesMatchRuntimeBoundaries) {
+  using Default = DefaultBinBoundaries<TypeParam>;
+  std::vector<TypeParam> expected(Default::kBoundaries.size());
+  FillBinBoundaries<TypeParam>(Default::kScale, Default::kBase, expected);
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(Default::kBoundaries[i], expected[i]);
+  }
+}
+
+TYPED_TEST(BinBoundariesTest, InternsTablesLongerThanDefault) {
+  using Default = DefaultBinBoundaries<TypeParam>;
+  BinBoundaryTable<TypeParam> table = BinBoundaryTable<TypeParam>::Get(
+      Default::kScale, Default::kBase, Default::kBoundaries.size() + 1);
+  EXPECT_FALSE(table.is_default());
+  EXPECT_EQ(table[Default::kBoundaries.size()],
+            std::numeric_limits<TypeParam>::max());
+}
+
+TEST(BinBoundaryTableTest, FillsBoundaries) {
+  BinBoundaryTable<int> table = BinBoundaryTable<int>::Get(1, 10, 12);
+  EXPECT_FALSE(table.is_default());
+  const int max = std::numeric_limits<int>::max();
+  std::vector<int> expected = {1,        10,        100, 1000, 10000, 100000,
+                               1000000,  10000000,  100000000,
+                               max,      max,       max};
+  ASSERT_EQ(table.size(), expected.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(table[i], expected[i]);
+  }
+}
+
+TEST(BinBoundaryTableTest, SharesTablesWithSameParameters) {
+  BinBoundaryTable<double> table = BinBoundaryTable<double>::Get(0.5, 3, 100);
+  EXPECT_EQ(table.MemoryUsed(), 100 * sizeof(double));
+  {
+    BinBoundaryTable<double> same = BinBoundaryTable<double>::Get(0.5, 3, 100);
+    BinBoundaryTable<double> other =
+        BinBoundaryTable<double>::Get(0.5, 3, 101);
+    EXPECT_EQ(table.MemoryUsed(), 50 * sizeof(double));
+    EXPECT_EQ(same.MemoryUsed(), 50 * sizeof(double));
+    EXPECT_EQ(other.MemoryUsed(), 101 * sizeof(double));
+  }
+  EXPECT_EQ(table.MemoryUsed(), 100 * sizeof(double));
+}
+
+TEST(BinBoundaryTableTest, RecreatesReleasedTables) {
+  {
+    BinBoundaryTable<double> table = BinBoundaryTable<double>::Get(1, 4, 10);
+    EXPECT_EQ(table[1], 4);
+  }
+  BinBoundaryTable<double> table = BinBoundaryTable<double>::Get(1, 4, 10);
+  EXPECT_EQ(table.MemoryUsed(), 10 * sizeof(double));
+  EXPECT_EQ(table[2], 16);
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -17,11 +17,18 @@
 #ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_BINARY_SEARCH_H_
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_BINARY_SEARCH_H_
 
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
 #include "base/percentile.h"
 #include "google/protobuf/any.pb.h"
+#include "absl/memory/memory.h"
 #include "base/status.h"
 #include "algorithms/algorithm.h"
+#include "algorithms/input-sketch.h"
 #include "algorithms/numerical-mechanisms.h"
+#include "algorithms/search-weights.h"
 #include "proto/util.h"
 #include "base/status_macros.h"
 
@@ -36,6 +43,10 @@
 // noisy counts, the probabilities that the desired quantile is below or above
 // the current value is found, and used to update the probability map.
 //
+// The search ends when the privacy budget runs out, or earlier once nearly all
+// of the probability lies in a subrange that is narrower than the search
+// tolerance or that only contains a single possible result.
+//
 // Visual Example:
 //   e.g., for a dataset {1, 3, 6, 15, 18, 21, 24}, and a search range [0, 32],
 //   to find the median we might go through the following steps:
@@ -53,7 +64,7 @@
 
 namespace differential_privacy {
 
-// Bayesian search creates a map entry for each iteration. Bound this to prevent
+// Bayesian search creates a bucket for each iteration. Bound this to prevent
 // out of memory exception.
 const size_t kMaxBayesianIterations = 10000;
 
@@ -77,6 +88,10 @@ const double kProbabilityTooCertain = .49;
 // Distance from a singularity for which to use the value at the singularity.
 const double kSingularityTolerance = std::pow(10, -6);
 
+// Bayesian search stops once the central subrange holding this much of the
+// probability is resolved, i.e., any value in it gives the same result.
+const double kResolvedProbability = .99;
+
 template <typename T>
 class BinarySearch : public Algorithm<T> {
  public:
@@ -90,7 +105,7 @@ class BinarySearch : public Algorithm<T> {
 
   Summary Serialize() override {
     BinarySearchSummary bs_summary;
-    quantiles_->SerializeToProto(bs_summary.mutable_input());
+    quantiles_->Serialize(&bs_summary);
     Summary summary;
     summary.mutable_data()->PackFrom(bs_summary);
     return summary;
@@ -106,16 +121,12 @@ class BinarySearch : public Algorithm<T> {
       return base::InternalError(
           "Binary search summary unable to be unpacked.");
     }
-    quantiles_->MergeFromProto(bs_summary.input());
-
-    return base::OkStatus();
+    return quantiles_->Merge(bs_summary);
   }
 
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(BinarySearch<T>);
-    if (mechanism_) {
-      memory += mechanism_->MemoryUsed();
-    }
+    int64_t memory = sizeof(BinarySearch<T>) +
+                     NumericalMechanism::MemoryUsedPerOwner(mechanism_);
     if (quantiles_) {
       memory += quantiles_->Memory();
     }
@@ -125,15 +136,26 @@ class BinarySearch : public Algorithm<T> {
  protected:
   BinarySearch(
       double epsilon, T lower, T upper, double quantile,
-      std::unique_ptr<LaplaceMechanism> mechanism,
-      std::unique_ptr<base::Percentile<T>> input_sketch)
+      std::shared_ptr<LaplaceMechanism> mechanism,
+      std::unique_ptr<InputSketch<T>> input_sketch,
+      double search_tolerance = 0)
       : Algorithm<T>(epsilon),
         quantile_(quantile),
         upper_(upper),
         lower_(lower),
+        search_tolerance_(search_tolerance),
         mechanism_(std::move(mechanism)),
         quantiles_(std::move(input_sketch)) {}
 
+  BinarySearch(double epsilon, T lower, T upper, double quantile,
+               std::shared_ptr<LaplaceMechanism> mechanism,
+               std::unique_ptr<base::Percentile<T>> input_sketch,
+               double search_tolerance = 0)
+      : BinarySearch(epsilon, lower, upper, quantile, std::move(mechanism),
+                     absl::make_unique<ExactInputSketch<T>>(
+                         std::move(input_sketch)),
+                     search_tolerance) {}
+
   void ResetState() override { quantiles_->Reset(); }
 
   base::StatusOr<Output> GenerateResult(double privacy_budget,
@@ -164,16 +186,17 @@ class BinarySearch : public Algorithm<T> {
     double remaining_budget = privacy_budget;
     double max_local_budget = privacy_budget * kMaxLocalBudgetFraction;
 
-    // Stores probability that the target value is the subrange. Since the map
-    // is sorted, it contains a sequence of key-value pairs (k_i, v_i) for
-    // i = 1, 2, ..., n, where n is the dictionary size. Then for
-    // i = 1, ..., n-1, the subrange [k_i. k_(i+1)) has probability v_i of
-    // containing the target value. [k_n, upper_] has probability v_n of
-    // containing the target value.
-    std::map<double, double> weight;
+    // Stores probability that the target value is the subrange. The buckets
+    // are sorted by their lower bounds k_i for i = 1, 2, ..., n, where n is the
+    // number of buckets. Then for i = 1, ..., n-1, the subrange [k_i. k_(i+1))
+    // has probability v_i of containing the target value. [k_n, upper_] has
+    // probability v_n of containing the target value. Each iteration adds at
+    // most one bucket, and updates, splits and lookups take O(log n).
+    internal::SearchWeights weight(lower_, upper_);
     double m = lower_ / 2.0 + upper_ / 2.0;
-    weight[lower_] = .5;
-    weight[m] = .5;
+    if (lower_ < m && m < upper_) {
+      weight.Split(weight.FindCumulative(.5), m);
+    }
 
     // Keep doing search iterations while we have enough budget left.
     int iterations = 0;
@@ -207,38 +230,37 @@ class BinarySearch : public Algorithm<T> {
       local_budget = std::min(UpdateLocalBudget(local_budget, update_left),
                               max_local_budget);
 
-      // Apply update multipliers.
-      UpdateWeight(&weight, m, update_left);
-
-      // Find the subrange to split the bucket and its weight in two.
-      double sum_w = 0.0;
-      double lower_bound = static_cast<double>(lower_);
-      double w = 0;
-      auto it = weight.begin();
-      for (; it != weight.end(); it++) {
-        sum_w += it->second;
-        lower_bound = it->first;
-        w = it->second;
-        if (sum_w >= .5) {
-          break;
-        }
-      }
+      // Apply the multipliers. For buckets below m, apply left update. For
+      // buckets above, apply right update. m is always the lower bound of some
+      // bucket.
+      weight.Scale(m, update_left, 1 - update_left);
 
-      double upper_bound = static_cast<double>(upper_);
-      if (it != weight.end() && ++it != weight.end()) {
-        upper_bound = it->first;
-      }
+      // Find the subrange to split the bucket and its weight in two. Rounding
+      // may leave the total weight just short of .5, in which case the last
+      // bucket is split.
+      const internal::SearchWeights::Bucket bucket = weight.FindCumulative(.5);
 
       // Split the bucket into two assuming uniform distribution of probability
-      // within the bucket. The bucket starting at lower_bound will retain the
-      // weight proportional to its length. The bucket starting at the new
+      // within the bucket. The bucket starting at its lower bound will retain
+      // the weight proportional to its length. The bucket starting at the new
       // split-point will get the remaining weight. Do not split the bucket if
-      // m is lower_bound or upper_bound.
-      m = (.5 - sum_w + w) / w * (upper_bound - lower_bound) + lower_bound;
-      if (lower_bound < m && m < upper_bound) {
-        weight[lower_bound] =
-            w * (m - lower_bound) / (upper_bound - lower_bound);
-        weight[m] = w * (upper_bound - m) / (upper_bound - lower_bound);
+      // m is its lower or upper bound.
+      m = (.5 - bucket.cumulative + bucket.weight) / bucket.weight *
+              (bucket.upper - bucket.lower) +
+          bucket.lower;
+      if (bucket.lower < m && m < bucket.upper) {
+        weight.Split(bucket, m);
+      }
+
+      // Stop once further iterations can no longer change the result. The
+      // decision only depends on the noisy counts, so it is post-processing
+      // and the search stays DP for the full privacy_budget. The remaining
+      // budget is left unspent rather than returned, since it was consumed
+      // from the algorithm's budget before the search started.
+      std::pair<double, double> interval =
+          ProbabilityInterval(weight, kResolvedProbability);
+      if (IsResolved(interval.first, interval.second)) {
+        break;
       }
     }
 
@@ -251,6 +273,10 @@ class BinarySearch : public Algorithm<T> {
     Output output = MakeOutput<T>(m);
     *(output.mutable_error_report()->mutable_noise_confidence_interval()) =
         ErrorConfidenceInterval(noise_interval_level, weight, m);
+    if (quantiles_->Resolution() > 0) {
+      output.mutable_error_report()->set_input_sketch_resolution(
+          quantiles_->Resolution());
+    }
 
     return output;
   }
@@ -314,36 +340,6 @@ class BinarySearch : public Algorithm<T> {
     return (-2 + num1 * std::pow(-1 + p, 2) + 4 * p - num2 * p * p) / denom;
   }
 
-  void UpdateWeight(std::map<double, double>* weight, double m,
-                    double update_left) {
-    // Apply the multipliers. For buckets below, apply left update. For buckets
-    // above, apply right update. m is always the lower bound of some bucket.
-    double sum_w = 0;
-    for (std::map<double, double>::iterator it = weight->begin();
-         it != weight->end(); it++) {
-      // Get bounds and weight of the bucket.
-      double lower_bound = it->first;
-      double w = it->second;
-
-      // Apply multiplier for the bucket according to position wrt m.
-      double new_w = w;
-      double update_right = 1 - update_left;
-      if (lower_bound < m) {
-        new_w *= update_left;
-      } else {  // lower_bound >= m
-        new_w *= update_right;
-      }
-      (*weight)[lower_bound] = new_w;
-      sum_w += new_w;
-    }
-
-    // Normalize so weights sum to 1.
-    for (auto const& bucket : *weight) {
-      double lower_bound = bucket.first;
-      (*weight)[lower_bound] /= sum_w;
-    }
-  }
-
   base::StatusOr<double> Percentile(double m) {
     // If there are no inputs, getting the relative rank will return an error.
     // Arbitrarilty say the percentile is 1/2.
@@ -381,39 +377,58 @@ class BinarySearch : public Algorithm<T> {
     return local_budget;
   }
 
+  // Returns the bounds of the smallest run of buckets that holds the central
+  // confidence_level of the probability.
+  std::pair<double, double> ProbabilityInterval(
+      const internal::SearchWeights& weight, double confidence_level) {
+    // The upper end is the first bucket whose cumulative weight exceeds the
+    // upper tail, i.e., is at least the next larger double.
+    return std::make_pair(
+        weight.FindCumulative(.5 - confidence_level / 2).lower,
+        weight
+            .FindCumulative(std::nextafter(.5 + confidence_level / 2, 1.0))
+            .upper);
+  }
+
+  // Returns whether every value in [lower, upper] gives the same result, or
+  // the range is within the search tolerance.
+  bool IsResolved(double lower, double upper) {
+    if (upper - lower <= search_tolerance_) {
+      return true;
+    }
+    // Results of integral type are rounded.
+    if (std::is_integral<T>::value) {
+      return std::round(lower) == std::round(upper);
+    }
+    // Results of floating point type cannot be split any further.
+    return static_cast<T>(lower) == static_cast<T>(upper) ||
+           std::nextafter(lower, upper) >= upper;
+  }
+
   ConfidenceInterval ErrorConfidenceInterval(
-      double confidence_level, const std::map<double, double>& weight,
+      double confidence_level, const internal::SearchWeights& weight,
       double result) {
     ConfidenceInterval interval;
     interval.set_confidence_level(confidence_level);
-    double sum_w = 0.0;
-    bool found_lower = false;
-    std::map<double, double>::const_iterator it;
-    for (it = weight.begin(); it != weight.end(); it++) {
-      sum_w += it->second;
-      if (!found_lower && sum_w >= .5 - confidence_level / 2) {
-        interval.set_upper_bound(result - it->first);
-        found_lower = true;
-      }
-      if (sum_w > (.5 + confidence_level / 2)) {
-        std::map<double, double>::const_iterator it_next = std::next(it, 1);
-        if (it_next == weight.end()) {
-          interval.set_lower_bound(result - upper_);
-        } else {
-          interval.set_lower_bound(result - it_next->first);
-        }
-        break;
-      }
+    std::pair<double, double> bounds =
+        ProbabilityInterval(weight, confidence_level);
+    // Like the result, the values the search ends between are rounded.
+    if (std::is_integral<T>::value) {
+      bounds.first = std::round(bounds.first);
+      bounds.second = std::round(bounds.second);
     }
+    interval.set_lower_bound(result - bounds.second);
+    interval.set_upper_bound(result - bounds.first);
     return interval;
   }
 
   double quantile_;
   T upper_;
   T lower_;
+  double search_tolerance_;
 
-  std::unique_ptr<LaplaceMechanism> mechanism_;
-  std::unique_ptr<base::Percentile<T>> quantiles_;
+  std::shared_ptr<LaplaceMechanism> mechanism_;
+  std::unique_ptr<InputSketch<T>> quantiles_;
 };
 }  // namespace differential_privacy
 
@@ -40,12 +40,13 @@ template <typename T>
 class TestPercentileSearch : public BinarySearch<T> {
  public:
   TestPercentileSearch(double percentile, double epsilon, T lower, T upper,
-                       std::unique_ptr<LaplaceMechanism::Builder> builder)
+                       std::unique_ptr<LaplaceMechanism::Builder> builder,
+                       double search_tolerance = 0)
       : BinarySearch<T>(
             epsilon, lower, upper, percentile,
             absl::WrapUnique<LaplaceMechanism>(dynamic_cast<LaplaceMechanism*>(
                 builder->Build().ValueOrDie().release())),
-            absl::make_unique<base::Percentile<T>>()
+            absl::make_unique<base::Percentile<T>>(), search_tolerance
         ) {}
 };
 
@@ -184,6 +185,38 @@ TEST(BinarySearchTest, ErrorConfidenceInterval) {
   EXPECT_NEAR(interval.lower_bound(), 0, std::pow(10, -6));
 }
 
+// Returns the number of noisy counts drawn by a median search for inputs that
+// all equal 100, for which the search grows more certain every iteration.
+template <typename T>
+int NoisyCountsForMedian(double search_tolerance) {
+  auto builder = absl::make_unique<test_utils::MockLaplaceMechanism::Builder>();
+  int noisy_counts = 0;
+  EXPECT_CALL(*builder->mock(), AddNoise(::testing::_, ::testing::_))
+      .WillRepeatedly([&noisy_counts](double result, double privacy_budget) {
+        ++noisy_counts;
+        return result;
+      });
+  TestPercentileSearch<T> search(.5, std::log(3), 0, 1000, std::move(builder),
+                                 search_tolerance);
+  for (int i = 0; i < kDataSize; ++i) {
+    search.AddEntry(100);
+  }
+  EXPECT_NEAR(GetValue<T>(search.PartialResult().ValueOrDie()), 100,
+              std::max(search_tolerance, 1e-6));
+  return noisy_counts;
+}
+
+TEST(BinarySearchTest, StopsOnceIntegralResultIsResolved) {
+  // The search shrinks its budget per iteration as it grows more certain, so
+  // it would otherwise take thousands of iterations to spend the budget.
+  EXPECT_LT(NoisyCountsForMedian<int64_t>(0), 200);
+}
+
+TEST(BinarySearchTest, StopsWithinSearchTolerance) {
+  EXPECT_LT(NoisyCountsForMedian<double>(1e-3),
+            NoisyCountsForMedian<double>(0));
+}
+
 TEST(BinarySearchTest, MemoryUsed) {
   TestPercentileSearch<double> search(
       .5, std::log(3), 1, 2,
@@ -25,7 +25,9 @@
 #include "algorithms/algorithm.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/bounded-algorithm.h"
+#include "algorithms/clamped-sum.h"
 #include "algorithms/numerical-mechanisms.h"
+#include "algorithms/sparse-bins.h"
 #include "algorithms/util.h"
 #include "proto/summary.pb.h"
 #include "base/status_macros.h"
@@ -76,7 +78,7 @@ class BoundedMean : public Algorithm<T> {
 
       // If manual bounding, check bounds and construct mechanism so we can fail
       // on build if sensitivity is inappropriate.
-      std::unique_ptr<NumericalMechanism> sum_mechanism = nullptr;
+      std::shared_ptr<NumericalMechanism> sum_mechanism = nullptr;
       if (BoundedBuilder::BoundsAreSet()) {
         RETURN_IF_ERROR(CheckBounds(BoundedBuilder::GetLower().value(),
                                     BoundedBuilder::GetUpper().value()));
@@ -93,7 +95,7 @@ class BoundedMean : public Algorithm<T> {
 
       // The count noising doesn't depend on the bounds, so we can always
       // construct the mechanism we use for it here.
-      std::unique_ptr<NumericalMechanism> count_mechanism;
+      std::shared_ptr<NumericalMechanism> count_mechanism;
       ASSIGN_OR_RETURN(
           count_mechanism,
           AlgorithmBuilder::GetMechanismBuilderClone()
@@ -103,10 +105,10 @@ class BoundedMean : public Algorithm<T> {
               .SetLInfSensitivity(
                   AlgorithmBuilder::GetMaxContributionsPerPartition().value_or(
                       1))
-              .Build());
+              .BuildShared());
 
       // Construct BoundedMean.
-      auto mech_builder = AlgorithmBuilder::GetMechanismBuilderClone();
+      auto mech_builder = AlgorithmBuilder::GetSharedMechanismBuilder();
       return absl::WrapUnique(new BoundedMean(
           AlgorithmBuilder::GetEpsilon().value(),
           BoundedBuilder::GetLower().value_or(0),
@@ -119,6 +121,24 @@ class BoundedMean : public Algorithm<T> {
     }
   };
 
+  using Algorithm<T>::AddEntries;
+
+  // With manual bounds, double entries are clamped and summed in bulk by
+  // internal::ClampAndSum, whose result may differ from adding the entries one
+  // at a time in the last bits.
+  void AddEntries(absl::Span<const T> entries) override {
+    if constexpr (std::is_same<T, double>::value) {
+      if (!approx_bounds_) {
+        internal::ClampedSums sums = internal::ClampAndSum(
+            entries, lower_, upper_, /*with_squares=*/false);
+        raw_count_ += sums.count;
+        pos_sum_.Mutable(0) += sums.sum;
+        return;
+      }
+    }
+    Algorithm<T>::AddEntries(entries);
+  }
+
   void AddEntry(const T& t) override {
     // REF:
     // https://stackoverflow.com/questions/61646166/how-to-resolve-fpclassify-ambiguous-call-to-overloaded-function
@@ -128,15 +148,20 @@ class BoundedMean : public Algorithm<T> {
     ++raw_count_;
 
     if (!approx_bounds_) {
-      pos_sum_[0] += Clamp<T>(lower_, upper_, t);
+      pos_sum_.Mutable(0) += Clamp<T>(lower_, upper_, t);
     } else {
       approx_bounds_->AddEntry(t);
 
-      // Find partial sums.
+      // Find the partial sum of the entry's bin. The partial sums of the lower
+      // bins are added for all entries at once by PartialSums.
+      int bin = approx_bounds_->MostSignificantBit(t);
+      T partial = approx_bounds_->template PartialOfBin<T>(t, bin, Difference);
       if (t >= 0) {
-        approx_bounds_->template AddToPartialSums<T>(&pos_sum_, t);
+        pos_sum_.Mutable(bin) += partial;
+        ++pos_bin_count_.Mutable(bin);
       } else {
-        approx_bounds_->template AddToPartialSums<T>(&neg_sum_, t);
+        neg_sum_.Mutable(bin) += partial;
+        ++neg_bin_count_.Mutable(bin);
       }
     }
   }
@@ -145,10 +170,10 @@ class BoundedMean : public Algorithm<T> {
     // Create BoundedMeanSummary.
     BoundedMeanSummary bm_summary;
     bm_summary.set_count(raw_count_);
-    for (T x : pos_sum_) {
+    for (T x : PartialSums(/*negative=*/false)) {
       SetValue(bm_summary.add_pos_sum(), x);
     }
-    for (T x : neg_sum_) {
+    for (T x : PartialSums(/*negative=*/true)) {
       SetValue(bm_summary.add_neg_sum(), x);
     }
     if (approx_bounds_) {
@@ -180,11 +205,16 @@ class BoundedMean : public Algorithm<T> {
       return base::InternalError(
           "Merged BoundedMeans must have equal number of partial sums.");
     }
+    // The merged partial sums are complete, so they are added to the partial
+    // sums of the bins without counting them. Empty bins are skipped so that
+    // they are not stored.
     for (int i = 0; i < pos_sum_.size(); ++i) {
-      pos_sum_[i] += GetValue<T>(bm_summary.pos_sum(i));
+      T x = GetValue<T>(bm_summary.pos_sum(i));
+      if (x != 0) pos_sum_.Mutable(i) += x;
     }
     for (int i = 0; i < neg_sum_.size(); ++i) {
-      neg_sum_[i] += GetValue<T>(bm_summary.neg_sum(i));
+      T x = GetValue<T>(bm_summary.neg_sum(i));
+      if (x != 0) neg_sum_.Mutable(i) += x;
     }
     if (approx_bounds_) {
       Summary approx_bounds_summary;
@@ -196,17 +226,27 @@ class BoundedMean : public Algorithm<T> {
     return base::OkStatus();
   }
 
+  // With automatic bounds, the sum mechanism depends on the bounds found for
+  // the result, so the new algorithm builds its own.
+  base::StatusOr<std::unique_ptr<Algorithm<T>>> CloneEmpty() const override {
+    return std::unique_ptr<Algorithm<T>>(new BoundedMean<T>(
+        Algorithm<T>::GetEpsilon(), lower_, upper_, l0_sensitivity_,
+        max_contributions_per_partition_, mechanism_builder_,
+        approx_bounds_ ? nullptr : sum_mechanism_, count_mechanism_,
+        approx_bounds_ ? approx_bounds_->CloneEmptyApproxBounds() : nullptr));
+  }
+
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(BoundedMean<T>) +
-                   sizeof(T) * (pos_sum_.capacity() + neg_sum_.capacity());
+    int64_t memory = sizeof(BoundedMean<T>) + pos_sum_.MemoryUsed() +
+                     neg_sum_.MemoryUsed() + pos_bin_count_.MemoryUsed() +
+                     neg_bin_count_.MemoryUsed();
     if (approx_bounds_) {
       memory += approx_bounds_->MemoryUsed();
     }
-    if (sum_mechanism_) {
-      memory += sum_mechanism_->MemoryUsed();
-    }
+    memory += NumericalMechanism::MemoryUsedPerOwner(sum_mechanism_) +
+              NumericalMechanism::MemoryUsedPerOwner(count_mechanism_);
     if (mechanism_builder_) {
-      memory += sizeof(*mechanism_builder_);
+      memory += sizeof(*mechanism_builder_) / mechanism_builder_.use_count();
     }
     return memory;
   }
@@ -215,9 +255,10 @@ class BoundedMean : public Algorithm<T> {
   BoundedMean(const double epsilon, T lower, T upper,
               const double l0_sensitivity,
               const double max_contributions_per_partition,
-              std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
-              std::unique_ptr<NumericalMechanism> sum_mechanism,
-              std::unique_ptr<NumericalMechanism> count_mechanism,
+              std::shared_ptr<const NumericalMechanismBuilder>
+                  mechanism_builder,
+              std::shared_ptr<NumericalMechanism> sum_mechanism,
+              std::shared_ptr<NumericalMechanism> count_mechanism,
               std::unique_ptr<ApproxBounds<T>> approx_bounds = nullptr)
       : Algorithm<T>(epsilon),
         raw_count_(0),
@@ -234,10 +275,13 @@ class BoundedMean : public Algorithm<T> {
     // of the ApproxBounds logarithmic histogram. Otherwise, we only need to
     // store one already-clamped sum.
     if (approx_bounds_) {
-      pos_sum_.resize(approx_bounds_->NumPositiveBins(), 0);
-      neg_sum_.resize(approx_bounds_->NumPositiveBins(), 0);
+      int num_bins = approx_bounds_->NumPositiveBins();
+      pos_sum_ = internal::SparseBins<T>(num_bins);
+      neg_sum_ = internal::SparseBins<T>(num_bins);
+      pos_bin_count_ = internal::SparseBins<int64_t>(num_bins);
+      neg_bin_count_ = internal::SparseBins<int64_t>(num_bins);
     } else {
-      pos_sum_.push_back(0);
+      pos_sum_ = internal::SparseBins<T>(1);
     }
   }
 
@@ -264,8 +308,8 @@ class BoundedMean : public Algorithm<T> {
 
       // To find the sum, pass the identity function as the transform.
       sum = approx_bounds_->template ComputeFromPartials<T>(
-          pos_sum_, neg_sum_, [](T x) { return x; }, lower_, upper_,
-          raw_count_);
+          PartialSums(/*negative=*/false), PartialSums(/*negative=*/true),
+          [](T x) { return x; }, lower_, upper_, raw_count_);
 
       // Populate the bounding report with ApproxBounds information.
       *(output.mutable_error_report()->mutable_bounding_report()) =
@@ -299,8 +343,10 @@ class BoundedMean : public Algorithm<T> {
   }
 
   void ResetState() override {
-    std::fill(pos_sum_.begin(), pos_sum_.end(), 0);
-    std::fill(neg_sum_.begin(), neg_sum_.end(), 0);
+    pos_sum_.Clear();
+    neg_sum_.Clear();
+    pos_bin_count_.Clear();
+    neg_bin_count_.Clear();
     raw_count_ = 0;
     if (approx_bounds_) {
       approx_bounds_->Reset();
@@ -309,7 +355,21 @@ class BoundedMean : public Algorithm<T> {
   }
 
  private:
-  static base::StatusOr<std::unique_ptr<NumericalMechanism>> BuildSumMechanism(
+  static T Difference(T val1, T val2) { return val1 - val2; }
+
+  // Returns the partial sums of the positive or negative bins, including the
+  // contributions of the counted entries to the bins below their own.
+  std::vector<T> PartialSums(bool negative) {
+    std::vector<T> sums = negative ? neg_sum_.ToVector() : pos_sum_.ToVector();
+    if (approx_bounds_) {
+      approx_bounds_->AddToLowerPartials(
+          &sums, negative ? neg_bin_count_ : pos_bin_count_, negative,
+          Difference);
+    }
+    return sums;
+  }
+
+  static base::StatusOr<std::shared_ptr<NumericalMechanism>> BuildSumMechanism(
       std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
       const double epsilon, const double l0_sensitivity,
       const double max_contributions_per_partition, const T lower,
@@ -318,25 +378,27 @@ class BoundedMean : public Algorithm<T> {
         .SetL0Sensitivity(l0_sensitivity)
         .SetLInfSensitivity(max_contributions_per_partition *
                             (std::abs(upper - lower) / 2))
-        .Build();
+        .BuildShared();
   }
 
-  // Vectors of partial values stored for automatic clamping.
-  std::vector<T> pos_sum_, neg_sum_;
+  // Partial values stored for automatic clamping. For each bin, only the
+  // contribution of the entries in that bin is stored, along with their count.
+  internal::SparseBins<T> pos_sum_, neg_sum_;
+  internal::SparseBins<int64_t> pos_bin_count_, neg_bin_count_;
 
   size_t raw_count_;
   T lower_, upper_;
   double midpoint_;
 
   // Used to construct mechanism once bounds are obtained for auto-bounding.
-  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_;
+  std::shared_ptr<const NumericalMechanismBuilder> mechanism_builder_;
   const double l0_sensitivity_;
   const int max_contributions_per_partition_;
 
   // The count and the sum will have different sensitivites, so we need
   // different mechanisms to noise them.
-  std::unique_ptr<NumericalMechanism> sum_mechanism_;
-  std::unique_ptr<NumericalMechanism> count_mechanism_;
+  std::shared_ptr<NumericalMechanism> sum_mechanism_;
+  std::shared_ptr<NumericalMechanism> count_mechanism_;
 
   // If this is not nullptr, we are automatically determining bounds. Otherwise,
   // lower and upper contain the manually set bounds.
@@ -484,6 +484,25 @@ TYPED_TEST(BoundedMeanTest, Reset) {
   EXPECT_EQ(GetValue<double>(result.ValueOrDie().elements(0).value()), 1);
 }
 
+TYPED_TEST(BoundedMeanTest, CloneEmpty) {
+  std::unique_ptr<BoundedMean<TypeParam>> prototype =
+      typename BoundedMean<TypeParam>::Builder()
+          .SetEpsilon(1)
+          .SetLower(0)
+          .SetUpper(10)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  prototype->AddEntry(1);
+
+  std::unique_ptr<Algorithm<TypeParam>> bm =
+      prototype->CloneEmpty().ValueOrDie();
+  std::vector<TypeParam> a = {2, 4, 20};
+  bm->AddEntries(a.begin(), a.end());
+  EXPECT_EQ(GetValue<double>(bm->PartialResult().ValueOrDie()), 16.0 / 3);
+  EXPECT_EQ(GetValue<double>(prototype->PartialResult().ValueOrDie()), 1);
+}
+
 TYPED_TEST(BoundedMeanTest, MemoryUsed) {
   std::unique_ptr<BoundedMean<TypeParam>> bm =
       typename BoundedMean<TypeParam>::Builder().Build().ValueOrDie();
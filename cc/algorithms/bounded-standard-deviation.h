@@ -82,6 +82,12 @@ class BoundedStandardDeviation : public Algorithm<T> {
 
   void AddEntry(const T& t) override { variance_->AddEntry(t); }
 
+  using Algorithm<T>::AddEntries;
+
+  void AddEntries(absl::Span<const T> entries) override {
+    variance_->AddEntries(entries);
+  }
+
   // Returns a BoundedVarianceSummary.
   Summary Serialize() override { return variance_->Serialize(); }
 
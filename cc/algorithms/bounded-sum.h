@@ -26,7 +26,9 @@
 #include "algorithms/algorithm.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/bounded-algorithm.h"
+#include "algorithms/clamped-sum.h"
 #include "algorithms/numerical-mechanisms.h"
+#include "algorithms/sparse-bins.h"
 #include "algorithms/util.h"
 #include "proto/summary.pb.h"
 #include "base/status.h"
@@ -64,7 +66,7 @@ class BoundedSum : public Algorithm<T> {
 
       // If manual bounding, construct mechanism so we can fail on build if
       // sensitivity is inappropriate.
-      std::unique_ptr<NumericalMechanism> mechanism = nullptr;
+      std::shared_ptr<NumericalMechanism> mechanism = nullptr;
       if (BoundedBuilder::BoundsAreSet()) {
         RETURN_IF_ERROR(CheckLowerBound(BoundedBuilder::GetLower().value()));
         ASSIGN_OR_RETURN(
@@ -79,7 +81,7 @@ class BoundedSum : public Algorithm<T> {
       }
 
       // Construct BoundedSum.
-      auto mech_builder = AlgorithmBuilder::GetMechanismBuilderClone();
+      auto mech_builder = AlgorithmBuilder::GetSharedMechanismBuilder();
       return absl::WrapUnique(new BoundedSum(
           AlgorithmBuilder::GetEpsilon().value(),
           BoundedBuilder::GetLower().value_or(0),
@@ -91,6 +93,23 @@ class BoundedSum : public Algorithm<T> {
     }
   };
 
+  using Algorithm<T>::AddEntries;
+
+  // With manual bounds, double entries are clamped and summed in bulk by
+  // internal::ClampAndSum, whose result may differ from adding the entries one
+  // at a time in the last bits.
+  void AddEntries(absl::Span<const T> entries) override {
+    if constexpr (std::is_same<T, double>::value) {
+      if (!approx_bounds_) {
+        pos_sum_.Mutable(0) += internal::ClampAndSum(entries, lower_, upper_,
+                                                     /*with_squares=*/false)
+                                   .sum;
+        return;
+      }
+    }
+    Algorithm<T>::AddEntries(entries);
+  }
+
   void AddEntry(const T& t) override {
     // REF:
     // https://stackoverflow.com/questions/61646166/how-to-resolve-fpclassify-ambiguous-call-to-overloaded-function
@@ -101,15 +120,20 @@ class BoundedSum : public Algorithm<T> {
     // If manual bounds are set, clamp immediately and store sum. Otherwise,
     // feed inputs into ApproxBounds and store temporary partial sums.
     if (!approx_bounds_) {
-      pos_sum_[0] += Clamp<T>(lower_, upper_, t);
+      pos_sum_.Mutable(0) += Clamp<T>(lower_, upper_, t);
     } else {
       approx_bounds_->AddEntry(t);
 
-      // Find partial sums.
+      // Find the partial sum of the entry's bin. The partial sums of the lower
+      // bins are added for all entries at once by PartialSums.
+      int bin = approx_bounds_->MostSignificantBit(t);
+      T partial = approx_bounds_->template PartialOfBin<T>(t, bin, Difference);
       if (t >= 0) {
-        approx_bounds_->template AddToPartialSums<T>(&pos_sum_, t);
+        pos_sum_.Mutable(bin) += partial;
+        ++pos_bin_count_.Mutable(bin);
       } else {
-        approx_bounds_->template AddToPartialSums<T>(&neg_sum_, t);
+        neg_sum_.Mutable(bin) += partial;
+        ++neg_bin_count_.Mutable(bin);
       }
     }
   }
@@ -132,10 +156,10 @@ class BoundedSum : public Algorithm<T> {
   Summary Serialize() override {
     // Create BoundedSumSummary.
     BoundedSumSummary bs_summary;
-    for (T x : pos_sum_) {
+    for (T x : PartialSums(/*negative=*/false)) {
       SetValue(bs_summary.add_pos_sum(), x);
     }
-    for (T x : neg_sum_) {
+    for (T x : PartialSums(/*negative=*/true)) {
       SetValue(bs_summary.add_neg_sum(), x);
     }
     if (approx_bounds_) {
@@ -167,11 +191,16 @@ class BoundedSum : public Algorithm<T> {
           "Merged BoundedSum must have the same amount of partial sum "
           "values as this BoundedSum.");
     }
+    // The merged partial sums are complete, so they are added to the partial
+    // sums of the bins without counting them. Empty bins are skipped so that
+    // they are not stored.
     for (int i = 0; i < pos_sum_.size(); ++i) {
-      pos_sum_[i] += GetValue<T>(bs_summary.pos_sum(i));
+      T x = GetValue<T>(bs_summary.pos_sum(i));
+      if (x != 0) pos_sum_.Mutable(i) += x;
     }
     for (int i = 0; i < neg_sum_.size(); ++i) {
-      neg_sum_[i] += GetValue<T>(bs_summary.neg_sum(i));
+      T x = GetValue<T>(bs_summary.neg_sum(i));
+      if (x != 0) neg_sum_.Mutable(i) += x;
     }
     if (approx_bounds_) {
       Summary approx_bounds_summary;
@@ -182,17 +211,26 @@ class BoundedSum : public Algorithm<T> {
     return base::OkStatus();
   }
 
+  // With automatic bounds, the mechanism depends on the bounds found for the
+  // result, so the new algorithm builds its own.
+  base::StatusOr<std::unique_ptr<Algorithm<T>>> CloneEmpty() const override {
+    return std::unique_ptr<Algorithm<T>>(new BoundedSum<T>(
+        Algorithm<T>::GetEpsilon(), lower_, upper_, l0_sensitivity_,
+        max_contributions_per_partition_, mechanism_builder_,
+        approx_bounds_ ? nullptr : mechanism_,
+        approx_bounds_ ? approx_bounds_->CloneEmptyApproxBounds() : nullptr));
+  }
+
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(BoundedSum<T>) +
-                   sizeof(T) * (pos_sum_.capacity() + neg_sum_.capacity());
+    int64_t memory = sizeof(BoundedSum<T>) + pos_sum_.MemoryUsed() +
+                     neg_sum_.MemoryUsed() + pos_bin_count_.MemoryUsed() +
+                     neg_bin_count_.MemoryUsed();
     if (approx_bounds_) {
       memory += approx_bounds_->MemoryUsed();
     }
-    if (mechanism_) {
-      memory += mechanism_->MemoryUsed();
-    }
+    memory += NumericalMechanism::MemoryUsedPerOwner(mechanism_);
     if (mechanism_builder_) {
-      memory += sizeof(*mechanism_builder_);
+      memory += sizeof(*mechanism_builder_) / mechanism_builder_.use_count();
     }
     return memory;
   }
@@ -201,8 +239,9 @@ class BoundedSum : public Algorithm<T> {
   // Protected constructor to allow for testing.
   BoundedSum(double epsilon, T lower, T upper, const double l0_sensitivity,
              const double max_contributions_per_partition,
-             std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
-             std::unique_ptr<NumericalMechanism> mechanism,
+             std::shared_ptr<const NumericalMechanismBuilder>
+                 mechanism_builder,
+             std::shared_ptr<NumericalMechanism> mechanism,
              std::unique_ptr<ApproxBounds<T>> approx_bounds = nullptr)
       : Algorithm<T>(epsilon),
         lower_(lower),
@@ -216,10 +255,13 @@ class BoundedSum : public Algorithm<T> {
     // of the ApproxBounds logarithmic histogram. Otherwise, we only need to
     // store one already-clamped value.
     if (approx_bounds_) {
-      pos_sum_.resize(approx_bounds_->NumPositiveBins(), 0);
-      neg_sum_.resize(approx_bounds_->NumPositiveBins(), 0);
+      int num_bins = approx_bounds_->NumPositiveBins();
+      pos_sum_ = internal::SparseBins<T>(num_bins);
+      neg_sum_ = internal::SparseBins<T>(num_bins);
+      pos_bin_count_ = internal::SparseBins<int64_t>(num_bins);
+      neg_bin_count_ = internal::SparseBins<int64_t>(num_bins);
     } else {
-      pos_sum_.push_back(0);
+      pos_sum_ = internal::SparseBins<T>(1);
     }
   }
 
@@ -230,7 +272,7 @@ class BoundedSum : public Algorithm<T> {
     if (privacy_budget == 0.0) return Output();
 
     Output output;
-    double sum = 0;
+    T sum = 0;
     double remaining_budget = privacy_budget;
 
     if (approx_bounds_) {
@@ -252,7 +294,8 @@ class BoundedSum : public Algorithm<T> {
       // To find the sum, pass the identity function as the transform. We pass
       // count = 0 because the count should never be used.
       sum = approx_bounds_->template ComputeFromPartials<T>(
-          pos_sum_, neg_sum_, [](T x) { return x; }, lower_, upper_, 0);
+          PartialSums(/*negative=*/false), PartialSums(/*negative=*/true),
+          [](T x) { return x; }, lower_, upper_, 0);
 
       // Populate the bounding report with ApproxBounds information.
       *(output.mutable_error_report()->mutable_bounding_report()) =
@@ -283,21 +326,23 @@ class BoundedSum : public Algorithm<T> {
           interval.ValueOrDie();
     }
 
-    // Add noise to sum. Use the remaining privacy budget.
-    double noisy_sum = mechanism_->AddNoise(sum, remaining_budget);
-    if (std::is_integral<T>::value) {
-      T value;
-      SafeCastFromDouble<T>(std::round(noisy_sum), value);
-      AddToOutput<T>(&output, value);
+    // Add noise to sum. Use the remaining privacy budget. Integral sums are
+    // noised in the integer domain.
+    if constexpr (std::is_integral<T>::value) {
+      int64_t noisy_sum = mechanism_->AddInt64Noise(
+          SaturatingCast<int64_t>(sum), remaining_budget);
+      AddToOutput<T>(&output, SaturatingCast<T>(noisy_sum));
     } else {
-      AddToOutput<T>(&output, noisy_sum);
+      AddToOutput<T>(&output, mechanism_->AddNoise(sum, remaining_budget));
     }
     return output;
   }
 
   void ResetState() override {
-    std::fill(pos_sum_.begin(), pos_sum_.end(), 0);
-    std::fill(neg_sum_.begin(), neg_sum_.end(), 0);
+    pos_sum_.Clear();
+    neg_sum_.Clear();
+    pos_bin_count_.Clear();
+    neg_bin_count_.Clear();
     if (approx_bounds_) {
       approx_bounds_->Reset();
       mechanism_ = nullptr;
@@ -305,6 +350,20 @@ class BoundedSum : public Algorithm<T> {
   }
 
  private:
+  static T Difference(T val1, T val2) { return val1 - val2; }
+
+  // Returns the partial sums of the positive or negative bins, including the
+  // contributions of the counted entries to the bins below their own.
+  std::vector<T> PartialSums(bool negative) {
+    std::vector<T> sums = negative ? neg_sum_.ToVector() : pos_sum_.ToVector();
+    if (approx_bounds_) {
+      approx_bounds_->AddToLowerPartials(
+          &sums, negative ? neg_bin_count_ : pos_bin_count_, negative,
+          Difference);
+    }
+    return sums;
+  }
+
   base::StatusOr<ConfidenceInterval> NoiseConfidenceIntervalImpl(
       double confidence_level, double privacy_budget = 1) {
     if (!mechanism_) {
@@ -316,7 +375,7 @@ class BoundedSum : public Algorithm<T> {
                                                privacy_budget);
   }
 
-  static base::StatusOr<std::unique_ptr<NumericalMechanism>> BuildMechanism(
+  static base::StatusOr<std::shared_ptr<NumericalMechanism>> BuildMechanism(
       std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
       const double epsilon, const double l0_sensitivity,
       const double max_contributions_per_partition, const T lower,
@@ -325,24 +384,26 @@ class BoundedSum : public Algorithm<T> {
         .SetL0Sensitivity(l0_sensitivity)
         .SetLInfSensitivity(max_contributions_per_partition *
                             std::max(std::abs(lower), std::abs(upper)))
-        .Build();
+        .BuildShared();
   }
 
-  // Vectors of partial values stored for automatic clamping.
-  std::vector<T> pos_sum_, neg_sum_;
+  // Partial values stored for automatic clamping. For each bin, only the
+  // contribution of the entries in that bin is stored, along with their count.
+  internal::SparseBins<T> pos_sum_, neg_sum_;
+  internal::SparseBins<int64_t> pos_bin_count_, neg_bin_count_;
 
   // If manually set, these values are determined upon construction. Otherwise,
   // they are found in GenerateResult().
   T lower_, upper_;
 
   // Used to construct mechanism once bounds are obtained for auto-bounding.
-  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_;
+  std::shared_ptr<const NumericalMechanismBuilder> mechanism_builder_;
   const double l0_sensitivity_;
   const int max_contributions_per_partition_;
 
   // Will be available upon BoundedSum for manual bounding, and constructed upon
   // GenerateResult for auto-bounding.
-  std::unique_ptr<NumericalMechanism> mechanism_;
+  std::shared_ptr<NumericalMechanism> mechanism_;
 
   // If this is not nullptr, we are automatically determining bounds. Otherwise,
   // lower and upper contain the manually set bounds.
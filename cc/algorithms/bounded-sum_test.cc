@@ -64,6 +64,49 @@ TYPED_TEST(BoundedSumTest, BasicIO) {
               Eq(static_cast<TypeParam>(10)));
 }
 
+TEST(BoundedSumTest, BulkAddEntriesMatchesAddEntry) {
+  std::vector<double> a;
+  for (int i = 0; i < 1001; ++i) {
+    a.push_back(i % 7 == 0 ? std::numeric_limits<double>::quiet_NaN()
+                           : 0.37 * (i % 50) - 5);
+  }
+  auto build = []() {
+    return BoundedSum<double>::Builder()
+        .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+        .SetEpsilon(1.0)
+        .SetLower(-3)
+        .SetUpper(8)
+        .Build()
+        .ValueOrDie();
+  };
+  std::unique_ptr<BoundedSum<double>> bulk = build();
+  std::unique_ptr<BoundedSum<double>> single = build();
+  bulk->AddEntries(absl::MakeConstSpan(a));
+  for (double entry : a) {
+    single->AddEntry(entry);
+  }
+
+  EXPECT_NEAR(GetValue<double>(bulk->PartialResult().ValueOrDie()),
+              GetValue<double>(single->PartialResult().ValueOrDie()), 1e-9);
+}
+
+TEST(BoundedSumTest, IntegralSumKeepsFullPrecision) {
+  // 2^62 + 1 is not representable as a double, so the sum must be noised in
+  // the integer domain.
+  const int64_t value = (int64_t{1} << 62) + 1;
+  std::vector<int64_t> a = {value};
+  std::unique_ptr<BoundedSum<int64_t>> bs =
+      BoundedSum<int64_t>::Builder()
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetEpsilon(1.0)
+          .SetLower(0)
+          .SetUpper(value)
+          .Build()
+          .ValueOrDie();
+  EXPECT_EQ(GetValue<int64_t>(bs->Result(a.begin(), a.end()).ValueOrDie()),
+            value);
+}
+
 TYPED_TEST(BoundedSumTest, BasicIOWithoutIterator) {
   std::vector<TypeParam> a = {0, 0, 10, 10};
   std::unique_ptr<BoundedSum<TypeParam>> bs =
@@ -509,6 +552,54 @@ TYPED_TEST(BoundedSumTest, Reset) {
   EXPECT_EQ(GetValue<TypeParam>(result.ValueOrDie().elements(0).value()), 1);
 }
 
+TYPED_TEST(BoundedSumTest, CloneEmptyManualBounds) {
+  std::unique_ptr<BoundedSum<TypeParam>> prototype =
+      typename BoundedSum<TypeParam>::Builder()
+          .SetEpsilon(1)
+          .SetLower(0)
+          .SetUpper(10)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  prototype->AddEntry(5);
+
+  std::unique_ptr<Algorithm<TypeParam>> bs =
+      prototype->CloneEmpty().ValueOrDie();
+  std::vector<TypeParam> a = {20, 3};
+  bs->AddEntries(a.begin(), a.end());
+  EXPECT_EQ(GetValue<TypeParam>(bs->PartialResult().ValueOrDie()), 13);
+  EXPECT_EQ(GetValue<TypeParam>(prototype->PartialResult().ValueOrDie()), 5);
+}
+
+TYPED_TEST(BoundedSumTest, CloneEmptyApproxBounds) {
+  std::unique_ptr<ApproxBounds<TypeParam>> bounds =
+      typename ApproxBounds<TypeParam>::Builder()
+          .SetNumBins(3)
+          .SetBase(10)
+          .SetScale(1)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetThreshold(1)
+          .Build()
+          .ValueOrDie();
+  std::unique_ptr<BoundedSum<TypeParam>> prototype =
+      typename BoundedSum<TypeParam>::Builder()
+          .SetEpsilon(1)
+          .SetApproxBounds(std::move(bounds))
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  // The bounds found for the prototype do not carry over to the clone.
+  std::vector<TypeParam> a = {-10, 1000};
+  prototype->AddEntries(a.begin(), a.end());
+  EXPECT_OK(prototype->PartialResult());
+
+  std::unique_ptr<Algorithm<TypeParam>> bs =
+      prototype->CloneEmpty().ValueOrDie();
+  std::vector<TypeParam> b = {-100, 100, 1};
+  bs->AddEntries(b.begin(), b.end());
+  EXPECT_EQ(GetValue<TypeParam>(bs->PartialResult().ValueOrDie()), 1);
+}
+
 TYPED_TEST(BoundedSumTest, Memory) {
   std::unique_ptr<ApproxBounds<TypeParam>> bounds_small =
       typename ApproxBounds<TypeParam>::Builder()
@@ -535,5 +626,22 @@ TYPED_TEST(BoundedSumTest, Memory) {
   EXPECT_GE(bs_big->MemoryUsed(), bs_small->MemoryUsed());
 }
 
+TEST(BoundedSumTest, AutoBoundsMemoryGrowsWithOccupiedBins) {
+  std::unique_ptr<ApproxBounds<double>> bounds =
+      ApproxBounds<double>::Builder().Build().ValueOrDie();
+  const int64_t num_bins = bounds->NumPositiveBins();
+  std::unique_ptr<BoundedSum<double>> bs = BoundedSum<double>::Builder()
+                                               .SetApproxBounds(std::move(bounds))
+                                               .Build()
+                                               .ValueOrDie();
+  bs->AddEntry(-1);
+  bs->AddEntry(2);
+  bs->AddEntry(1000);
+
+  // Only the bin boundaries take memory for every bin. Storing the histogram
+  // and the partial sums densely would take four times as much.
+  EXPECT_LT(bs->MemoryUsed(), 2 * num_bins * sizeof(double));
+}
+
 }  //  namespace
 }  // namespace differential_privacy
@@ -25,7 +25,9 @@
 #include "algorithms/algorithm.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/bounded-algorithm.h"
+#include "algorithms/clamped-sum.h"
 #include "algorithms/numerical-mechanisms.h"
+#include "algorithms/sparse-bins.h"
 #include "algorithms/util.h"
 #include "proto/util.h"
 
@@ -97,8 +99,8 @@ class BoundedVariance : public Algorithm<T> {
 
       // If manual bounding, check bounds and construct mechanism so we can fail
       // on build if sensitivity is inappropriate.
-      std::unique_ptr<NumericalMechanism> sum_mechanism = nullptr;
-      std::unique_ptr<NumericalMechanism> sos_mechanism = nullptr;
+      std::shared_ptr<NumericalMechanism> sum_mechanism = nullptr;
+      std::shared_ptr<NumericalMechanism> sos_mechanism = nullptr;
       if (BoundedBuilder::BoundsAreSet()) {
         RETURN_IF_ERROR(CheckBounds(BoundedBuilder::GetLower().value(),
                                     BoundedBuilder::GetUpper().value()));
@@ -122,7 +124,7 @@ class BoundedVariance : public Algorithm<T> {
                 BoundedBuilder::GetUpper().value()));
       }
 
-      std::unique_ptr<NumericalMechanism> count_mechanism;
+      std::shared_ptr<NumericalMechanism> count_mechanism;
       ASSIGN_OR_RETURN(
           count_mechanism,
           AlgorithmBuilder::GetMechanismBuilderClone()
@@ -132,10 +134,10 @@ class BoundedVariance : public Algorithm<T> {
               .SetLInfSensitivity(
                   AlgorithmBuilder::GetMaxContributionsPerPartition().value_or(
                       1))
-              .Build());
+              .BuildShared());
 
       // Construct bounded variance.
-      auto mech_builder = AlgorithmBuilder::GetMechanismBuilderClone();
+      auto mech_builder = AlgorithmBuilder::GetSharedMechanismBuilder();
       return absl::WrapUnique(new BoundedVariance(
           AlgorithmBuilder::GetEpsilon().value(),
           BoundedBuilder::GetLower().value_or(0),
@@ -148,6 +150,25 @@ class BoundedVariance : public Algorithm<T> {
     }
   };
 
+  using Algorithm<T>::AddEntries;
+
+  // With manual bounds, double entries are clamped and summed in bulk by
+  // internal::ClampAndSum, whose sums may differ from adding the entries one
+  // at a time in the last bits.
+  void AddEntries(absl::Span<const T> entries) override {
+    if constexpr (std::is_same<T, double>::value) {
+      if (!approx_bounds_) {
+        internal::ClampedSums sums = internal::ClampAndSum(
+            entries, lower_, upper_, /*with_squares=*/true);
+        raw_count_ += sums.count;
+        pos_sum_.Mutable(0) += sums.sum;
+        pos_sum_of_squares_.Mutable(0) += sums.sum_of_squares;
+        return;
+      }
+    }
+    Algorithm<T>::AddEntries(entries);
+  }
+
   void AddEntry(const T& t) override {
     // Drop value if it is NaN.
     // REF:
@@ -163,25 +184,27 @@ class BoundedVariance : public Algorithm<T> {
     // feed input into ApproxBounds algorithm.
     if (!approx_bounds_) {
       double clamped = Clamp<double>(lower_, upper_, t);
-      pos_sum_[0] += clamped;
-      pos_sum_of_squares_[0] += clamped * clamped;
+      pos_sum_.Mutable(0) += clamped;
+      pos_sum_of_squares_.Mutable(0) += clamped * clamped;
     } else {
       approx_bounds_->AddEntry(t);
 
-      // Add to partial sums and sum of squares.
-      auto difference_of_squares = [](T val1, T val2) {
-        // Lessen the chance of becoming inf/-inf by calculating it like this.
-        return (static_cast<double>(val1) + val2) *
-               (static_cast<double>(val1) - val2);
-      };
+      // Add to partial sums and sum of squares of the entry's bin. The partial
+      // values of the lower bins are added for all entries at once by
+      // Partials.
+      int bin = approx_bounds_->MostSignificantBit(t);
+      T partial = approx_bounds_->template PartialOfBin<T>(t, bin, Difference);
+      double partial_of_squares =
+          approx_bounds_->template PartialOfBin<double>(t, bin,
+                                                        DifferenceOfSquares);
       if (t >= 0) {
-        approx_bounds_->template AddToPartialSums<T>(&pos_sum_, t);
-        approx_bounds_->template AddToPartials<double>(&pos_sum_of_squares_, t,
-                                                       difference_of_squares);
+        pos_sum_.Mutable(bin) += partial;
+        pos_sum_of_squares_.Mutable(bin) += partial_of_squares;
+        ++pos_bin_count_.Mutable(bin);
       } else {
-        approx_bounds_->template AddToPartialSums<T>(&neg_sum_, t);
-        approx_bounds_->template AddToPartials<double>(&neg_sum_of_squares_, t,
-                                                       difference_of_squares);
+        neg_sum_.Mutable(bin) += partial;
+        neg_sum_of_squares_.Mutable(bin) += partial_of_squares;
+        ++neg_bin_count_.Mutable(bin);
       }
     }
   }
@@ -190,16 +213,18 @@ class BoundedVariance : public Algorithm<T> {
     // Create BoundedVarianceSummary.
     BoundedVarianceSummary bv_summary;
     bv_summary.set_count(raw_count_);
-    for (T x : pos_sum_) {
+    for (T x : Partials(pos_sum_, /*negative=*/false, Difference)) {
       SetValue(bv_summary.add_pos_sum(), x);
     }
-    for (T x : neg_sum_) {
+    for (T x : Partials(neg_sum_, /*negative=*/true, Difference)) {
       SetValue(bv_summary.add_neg_sum(), x);
     }
-    for (T x : pos_sum_of_squares_) {
+    for (double x : Partials(pos_sum_of_squares_, /*negative=*/false,
+                             DifferenceOfSquares)) {
       bv_summary.add_pos_sum_of_squares(x);
     }
-    for (T x : neg_sum_of_squares_) {
+    for (double x : Partials(neg_sum_of_squares_, /*negative=*/true,
+                             DifferenceOfSquares)) {
       bv_summary.add_neg_sum_of_squares(x);
     }
     if (approx_bounds_) {
@@ -239,15 +264,22 @@ class BoundedVariance : public Algorithm<T> {
           "sum or sum of squares values as this BoundedVariance.");
     }
 
-    // Add count and partial values to current ones.
+    // Add count and partial values to current ones. The merged partial values
+    // are complete, so they are added to the partial values of the bins
+    // without counting them. Empty bins are skipped so that they are not
+    // stored.
     raw_count_ += bv_summary.count();
     for (int i = 0; i < pos_sum_.size(); ++i) {
-      pos_sum_[i] += GetValue<T>(bv_summary.pos_sum(i));
-      pos_sum_of_squares_[i] += bv_summary.pos_sum_of_squares(i);
+      T x = GetValue<T>(bv_summary.pos_sum(i));
+      if (x != 0) pos_sum_.Mutable(i) += x;
+      double y = bv_summary.pos_sum_of_squares(i);
+      if (y != 0) pos_sum_of_squares_.Mutable(i) += y;
     }
     for (int i = 0; i < neg_sum_.size(); ++i) {
-      neg_sum_[i] += GetValue<T>(bv_summary.neg_sum(i));
-      neg_sum_of_squares_[i] += bv_summary.neg_sum_of_squares(i);
+      T x = GetValue<T>(bv_summary.neg_sum(i));
+      if (x != 0) neg_sum_.Mutable(i) += x;
+      double y = bv_summary.neg_sum_of_squares(i);
+      if (y != 0) neg_sum_of_squares_.Mutable(i) += y;
     }
 
     // Merge approx bounds if auto-clamping.
@@ -261,19 +293,30 @@ class BoundedVariance : public Algorithm<T> {
     return base::OkStatus();
   }
 
+  // With automatic bounds, the sum and sum of squares mechanisms depend on the
+  // bounds found for the result, so the new algorithm builds its own.
+  base::StatusOr<std::unique_ptr<Algorithm<T>>> CloneEmpty() const override {
+    return std::unique_ptr<Algorithm<T>>(new BoundedVariance<T>(
+        Algorithm<T>::GetEpsilon(), lower_, upper_, l0_sensitivity_,
+        max_contributions_per_partition_, mechanism_builder_,
+        approx_bounds_ ? nullptr : sum_mechanism_,
+        approx_bounds_ ? nullptr : sos_mechanism_, count_mechanism_,
+        approx_bounds_ ? approx_bounds_->CloneEmptyApproxBounds() : nullptr));
+  }
+
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(BoundedVariance<T>) +
-                   sizeof(T) * (pos_sum_.capacity() + neg_sum_.capacity()) +
-                   sizeof(double) * (pos_sum_of_squares_.capacity() +
-                                     neg_sum_of_squares_.capacity());
+    int64_t memory = sizeof(BoundedVariance<T>) + pos_sum_.MemoryUsed() +
+                     neg_sum_.MemoryUsed() + pos_sum_of_squares_.MemoryUsed() +
+                     neg_sum_of_squares_.MemoryUsed() +
+                     pos_bin_count_.MemoryUsed() + neg_bin_count_.MemoryUsed();
     if (approx_bounds_) {
       memory += approx_bounds_->MemoryUsed();
     }
-    if (sum_mechanism_) {
-      memory += sum_mechanism_->MemoryUsed();
-    }
+    memory += NumericalMechanism::MemoryUsedPerOwner(sum_mechanism_) +
+              NumericalMechanism::MemoryUsedPerOwner(sos_mechanism_) +
+              NumericalMechanism::MemoryUsedPerOwner(count_mechanism_);
     if (mechanism_builder_) {
-      memory += sizeof(*mechanism_builder_);
+      memory += sizeof(*mechanism_builder_) / mechanism_builder_.use_count();
     }
     return memory;
   }
@@ -282,10 +325,11 @@ class BoundedVariance : public Algorithm<T> {
   BoundedVariance(const double epsilon, const T lower, const T upper,
                   const double l0_sensitivity,
                   const double max_contributions_per_partition,
-                  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
-                  std::unique_ptr<NumericalMechanism> sum_mechanism,
-                  std::unique_ptr<NumericalMechanism> sos_mechanism,
-                  std::unique_ptr<NumericalMechanism> count_mechanism,
+                  std::shared_ptr<const NumericalMechanismBuilder>
+                      mechanism_builder,
+                  std::shared_ptr<NumericalMechanism> sum_mechanism,
+                  std::shared_ptr<NumericalMechanism> sos_mechanism,
+                  std::shared_ptr<NumericalMechanism> count_mechanism,
                   std::unique_ptr<ApproxBounds<T>> approx_bounds = nullptr)
       : Algorithm<T>(epsilon),
         raw_count_(0),
@@ -302,13 +346,16 @@ class BoundedVariance : public Algorithm<T> {
     // of the ApproxBounds logarithmic histogram. Otherwise, we only need to
     // store one already-clamped value.
     if (approx_bounds_) {
-      pos_sum_.resize(approx_bounds_->NumPositiveBins(), 0);
-      neg_sum_.resize(approx_bounds_->NumPositiveBins(), 0);
-      pos_sum_of_squares_.resize(approx_bounds_->NumPositiveBins(), 0);
-      neg_sum_of_squares_.resize(approx_bounds_->NumPositiveBins(), 0);
+      int num_bins = approx_bounds_->NumPositiveBins();
+      pos_sum_ = internal::SparseBins<T>(num_bins);
+      neg_sum_ = internal::SparseBins<T>(num_bins);
+      pos_sum_of_squares_ = internal::SparseBins<double>(num_bins);
+      neg_sum_of_squares_ = internal::SparseBins<double>(num_bins);
+      pos_bin_count_ = internal::SparseBins<int64_t>(num_bins);
+      neg_bin_count_ = internal::SparseBins<int64_t>(num_bins);
     } else {
-      pos_sum_.push_back(0);
-      pos_sum_of_squares_.push_back(0);
+      pos_sum_ = internal::SparseBins<T>(1);
+      pos_sum_of_squares_ = internal::SparseBins<double>(1);
     }
   }
 
@@ -336,13 +383,17 @@ class BoundedVariance : public Algorithm<T> {
 
       // To find the sum, pass the identity function as the transform.
       sum = approx_bounds_->template ComputeFromPartials<T>(
-          pos_sum_, neg_sum_, [](T x) { return x; }, lower_, upper_,
-          raw_count_);
+          Partials(pos_sum_, /*negative=*/false, Difference),
+          Partials(neg_sum_, /*negative=*/true, Difference),
+          [](T x) { return x; }, lower_, upper_, raw_count_);
 
       // To find sum of squares, pass the square function.
       sos = approx_bounds_->template ComputeFromPartials<double>(
-          pos_sum_of_squares_, neg_sum_of_squares_, [](T x) { return x * x; },
-          lower_, upper_, raw_count_);
+          Partials(pos_sum_of_squares_, /*negative=*/false,
+                   DifferenceOfSquares),
+          Partials(neg_sum_of_squares_, /*negative=*/true,
+                   DifferenceOfSquares),
+          [](T x) { return x * x; }, lower_, upper_, raw_count_);
 
       // Populate the bounding report with ApproxBounds information.
       *(output.mutable_error_report()->mutable_bounding_report()) =
@@ -417,10 +468,12 @@ class BoundedVariance : public Algorithm<T> {
   }
 
   void ResetState() override {
-    std::fill(pos_sum_.begin(), pos_sum_.end(), 0);
-    std::fill(pos_sum_of_squares_.begin(), pos_sum_of_squares_.end(), 0);
-    std::fill(neg_sum_.begin(), neg_sum_.end(), 0);
-    std::fill(neg_sum_of_squares_.begin(), neg_sum_of_squares_.end(), 0);
+    pos_sum_.Clear();
+    pos_sum_of_squares_.Clear();
+    neg_sum_.Clear();
+    neg_sum_of_squares_.Clear();
+    pos_bin_count_.Clear();
+    neg_bin_count_.Clear();
     raw_count_ = 0;
 
     if (approx_bounds_) {
@@ -430,6 +483,28 @@ class BoundedVariance : public Algorithm<T> {
     }
   }
 
+  static T Difference(T val1, T val2) { return val1 - val2; }
+
+  static double DifferenceOfSquares(T val1, T val2) {
+    // Lessen the chance of becoming inf/-inf by calculating it like this.
+    return (static_cast<double>(val1) + val2) *
+           (static_cast<double>(val1) - val2);
+  }
+
+  // Returns the partial values of the positive or negative bins, including
+  // the contributions of the counted entries to the bins below their own.
+  template <typename T2, typename MakePartial>
+  std::vector<T2> Partials(const internal::SparseBins<T2>& partials,
+                           bool negative, MakePartial make_partial) {
+    std::vector<T2> result = partials.ToVector();
+    if (approx_bounds_) {
+      approx_bounds_->AddToLowerPartials(
+          &result, negative ? neg_bin_count_ : pos_bin_count_, negative,
+          make_partial);
+    }
+    return result;
+  }
+
   static double IntervalLengthSquared(T lower, T upper) {
     return std::pow(static_cast<double>(upper - lower), 2);
   }
@@ -453,7 +528,7 @@ class BoundedVariance : public Algorithm<T> {
     return std::abs(upper * upper - lower * lower);
   }
 
-  static base::StatusOr<std::unique_ptr<NumericalMechanism>> BuildSumMechanism(
+  static base::StatusOr<std::shared_ptr<NumericalMechanism>> BuildSumMechanism(
       std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
       const double epsilon, const double l0_sensitivity,
       const double max_contributions_per_partition, const T lower,
@@ -462,10 +537,10 @@ class BoundedVariance : public Algorithm<T> {
         .SetL0Sensitivity(l0_sensitivity)
         .SetLInfSensitivity(max_contributions_per_partition *
                             static_cast<double>(upper - lower) / 2.0)
-        .Build();
+        .BuildShared();
   }
 
-  static base::StatusOr<std::unique_ptr<NumericalMechanism>>
+  static base::StatusOr<std::shared_ptr<NumericalMechanism>>
   BuildSumOfSquaresMechanism(
       std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
       const double epsilon, const double l0_sensitivity,
@@ -475,23 +550,25 @@ class BoundedVariance : public Algorithm<T> {
         .SetL0Sensitivity(l0_sensitivity)
         .SetLInfSensitivity(max_contributions_per_partition *
                             (RangeOfSquares(lower, upper) / 2))
-        .Build();
+        .BuildShared();
   }
 
-  // Vectors of partial values stored for automatic clamping.
-  std::vector<T> pos_sum_, neg_sum_;
-  std::vector<double> pos_sum_of_squares_, neg_sum_of_squares_;
+  // Partial values stored for automatic clamping. For each bin, only the
+  // contribution of the entries in that bin is stored, along with their count.
+  internal::SparseBins<T> pos_sum_, neg_sum_;
+  internal::SparseBins<double> pos_sum_of_squares_, neg_sum_of_squares_;
+  internal::SparseBins<int64_t> pos_bin_count_, neg_bin_count_;
   size_t raw_count_;
   T lower_, upper_;
 
   // Used to construct mechanism once bounds are obtained.
-  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_;
+  std::shared_ptr<const NumericalMechanismBuilder> mechanism_builder_;
   const double l0_sensitivity_;
   const int max_contributions_per_partition_;
 
-  std::unique_ptr<NumericalMechanism> sum_mechanism_;
-  std::unique_ptr<NumericalMechanism> sos_mechanism_;
-  std::unique_ptr<NumericalMechanism> count_mechanism_;
+  std::shared_ptr<NumericalMechanism> sum_mechanism_;
+  std::shared_ptr<NumericalMechanism> sos_mechanism_;
+  std::shared_ptr<NumericalMechanism> count_mechanism_;
 
   // If this is not nullptr, we are automatically determining bounds. Otherwise,
   // lower and upper contain the manually set bounds.
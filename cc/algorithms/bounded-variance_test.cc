@@ -61,6 +61,33 @@ TYPED_TEST(BoundedVarianceTest, BasicTest) {
   EXPECT_EQ(GetValue<double>(bv->Result(a.begin(), a.end()).ValueOrDie()), 2.0);
 }
 
+TEST(BoundedVarianceTest, BulkAddEntriesMatchesAddEntry) {
+  std::vector<double> a;
+  for (int i = 0; i < 1001; ++i) {
+    a.push_back(i % 7 == 0 ? std::numeric_limits<double>::quiet_NaN()
+                           : 0.37 * (i % 50) - 5);
+  }
+  auto build = []() {
+    return BoundedVariance<double>::Builder()
+        .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+        .SetEpsilon(1.0)
+        .SetLower(-3)
+        .SetUpper(8)
+        .Build()
+        .ValueOrDie();
+  };
+  std::unique_ptr<BoundedVariance<double>> bulk = build();
+  std::unique_ptr<BoundedVariance<double>> single = build();
+  bulk->AddEntries(absl::MakeConstSpan(a));
+  for (double entry : a) {
+    single->AddEntry(entry);
+  }
+
+  EXPECT_THAT(GetValue<double>(bulk->PartialResult().ValueOrDie()),
+              DoubleNear(GetValue<double>(single->PartialResult().ValueOrDie()),
+                         1e-9));
+}
+
 TYPED_TEST(BoundedVarianceTest, RepeatedResultTest) {
   std::vector<TypeParam> a = {1, 2, 3, 4, 5};
   std::unique_ptr<BoundedVariance<TypeParam>> bv =
@@ -532,6 +559,23 @@ TYPED_TEST(BoundedVarianceTest, Reset) {
   EXPECT_EQ(GetValue<double>(result.ValueOrDie().elements(0).value()), 10000);
 }
 
+TYPED_TEST(BoundedVarianceTest, CloneEmpty) {
+  std::unique_ptr<BoundedVariance<TypeParam>> prototype =
+      typename BoundedVariance<TypeParam>::Builder()
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetEpsilon(1.0)
+          .SetLower(0)
+          .SetUpper(6)
+          .Build()
+          .ValueOrDie();
+  prototype->AddEntry(6);
+
+  std::unique_ptr<Algorithm<TypeParam>> bv =
+      prototype->CloneEmpty().ValueOrDie();
+  std::vector<TypeParam> a = {1, 2, 3, 4, 5};
+  EXPECT_EQ(GetValue<double>(bv->Result(a.begin(), a.end()).ValueOrDie()), 2.0);
+}
+
 TYPED_TEST(BoundedVarianceTest, MemoryUsed) {
   std::unique_ptr<BoundedVariance<TypeParam>> bv =
       typename BoundedVariance<TypeParam>::Builder().Build().ValueOrDie();
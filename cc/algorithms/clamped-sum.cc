@@ -0,0 +1,206 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/clamped-sum.h"
+
+#include <cmath>
+
+#include "base/logging.h"
+#include "algorithms/util.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DIFFERENTIAL_PRIVACY_CLAMPED_SUM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+// Partial sums of a kernel, one per lane.
+struct LaneSums {
+  int64_t count = 0;
+  double sums[kClampedSumLanes] = {0, 0, 0, 0};
+  double squares[kClampedSumLanes] = {0, 0, 0, 0};
+};
+
+// Adds entries [start, entries.size()) to the lane sums one by one. Used by
+// the scalar kernel for all entries and by the vector kernels for the tail.
+// A NaN entry is skipped, which leaves the partial sums bitwise identical to
+// adding +0.0 as the vector kernels do, since no partial sum can be -0.0.
+template <bool kWithSquares>
+void AccumulateScalar(absl::Span<const double> entries, size_t start,
+                      double lower, double upper, LaneSums* lanes) {
+  for (size_t i = start; i < entries.size(); ++i) {
+    double entry = entries[i];
+    if (std::isnan(entry)) continue;
+    ++lanes->count;
+    double clamped = Clamp(lower, upper, entry);
+    lanes->sums[i % kClampedSumLanes] += clamped;
+    if (kWithSquares) {
+      lanes->squares[i % kClampedSumLanes] += clamped * clamped;
+    }
+  }
+}
+
+#ifdef DIFFERENTIAL_PRIVACY_CLAMPED_SUM_X86
+
+// min_pd(a, b) returns a < b ? a : b and max_pd(a, b) returns a > b ? a : b,
+// so max(lower, min(upper, x)) matches Clamp(lower, upper, x) bitwise and
+// keeps NaNs, which are then masked to +0.0.
+template <bool kWithSquares>
+void AccumulateSse2(absl::Span<const double> entries, double lower,
+                    double upper, LaneSums* lanes) {
+  const __m128d lower_vec = _mm_set1_pd(lower);
+  const __m128d upper_vec = _mm_set1_pd(upper);
+  __m128d sums_lo = _mm_setzero_pd();
+  __m128d sums_hi = _mm_setzero_pd();
+  __m128d squares_lo = _mm_setzero_pd();
+  __m128d squares_hi = _mm_setzero_pd();
+  int64_t count = 0;
+  const size_t num_blocks = entries.size() / kClampedSumLanes;
+  for (size_t block = 0; block < num_blocks; ++block) {
+    const double* data = entries.data() + block * kClampedSumLanes;
+    __m128d lo = _mm_loadu_pd(data);
+    __m128d hi = _mm_loadu_pd(data + 2);
+    __m128d lo_mask = _mm_cmpord_pd(lo, lo);
+    __m128d hi_mask = _mm_cmpord_pd(hi, hi);
+    count += __builtin_popcount(_mm_movemask_pd(lo_mask)) +
+             __builtin_popcount(_mm_movemask_pd(hi_mask));
+    lo = _mm_and_pd(
+        lo_mask, _mm_max_pd(lower_vec, _mm_min_pd(upper_vec, lo)));
+    hi = _mm_and_pd(
+        hi_mask, _mm_max_pd(lower_vec, _mm_min_pd(upper_vec, hi)));
+    sums_lo = _mm_add_pd(sums_lo, lo);
+    sums_hi = _mm_add_pd(sums_hi, hi);
+    if (kWithSquares) {
+      squares_lo = _mm_add_pd(squares_lo, _mm_mul_pd(lo, lo));
+      squares_hi = _mm_add_pd(squares_hi, _mm_mul_pd(hi, hi));
+    }
+  }
+  lanes->count = count;
+  _mm_storeu_pd(lanes->sums, sums_lo);
+  _mm_storeu_pd(lanes->sums + 2, sums_hi);
+  _mm_storeu_pd(lanes->squares, squares_lo);
+  _mm_storeu_pd(lanes->squares + 2, squares_hi);
+  AccumulateScalar<kWithSquares>(entries, num_blocks * kClampedSumLanes, lower,
+                                 upper, lanes);
+}
+
+template <bool kWithSquares>
+__attribute__((target("avx2"))) void AccumulateAvx2(
+    absl::Span<const double> entries, double lower, double upper,
+    LaneSums* lanes) {
+  const __m256d lower_vec = _mm256_set1_pd(lower);
+  const __m256d upper_vec = _mm256_set1_pd(upper);
+  __m256d sums = _mm256_setzero_pd();
+  __m256d squares = _mm256_setzero_pd();
+  int64_t count = 0;
+  const size_t num_blocks = entries.size() / kClampedSumLanes;
+  for (size_t block = 0; block < num_blocks; ++block) {
+    __m256d values =
+        _mm256_loadu_pd(entries.data() + block * kClampedSumLanes);
+    __m256d mask = _mm256_cmp_pd(values, values, _CMP_ORD_Q);
+    count += __builtin_popcount(_mm256_movemask_pd(mask));
+    values = _mm256_and_pd(
+        mask,
+        _mm256_max_pd(lower_vec, _mm256_min_pd(upper_vec, values)));
+    sums = _mm256_add_pd(sums, values);
+    if (kWithSquares) {
+      squares = _mm256_add_pd(squares, _mm256_mul_pd(values, values));
+    }
+  }
+  lanes->count = count;
+  _mm256_storeu_pd(lanes->sums, sums);
+  _mm256_storeu_pd(lanes->squares, squares);
+  AccumulateScalar<kWithSquares>(entries, num_blocks * kClampedSumLanes, lower,
+                                 upper, lanes);
+}
+
+#endif  // DIFFERENTIAL_PRIVACY_CLAMPED_SUM_X86
+
+template <bool kWithSquares>
+LaneSums Accumulate(absl::Span<const double> entries, double lower,
+                    double upper, ClampedSumKernel kernel) {
+  LaneSums lanes;
+  switch (kernel) {
+#ifdef DIFFERENTIAL_PRIVACY_CLAMPED_SUM_X86
+    case ClampedSumKernel::kAvx2:
+      AccumulateAvx2<kWithSquares>(entries, lower, upper, &lanes);
+      break;
+    case ClampedSumKernel::kSse2:
+      AccumulateSse2<kWithSquares>(entries, lower, upper, &lanes);
+      break;
+#endif
+    default:
+      AccumulateScalar<kWithSquares>(entries, 0, lower, upper, &lanes);
+      break;
+  }
+  return lanes;
+}
+
+}  // namespace
+
+bool IsClampedSumKernelSupported(ClampedSumKernel kernel) {
+  switch (kernel) {
+    case ClampedSumKernel::kScalar:
+      return true;
+#ifdef DIFFERENTIAL_PRIVACY_CLAMPED_SUM_X86
+    case ClampedSumKernel::kSse2:
+      // SSE2 is part of the x86-64 baseline.
+      return true;
+    case ClampedSumKernel::kAvx2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+ClampedSumKernel BestClampedSumKernel() {
+  for (ClampedSumKernel kernel :
+       {ClampedSumKernel::kAvx2, ClampedSumKernel::kSse2}) {
+    if (IsClampedSumKernelSupported(kernel)) return kernel;
+  }
+  return ClampedSumKernel::kScalar;
+}
+
+ClampedSums ClampAndSum(absl::Span<const double> entries, double lower,
+                        double upper, bool with_squares) {
+  static const ClampedSumKernel kernel = BestClampedSumKernel();
+  return ClampAndSum(entries, lower, upper, with_squares, kernel);
+}
+
+ClampedSums ClampAndSum(absl::Span<const double> entries, double lower,
+                        double upper, bool with_squares,
+                        ClampedSumKernel kernel) {
+  DCHECK(IsClampedSumKernelSupported(kernel));
+  LaneSums lanes =
+      with_squares ? Accumulate<true>(entries, lower, upper, kernel)
+                   : Accumulate<false>(entries, lower, upper, kernel);
+  ClampedSums result;
+  result.count = lanes.count;
+  result.sum =
+      (lanes.sums[0] + lanes.sums[1]) + (lanes.sums[2] + lanes.sums[3]);
+  if (with_squares) {
+    result.sum_of_squares = (lanes.squares[0] + lanes.squares[1]) +
+                            (lanes.squares[2] + lanes.squares[3]);
+  }
+  return result;
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
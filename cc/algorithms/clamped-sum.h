@@ -0,0 +1,74 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_CLAMPED_SUM_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_CLAMPED_SUM_H_
+
+#include <cstdint>
+
+#include "absl/types/span.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// Number of partial sums the clamped sum kernels accumulate into.
+constexpr int kClampedSumLanes = 4;
+
+// Instruction sets the clamped sum kernels are implemented for.
+enum class ClampedSumKernel {
+  kScalar,
+  kSse2,
+  kAvx2,
+};
+
+// Statistics of a span of entries after dropping NaNs and clamping the rest to
+// [lower, upper].
+struct ClampedSums {
+  // Number of entries that are not NaN.
+  int64_t count = 0;
+  double sum = 0;
+  // Only computed when requested.
+  double sum_of_squares = 0;
+};
+
+// Drops the NaN entries, clamps the remaining entries to [lower, upper], and
+// sums them and, if with_squares is set, their squares. Uses the best kernel
+// the CPU supports.
+//
+// Entry i is added to partial sum i % kClampedSumLanes, and the partial sums
+// are added pairwise at the end. All kernels use this order, so their results
+// are bitwise identical. Adding the entries one by one rounds differently, so
+// the result is only equal up to floating point tolerance to the result of
+// clamping and adding each entry to a running sum.
+ClampedSums ClampAndSum(absl::Span<const double> entries, double lower,
+                        double upper, bool with_squares);
+
+// Same as above, but uses the given kernel. The kernel must be supported by
+// the CPU. Exposed for testing and benchmarking.
+ClampedSums ClampAndSum(absl::Span<const double> entries, double lower,
+                        double upper, bool with_squares,
+                        ClampedSumKernel kernel);
+
+// Returns the best kernel the CPU supports.
+ClampedSumKernel BestClampedSumKernel();
+
+// Returns whether the CPU supports the given kernel.
+bool IsClampedSumKernelSupported(ClampedSumKernel kernel);
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_CLAMPED_SUM_H_
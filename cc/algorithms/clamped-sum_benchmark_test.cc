@@ -0,0 +1,102 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/random/random.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/bounded-variance.h"
+#include "algorithms/clamped-sum.h"
+
+namespace differential_privacy {
+namespace {
+
+constexpr int64_t kNumEntries = 1 << 20;
+
+std::vector<double> MakeEntries() {
+  absl::BitGen gen;
+  std::vector<double> entries(kNumEntries);
+  for (double& entry : entries) {
+    entry = absl::Uniform(gen, -100.0, 100.0);
+    if (absl::Bernoulli(gen, 0.01)) {
+      entry = std::numeric_limits<double>::quiet_NaN();
+    }
+  }
+  return entries;
+}
+
+void BM_ClampAndSum(benchmark::State& state) {
+  auto kernel = static_cast<internal::ClampedSumKernel>(state.range(0));
+  if (!internal::IsClampedSumKernelSupported(kernel)) {
+    state.SkipWithError("Kernel not supported on this CPU.");
+    return;
+  }
+  const std::vector<double> entries = MakeEntries();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(internal::ClampAndSum(
+        entries, -50, 50, /*with_squares=*/state.range(1), kernel));
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK(BM_ClampAndSum)
+    ->ArgNames({"kernel", "squares"})
+    ->ArgsProduct({{static_cast<int>(internal::ClampedSumKernel::kScalar),
+                    static_cast<int>(internal::ClampedSumKernel::kSse2),
+                    static_cast<int>(internal::ClampedSumKernel::kAvx2)},
+                   {0, 1}});
+
+template <typename Algorithm>
+std::unique_ptr<Algorithm> BuildAlgorithm() {
+  return typename Algorithm::Builder()
+      .SetEpsilon(1.0)
+      .SetLower(-50)
+      .SetUpper(50)
+      .Build()
+      .ValueOrDie();
+}
+
+// Adds the entries one at a time, as AddEntries did before it became virtual.
+template <typename Algorithm>
+void BM_AddEntry(benchmark::State& state) {
+  const std::vector<double> entries = MakeEntries();
+  std::unique_ptr<Algorithm> algorithm = BuildAlgorithm<Algorithm>();
+  for (auto _ : state) {
+    for (double entry : entries) {
+      algorithm->AddEntry(entry);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK_TEMPLATE(BM_AddEntry, BoundedSum<double>);
+BENCHMARK_TEMPLATE(BM_AddEntry, BoundedVariance<double>);
+
+template <typename Algorithm>
+void BM_AddEntries(benchmark::State& state) {
+  const std::vector<double> entries = MakeEntries();
+  std::unique_ptr<Algorithm> algorithm = BuildAlgorithm<Algorithm>();
+  for (auto _ : state) {
+    algorithm->AddEntries(entries.begin(), entries.end());
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK_TEMPLATE(BM_AddEntries, BoundedSum<double>);
+BENCHMARK_TEMPLATE(BM_AddEntries, BoundedVariance<double>);
+
+}  // namespace
+}  // namespace differential_privacy
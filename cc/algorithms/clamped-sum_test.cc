@@ -0,0 +1,122 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/clamped-sum.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/random/random.h"
+#include "algorithms/util.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::testing::DoubleNear;
+using ::testing::Eq;
+
+const ClampedSumKernel kAllKernels[] = {ClampedSumKernel::kScalar,
+                                        ClampedSumKernel::kSse2,
+                                        ClampedSumKernel::kAvx2};
+
+std::vector<double> RandomEntries(int size) {
+  absl::BitGen gen;
+  std::vector<double> entries(size);
+  for (double& entry : entries) {
+    entry = absl::Uniform(gen, -20.0, 20.0);
+    if (absl::Bernoulli(gen, 0.05)) {
+      entry = std::numeric_limits<double>::quiet_NaN();
+    }
+  }
+  return entries;
+}
+
+TEST(ClampedSumTest, EmptyInput) {
+  ClampedSums sums = ClampAndSum({}, -1, 1, /*with_squares=*/true);
+  EXPECT_EQ(sums.count, 0);
+  EXPECT_EQ(sums.sum, 0);
+  EXPECT_EQ(sums.sum_of_squares, 0);
+}
+
+TEST(ClampedSumTest, DropsNanAndClamps) {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> entries = {nan, -5, 0.5, 7, nan, 1, -0.25};
+  for (ClampedSumKernel kernel : kAllKernels) {
+    if (!IsClampedSumKernelSupported(kernel)) continue;
+    ClampedSums sums = ClampAndSum(entries, -1, 2, /*with_squares=*/true,
+                                   kernel);
+    EXPECT_EQ(sums.count, 5);
+    EXPECT_EQ(sums.sum, -1 + 0.5 + 2 + 1 - 0.25);
+    EXPECT_EQ(sums.sum_of_squares, 1 + 0.25 + 4 + 1 + 0.0625);
+  }
+}
+
+TEST(ClampedSumTest, SkipsSquaresWhenNotRequested) {
+  std::vector<double> entries = {1, 2, 3, 4, 5};
+  ClampedSums sums = ClampAndSum(entries, 0, 10, /*with_squares=*/false);
+  EXPECT_EQ(sums.count, 5);
+  EXPECT_EQ(sums.sum, 15);
+  EXPECT_EQ(sums.sum_of_squares, 0);
+}
+
+TEST(ClampedSumTest, KernelsAreBitwiseIdentical) {
+  for (int size : {1, 3, 4, 5, 17, 1000, 1003}) {
+    std::vector<double> entries = RandomEntries(size);
+    ClampedSums expected = ClampAndSum(entries, -10.5, 12.25,
+                                       /*with_squares=*/true,
+                                       ClampedSumKernel::kScalar);
+    for (ClampedSumKernel kernel : kAllKernels) {
+      if (!IsClampedSumKernelSupported(kernel)) continue;
+      ClampedSums sums = ClampAndSum(entries, -10.5, 12.25,
+                                     /*with_squares=*/true, kernel);
+      EXPECT_THAT(sums.count, Eq(expected.count));
+      EXPECT_THAT(sums.sum, Eq(expected.sum));
+      EXPECT_THAT(sums.sum_of_squares, Eq(expected.sum_of_squares));
+    }
+  }
+}
+
+TEST(ClampedSumTest, MatchesSequentialSumUpToTolerance) {
+  std::vector<double> entries = RandomEntries(100000);
+  int64_t count = 0;
+  double sum = 0;
+  double sum_of_squares = 0;
+  for (double entry : entries) {
+    if (std::isnan(entry)) continue;
+    ++count;
+    double clamped = Clamp(-10.0, 10.0, entry);
+    sum += clamped;
+    sum_of_squares += clamped * clamped;
+  }
+
+  ClampedSums sums = ClampAndSum(entries, -10, 10, /*with_squares=*/true);
+  EXPECT_EQ(sums.count, count);
+  EXPECT_THAT(sums.sum, DoubleNear(sum, 1e-8));
+  EXPECT_THAT(sums.sum_of_squares, DoubleNear(sum_of_squares, 1e-6));
+}
+
+TEST(ClampedSumTest, BestKernelIsSupported) {
+  EXPECT_TRUE(IsClampedSumKernelSupported(BestClampedSumKernel()));
+  EXPECT_TRUE(IsClampedSumKernelSupported(ClampedSumKernel::kScalar));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
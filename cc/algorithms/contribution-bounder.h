@@ -0,0 +1,354 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_CONTRIBUTION_BOUNDER_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_CONTRIBUTION_BOUNDER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "absl/memory/memory.h"
+#include "absl/random/distributions.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "base/status.h"
+#include "base/statusor.h"
+#include "algorithms/rand.h"
+#include "algorithms/siphash.h"
+#include "base/canonical_errors.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Enforces the contribution bounds that AlgorithmBuilder::
+// SetMaxPartitionsContributed and SetMaxContributionsPerPartition assume, on a
+// stream of (privacy unit, partition key, value) rows in any order.
+//
+// Every privacy unit keeps a uniformly random sample of at most
+// max_partitions_contributed of its distinct partitions, and in each of them a
+// reservoir sample of at most max_contributions_per_partition of its values.
+// The partitions are sampled as the ones with the smallest random priorities,
+// which SipHash with a random 128-bit key assigns to each (privacy unit,
+// partition) pair, so a partition that has been dropped never comes back.
+//
+// Samples live in flat arrays indexed through an open-addressing hash table
+// keyed by privacy unit, so adding a row does not allocate, apart from
+// amortized growth when a new privacy unit arrives. Memory is bounded by
+// max_privacy_units_in_memory. Once that many privacy units are held, rows of
+// further privacy units are rejected, or, if spill_to_disk is set, written to
+// a temporary file that Flush() processes in further bounded-memory passes.
+// Every privacy unit is kept entirely in memory or entirely spilled, so the
+// bounds hold either way.
+//
+// T must be trivially copyable. PartitionKey must be trivially copyable and
+// equal keys must have equal bytes, e.g., integral partition ids.
+template <typename T, typename PartitionKey = int64_t>
+class ContributionBounder {
+ public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Values must be trivially copyable.");
+  static_assert(std::has_unique_object_representations<PartitionKey>::value,
+                "Partition keys must be trivially copyable without padding.");
+
+  struct Options {
+    // Maximum number of partitions a privacy unit contributes to.
+    int max_partitions_contributed = 1;
+    // Maximum number of values a privacy unit contributes to a partition.
+    int max_contributions_per_partition = 1;
+    // Maximum number of privacy units whose samples are held in memory.
+    int64_t max_privacy_units_in_memory = int64_t{1} << 20;
+    // Whether rows of privacy units beyond max_privacy_units_in_memory are
+    // written to a temporary file instead of being rejected.
+    bool spill_to_disk = false;
+  };
+
+  // Receives the sampled values of a privacy unit in one of its partitions.
+  using Sink = std::function<void(int64_t privacy_unit_id,
+                                  const PartitionKey& partition_key,
+                                  absl::Span<const T> values)>;
+
+  static base::StatusOr<std::unique_ptr<ContributionBounder>> Create(
+      const Options& options) {
+    if (options.max_partitions_contributed <= 0) {
+      return base::InvalidArgumentError(absl::StrCat(
+          "Max number of partitions a privacy unit can contribute to has to "
+          "be positive but is ",
+          options.max_partitions_contributed));
+    }
+    if (options.max_contributions_per_partition <= 0) {
+      return base::InvalidArgumentError(absl::StrCat(
+          "Max number of contributions per partition has to be positive but "
+          "is ",
+          options.max_contributions_per_partition));
+    }
+    if (options.max_privacy_units_in_memory <= 0 ||
+        options.max_privacy_units_in_memory > kMaxPrivacyUnitsInMemory) {
+      return base::InvalidArgumentError(absl::StrCat(
+          "Max number of privacy units in memory has to be in [1, ",
+          kMaxPrivacyUnitsInMemory, "] but is ",
+          options.max_privacy_units_in_memory));
+    }
+    return absl::WrapUnique(new ContributionBounder(options));
+  }
+
+  ~ContributionBounder() {
+    if (spill_ != nullptr) {
+      std::fclose(spill_);
+    }
+  }
+
+  ContributionBounder(const ContributionBounder&) = delete;
+  ContributionBounder& operator=(const ContributionBounder&) = delete;
+
+  // Returns a ResourceExhausted error if the row belongs to a privacy unit
+  // that does not fit into memory and spilling is disabled. The row is then
+  // dropped, and the caller must not use the remaining rows either, since
+  // the contributions of that privacy unit can no longer be bounded.
+  base::Status AddRow(int64_t privacy_unit_id,
+                      const PartitionKey& partition_key, const T& value) {
+    int unit;
+    if (!FindOrInsertPrivacyUnit(privacy_unit_id, &unit)) {
+      return Spill({privacy_unit_id, partition_key, value});
+    }
+    AddToSample(unit, partition_key, value);
+    return base::OkStatus();
+  }
+
+  // Passes the samples of every privacy unit to sink, including the spilled
+  // ones, and resets the bounder.
+  base::Status Flush(const Sink& sink) {
+    Emit(sink);
+    while (spill_ != nullptr) {
+      // Process the spilled rows as a new stream. Rows that do not fit into
+      // memory again go to a new spill file.
+      std::FILE* input = spill_;
+      spill_ = nullptr;
+      std::rewind(input);
+      SpilledRow row;
+      base::Status status;
+      while (status.ok() && std::fread(&row, sizeof(row), 1, input) == 1) {
+        status = AddRow(row.privacy_unit_id, row.partition_key, row.value);
+      }
+      std::fclose(input);
+      RETURN_IF_ERROR(status);
+      Emit(sink);
+    }
+    return base::OkStatus();
+  }
+
+  // Returns the number of privacy units whose samples are held in memory.
+  int64_t num_privacy_units() const { return privacy_unit_ids_.size(); }
+
+  int64_t MemoryUsed() {
+    return sizeof(ContributionBounder) +
+           sizeof(int32_t) * table_.capacity() +
+           sizeof(int64_t) * privacy_unit_ids_.capacity() +
+           sizeof(int32_t) * num_partitions_.capacity() +
+           sizeof(PartitionSample) * partitions_.capacity() +
+           sizeof(T) * values_.capacity();
+  }
+
+ private:
+  // Bounded by the int32_t indices of the hash table.
+  static constexpr int64_t kMaxPrivacyUnitsInMemory = int64_t{1} << 30;
+
+  // A sampled partition of a privacy unit.
+  struct PartitionSample {
+    PartitionKey partition_key;
+    uint64_t priority;
+    // Number of values of the privacy unit in the partition, including the
+    // ones that the reservoir sample dropped.
+    int64_t num_values;
+  };
+
+  struct SpilledRow {
+    int64_t privacy_unit_id;
+    PartitionKey partition_key;
+    T value;
+  };
+
+  explicit ContributionBounder(const Options& options)
+      : options_(options),
+        priority_hash_(SecureURBG::GetThreadLocal()(),
+                       SecureURBG::GetThreadLocal()()),
+        table_(kInitialTableSize, kEmpty) {}
+
+  // Sets *unit to the index of the samples of the privacy unit, which are
+  // added if they do not exist yet. Returns false if the privacy unit does
+  // not exist and there is no room for it.
+  bool FindOrInsertPrivacyUnit(int64_t privacy_unit_id, int* unit) {
+    const size_t mask = table_.size() - 1;
+    size_t slot = absl::Hash<int64_t>()(privacy_unit_id) & mask;
+    while (table_[slot] != kEmpty) {
+      if (privacy_unit_ids_[table_[slot]] == privacy_unit_id) {
+        *unit = table_[slot];
+        return true;
+      }
+      slot = (slot + 1) & mask;
+    }
+    if (num_privacy_units() >= options_.max_privacy_units_in_memory) {
+      return false;
+    }
+
+    *unit = privacy_unit_ids_.size();
+    privacy_unit_ids_.push_back(privacy_unit_id);
+    num_partitions_.push_back(0);
+    partitions_.resize(partitions_.size() +
+                       options_.max_partitions_contributed);
+    values_.resize(values_.size() +
+                   static_cast<size_t>(options_.max_partitions_contributed) *
+                       options_.max_contributions_per_partition);
+    table_[slot] = *unit;
+    // Keep the load factor at most 1/2 so that probe sequences stay short.
+    if (2 * privacy_unit_ids_.size() > table_.size()) {
+      Rehash(2 * table_.size());
+    }
+    return true;
+  }
+
+  void Rehash(size_t size) {
+    table_.assign(size, kEmpty);
+    const size_t mask = size - 1;
+    for (int unit = 0; unit < privacy_unit_ids_.size(); ++unit) {
+      size_t slot = absl::Hash<int64_t>()(privacy_unit_ids_[unit]) & mask;
+      while (table_[slot] != kEmpty) {
+        slot = (slot + 1) & mask;
+      }
+      table_[slot] = unit;
+    }
+  }
+
+  void AddToSample(int unit, const PartitionKey& partition_key,
+                   const T& value) {
+    const int max_partitions = options_.max_partitions_contributed;
+    const size_t first_sample = static_cast<size_t>(unit) * max_partitions;
+    PartitionSample* samples = &partitions_[first_sample];
+    int32_t& num_partitions = num_partitions_[unit];
+    for (int i = 0; i < num_partitions; ++i) {
+      if (samples[i].partition_key == partition_key) {
+        AddToReservoir(first_sample + i, value);
+        return;
+      }
+    }
+
+    // Keep the partitions with the smallest priorities.
+    unsigned char message[sizeof(int64_t) + sizeof(PartitionKey)];
+    std::memcpy(message, &privacy_unit_ids_[unit], sizeof(int64_t));
+    std::memcpy(message + sizeof(int64_t), &partition_key,
+                sizeof(PartitionKey));
+    const uint64_t priority = priority_hash_.Hash(message, sizeof(message));
+    int i = num_partitions;
+    if (num_partitions < max_partitions) {
+      ++num_partitions;
+    } else {
+      i = 0;
+      for (int j = 1; j < max_partitions; ++j) {
+        if (samples[j].priority > samples[i].priority) i = j;
+      }
+      if (priority >= samples[i].priority) return;
+    }
+    samples[i] = {partition_key, priority, 0};
+    AddToReservoir(first_sample + i, value);
+  }
+
+  // Adds the value to the reservoir sample of the given partition sample.
+  void AddToReservoir(size_t sample, const T& value) {
+    const int max_values = options_.max_contributions_per_partition;
+    int64_t num_values = ++partitions_[sample].num_values;
+    T* values = &values_[sample * max_values];
+    if (num_values <= max_values) {
+      values[num_values - 1] = value;
+      return;
+    }
+    int64_t i = absl::Uniform<int64_t>(SecureURBG::GetThreadLocal(), 0,
+                                       num_values);
+    if (i < max_values) {
+      values[i] = value;
+    }
+  }
+
+  base::Status Spill(const SpilledRow& row) {
+    if (!options_.spill_to_disk) {
+      return base::ResourceExhaustedError(absl::StrCat(
+          "Cannot hold more than ", options_.max_privacy_units_in_memory,
+          " privacy units in memory without spilling to disk."));
+    }
+    if (spill_ == nullptr) {
+      spill_ = std::tmpfile();
+      if (spill_ == nullptr) {
+        return base::InternalError("Cannot create a spill file.");
+      }
+    }
+    if (std::fwrite(&row, sizeof(row), 1, spill_) != 1) {
+      return base::InternalError("Cannot write to the spill file.");
+    }
+    return base::OkStatus();
+  }
+
+  // Passes the samples held in memory to sink and clears them, keeping the
+  // allocated memory for the next pass.
+  void Emit(const Sink& sink) {
+    const int max_partitions = options_.max_partitions_contributed;
+    const int max_values = options_.max_contributions_per_partition;
+    for (int unit = 0; unit < privacy_unit_ids_.size(); ++unit) {
+      for (int i = 0; i < num_partitions_[unit]; ++i) {
+        const size_t sample = static_cast<size_t>(unit) * max_partitions + i;
+        const PartitionSample& partition = partitions_[sample];
+        sink(privacy_unit_ids_[unit], partition.partition_key,
+             absl::MakeConstSpan(
+                 &values_[sample * max_values],
+                 std::min<int64_t>(partition.num_values, max_values)));
+      }
+    }
+    privacy_unit_ids_.clear();
+    num_partitions_.clear();
+    partitions_.clear();
+    values_.clear();
+    std::fill(table_.begin(), table_.end(), kEmpty);
+  }
+
+  static constexpr int32_t kEmpty = -1;
+  static constexpr size_t kInitialTableSize = 64;
+
+  const Options options_;
+  // Pseudorandom function giving the priorities of the partitions.
+  const internal::SipHash priority_hash_;
+
+  // Open-addressing hash table from privacy unit ids to the indices of their
+  // samples, or kEmpty.
+  std::vector<int32_t> table_;
+  // The privacy unit id and number of sampled partitions of each index.
+  std::vector<int64_t> privacy_unit_ids_;
+  std::vector<int32_t> num_partitions_;
+  // max_partitions_contributed partition samples per privacy unit, and
+  // max_contributions_per_partition values per partition sample.
+  std::vector<PartitionSample> partitions_;
+  std::vector<T> values_;
+
+  // Rows of privacy units that did not fit into memory, or null.
+  std::FILE* spill_ = nullptr;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_CONTRIBUTION_BOUNDER_H_
@@ -0,0 +1,89 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/random/random.h"
+#include "algorithms/contribution-bounder.h"
+
+namespace differential_privacy {
+namespace {
+
+using Bounder = ContributionBounder<double>;
+
+constexpr int64_t kNumRows = 1 << 22;
+// Average number of rows of a privacy unit.
+constexpr int64_t kRowsPerPrivacyUnit = 8;
+
+struct Row {
+  int64_t privacy_unit_id;
+  int64_t partition_key;
+  double value;
+};
+
+std::vector<Row> MakeRows() {
+  absl::BitGen gen;
+  std::vector<Row> rows(kNumRows);
+  for (Row& row : rows) {
+    row = {absl::Uniform<int64_t>(gen, 0, kNumRows / kRowsPerPrivacyUnit),
+           absl::Uniform<int64_t>(gen, 0, 1 << 16),
+           absl::Uniform(gen, 0.0, 10.0)};
+  }
+  return rows;
+}
+
+// The argument is the number of privacy units held in memory, as a fraction
+// 1 / arg of all privacy units. Privacy units beyond it are spilled to disk.
+void BM_BoundContributions(benchmark::State& state) {
+  const std::vector<Row> rows = MakeRows();
+  Bounder::Options options;
+  options.max_partitions_contributed = 4;
+  options.max_contributions_per_partition = 2;
+  options.max_privacy_units_in_memory =
+      kNumRows / kRowsPerPrivacyUnit / state.range(0);
+  options.spill_to_disk = true;
+  std::unique_ptr<Bounder> bounder = Bounder::Create(options).ValueOrDie();
+
+  int64_t num_samples = 0;
+  for (auto _ : state) {
+    for (const Row& row : rows) {
+      bounder->AddRow(row.privacy_unit_id, row.partition_key, row.value)
+          .IgnoreError();
+    }
+    num_samples = 0;
+    bounder
+        ->Flush([&num_samples](int64_t, const int64_t&,
+                               absl::Span<const double> values) {
+          num_samples += values.size();
+        })
+        .IgnoreError();
+  }
+  state.SetItemsProcessed(state.iterations() * rows.size());
+  state.counters["memory"] = bounder->MemoryUsed();
+  state.counters["sampled_values"] = num_samples;
+}
+BENCHMARK(BM_BoundContributions)
+    ->ArgName("memory_fraction_inverse")
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace differential_privacy
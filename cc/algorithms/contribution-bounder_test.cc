@@ -0,0 +1,201 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/contribution-bounder.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::testing::ElementsAre;
+using Bounder = ContributionBounder<double>;
+
+// The sampled values by privacy unit and partition.
+using Samples = std::map<std::pair<int64_t, int64_t>, std::vector<double>>;
+
+Samples Flush(Bounder* bounder) {
+  Samples samples;
+  base::Status status = bounder->Flush(
+      [&samples](int64_t privacy_unit_id, const int64_t& partition_key,
+                 absl::Span<const double> values) {
+        std::vector<double>& sample =
+            samples[std::make_pair(privacy_unit_id, partition_key)];
+        EXPECT_TRUE(sample.empty());
+        sample.assign(values.begin(), values.end());
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  return samples;
+}
+
+TEST(ContributionBounderTest, ForwardsRowsWithinBounds) {
+  Bounder::Options options;
+  options.max_partitions_contributed = 2;
+  options.max_contributions_per_partition = 2;
+  std::unique_ptr<Bounder> bounder = Bounder::Create(options).ValueOrDie();
+  EXPECT_TRUE(bounder->AddRow(1, 10, 1.0).ok());
+  EXPECT_TRUE(bounder->AddRow(2, 10, 2.0).ok());
+  EXPECT_TRUE(bounder->AddRow(1, 20, 3.0).ok());
+  EXPECT_TRUE(bounder->AddRow(1, 10, 4.0).ok());
+  EXPECT_EQ(bounder->num_privacy_units(), 2);
+
+  Samples samples = Flush(bounder.get());
+  EXPECT_EQ(samples.size(), 3);
+  EXPECT_THAT(samples[std::make_pair(1, 10)], ElementsAre(1.0, 4.0));
+  EXPECT_THAT(samples[std::make_pair(1, 20)], ElementsAre(3.0));
+  EXPECT_THAT(samples[std::make_pair(2, 10)], ElementsAre(2.0));
+  EXPECT_EQ(bounder->num_privacy_units(), 0);
+  EXPECT_TRUE(Flush(bounder.get()).empty());
+}
+
+TEST(ContributionBounderTest, BoundsContributions) {
+  Bounder::Options options;
+  options.max_partitions_contributed = 3;
+  options.max_contributions_per_partition = 2;
+  std::unique_ptr<Bounder> bounder = Bounder::Create(options).ValueOrDie();
+  for (int i = 0; i < 100; ++i) {
+    for (int64_t privacy_unit = 0; privacy_unit < 10; ++privacy_unit) {
+      EXPECT_TRUE(bounder->AddRow(privacy_unit, i % 7, i).ok());
+    }
+  }
+
+  std::map<int64_t, int> partitions_per_unit;
+  for (const auto& sample : Flush(bounder.get())) {
+    ++partitions_per_unit[sample.first.first];
+    EXPECT_EQ(sample.second.size(), 2);
+    for (double value : sample.second) {
+      EXPECT_EQ(static_cast<int>(value) % 7, sample.first.second);
+    }
+  }
+  EXPECT_EQ(partitions_per_unit.size(), 10);
+  for (const auto& unit : partitions_per_unit) {
+    EXPECT_EQ(unit.second, 3);
+  }
+}
+
+TEST(ContributionBounderTest, SamplesPartitionsUniformly) {
+  Bounder::Options options;
+  std::unique_ptr<Bounder> bounder = Bounder::Create(options).ValueOrDie();
+  const int num_units = 10000;
+  for (int64_t privacy_unit = 0; privacy_unit < num_units; ++privacy_unit) {
+    EXPECT_TRUE(bounder->AddRow(privacy_unit, 0, 0).ok());
+    EXPECT_TRUE(bounder->AddRow(privacy_unit, 1, 0).ok());
+  }
+  int partition_zero = 0;
+  for (const auto& sample : Flush(bounder.get())) {
+    if (sample.first.second == 0) ++partition_zero;
+  }
+  // The priorities are independent and uniform for every key, so the count is
+  // binomial with a standard deviation of 50 and the bound is 6 of them. The
+  // distribution of the priorities under a fixed key is tested in
+  // siphash_test.cc.
+  EXPECT_NEAR(partition_zero, num_units / 2, 300);
+}
+
+TEST(ContributionBounderTest, SamplesValuesUniformly) {
+  Bounder::Options options;
+  std::unique_ptr<Bounder> bounder = Bounder::Create(options).ValueOrDie();
+  const int num_units = 10000;
+  for (int i = 0; i < 4; ++i) {
+    for (int64_t privacy_unit = 0; privacy_unit < num_units; ++privacy_unit) {
+      EXPECT_TRUE(bounder->AddRow(privacy_unit, 0, i).ok());
+    }
+  }
+  std::map<double, int> counts;
+  for (const auto& sample : Flush(bounder.get())) {
+    ++counts[sample.second[0]];
+  }
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_NEAR(counts[i], num_units / 4, 300);
+  }
+}
+
+TEST(ContributionBounderTest, RejectsPrivacyUnitsBeyondMemory) {
+  Bounder::Options options;
+  options.max_privacy_units_in_memory = 2;
+  std::unique_ptr<Bounder> bounder = Bounder::Create(options).ValueOrDie();
+  EXPECT_TRUE(bounder->AddRow(1, 0, 0).ok());
+  EXPECT_TRUE(bounder->AddRow(2, 0, 0).ok());
+  EXPECT_EQ(bounder->AddRow(3, 0, 0).code(),
+            base::StatusCode::kResourceExhausted);
+  EXPECT_TRUE(bounder->AddRow(1, 1, 0).ok());
+}
+
+TEST(ContributionBounderTest, SpillsPrivacyUnitsBeyondMemory) {
+  Bounder::Options options;
+  options.max_partitions_contributed = 2;
+  options.max_contributions_per_partition = 3;
+  options.max_privacy_units_in_memory = 16;
+  options.spill_to_disk = true;
+  std::unique_ptr<Bounder> bounder = Bounder::Create(options).ValueOrDie();
+  const int num_units = 100;
+  for (int i = 0; i < 10; ++i) {
+    for (int64_t privacy_unit = 0; privacy_unit < num_units; ++privacy_unit) {
+      EXPECT_TRUE(bounder->AddRow(privacy_unit, i % 5, i).ok());
+      EXPECT_LE(bounder->num_privacy_units(), 16);
+    }
+  }
+
+  std::map<int64_t, int> partitions_per_unit;
+  for (const auto& sample : Flush(bounder.get())) {
+    ++partitions_per_unit[sample.first.first];
+    EXPECT_EQ(sample.second.size(), 2);
+  }
+  EXPECT_EQ(partitions_per_unit.size(), num_units);
+  for (const auto& unit : partitions_per_unit) {
+    EXPECT_EQ(unit.second, 2);
+  }
+}
+
+TEST(ContributionBounderTest, MemoryIsBoundedByPrivacyUnits) {
+  Bounder::Options options;
+  options.max_privacy_units_in_memory = 1000;
+  options.spill_to_disk = true;
+  std::unique_ptr<Bounder> bounder = Bounder::Create(options).ValueOrDie();
+  for (int64_t privacy_unit = 0; privacy_unit < 1000; ++privacy_unit) {
+    EXPECT_TRUE(bounder->AddRow(privacy_unit, 0, 0).ok());
+  }
+  const int64_t memory = bounder->MemoryUsed();
+  for (int64_t privacy_unit = 1000; privacy_unit < 100000; ++privacy_unit) {
+    EXPECT_TRUE(bounder->AddRow(privacy_unit, 0, 0).ok());
+  }
+  EXPECT_EQ(bounder->MemoryUsed(), memory);
+  EXPECT_EQ(Flush(bounder.get()).size(), 100000);
+}
+
+TEST(ContributionBounderTest, InvalidOptions) {
+  for (int invalid : {0, -1}) {
+    Bounder::Options options;
+    options.max_partitions_contributed = invalid;
+    EXPECT_FALSE(Bounder::Create(options).ok());
+    options = Bounder::Options();
+    options.max_contributions_per_partition = invalid;
+    EXPECT_FALSE(Bounder::Create(options).ok());
+    options = Bounder::Options();
+    options.max_privacy_units_in_memory = invalid;
+    EXPECT_FALSE(Bounder::Create(options).ok());
+  }
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -35,6 +35,12 @@ class Count : public Algorithm<T> {
 
   void AddEntry(const T& v) override { ++count_; }
 
+  using Algorithm<T>::AddEntries;
+
+  void AddEntries(absl::Span<const T> entries) override {
+    count_ += entries.size();
+  }
+
   base::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
       double confidence_level, double privacy_budget = 1) override {
     return mechanism_->NoiseConfidenceInterval(confidence_level,
@@ -69,21 +75,22 @@ class Count : public Algorithm<T> {
     return base::OkStatus();
   }
 
+  base::StatusOr<std::unique_ptr<Algorithm<T>>> CloneEmpty() const override {
+    return std::unique_ptr<Algorithm<T>>(
+        new Count<T>(Algorithm<T>::GetEpsilon(), mechanism_));
+  }
+
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(Count<T>);
-    if (mechanism_) {
-      memory += mechanism_->MemoryUsed();
-    }
-    return memory;
+    return sizeof(Count<T>) +
+           NumericalMechanism::MemoryUsedPerOwner(mechanism_);
   }
 
  protected:
   base::StatusOr<Output> GenerateResult(double privacy_budget,
                                         double noise_interval_level) override {
     Output output;
-    int64_t countWithNoise;
-    SafeCastFromDouble(std::round(mechanism_->AddNoise(count_, privacy_budget)),
-                       countWithNoise);
+    int64_t countWithNoise = mechanism_->AddInt64Noise(
+        SaturatingCast<int64_t>(count_), privacy_budget);
     AddToOutput<int64_t>(&output, countWithNoise);
 
     base::StatusOr<ConfidenceInterval> interval =
@@ -100,12 +107,12 @@ class Count : public Algorithm<T> {
   std::size_t GetCount() const { return count_; }
 
   // The constructor and count_ are non-private for testing.
-  Count(double epsilon, std::unique_ptr<NumericalMechanism> mechanism)
+  Count(double epsilon, std::shared_ptr<NumericalMechanism> mechanism)
       : Algorithm<T>(epsilon), count_(0), mechanism_(std::move(mechanism)) {}
 
  private:
   std::size_t count_;
-  std::unique_ptr<NumericalMechanism> mechanism_;
+  std::shared_ptr<NumericalMechanism> mechanism_;
 };
 
 template <typename T>
@@ -116,7 +123,7 @@ class Count<T>::Builder
       differential_privacy::AlgorithmBuilder<T, Count<T>, Count<T>::Builder>;
 
   base::StatusOr<std::unique_ptr<Count<T>>> BuildAlgorithm() override {
-    std::unique_ptr<NumericalMechanism> mechanism;
+    std::shared_ptr<NumericalMechanism> mechanism;
     ASSIGN_OR_RETURN(mechanism, AlgorithmBuilder::UpdateAndBuildMechanism());
 
     return absl::WrapUnique(new Count<T>(AlgorithmBuilder::GetEpsilon().value(),
@@ -66,6 +66,18 @@ TYPED_TEST(CountTest, RepeatedResultTest) {
             GetValue<int64_t>(count->PartialResult(0.5).ValueOrDie()));
 }
 
+TEST(CountTest, BulkAddEntriesCountsEveryEntry) {
+  std::vector<double> c = {1, std::numeric_limits<double>::quiet_NaN(), 3};
+  std::unique_ptr<Count<double>> count =
+      Count<double>::Builder()
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  count->AddEntries(absl::MakeConstSpan(c));
+  count->AddEntry(4);
+  EXPECT_EQ(GetValue<int64_t>(count->PartialResult().ValueOrDie()), 4);
+}
+
 TEST(CountTest, ConfidenceIntervalTest) {
   double epsilon = 0.5;
   double level = .95;
@@ -119,11 +131,79 @@ TEST(CountTest, MergeTest) {
   EXPECT_EQ(GetValue<int64_t>(count->PartialResult().ValueOrDie()), 3);
 }
 
+// Adds a fixed offset to integer results and NaN to floating point results, to
+// check that counts are noised in the integer domain.
+class IntegerOffsetMechanism : public ZeroNoiseMechanism {
+ public:
+  class Builder : public ZeroNoiseMechanism::Builder {
+   public:
+    base::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override {
+      return base::StatusOr<std::unique_ptr<NumericalMechanism>>(
+          absl::make_unique<IntegerOffsetMechanism>());
+    }
+
+    std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+      return absl::make_unique<Builder>(*this);
+    }
+  };
+
+  IntegerOffsetMechanism() : ZeroNoiseMechanism(1, 1) {}
+
+  double AddNoise(double result, double privacy_budget) override {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  int64_t AddInt64Noise(int64_t result, double privacy_budget) override {
+    return result + 7;
+  }
+};
+
+TEST(CountTest, NoisesInIntegerDomain) {
+  std::vector<int64_t> c = {1, 2, 3};
+  std::unique_ptr<Count<int64_t>> count =
+      Count<int64_t>::Builder()
+          .SetLaplaceMechanism(
+              absl::make_unique<IntegerOffsetMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  EXPECT_EQ(GetValue<int64_t>(count->Result(c.begin(), c.end()).ValueOrDie()),
+            10);
+}
+
 TEST(CountTest, MemoryUsed) {
   std::unique_ptr<Count<double>> count =
       Count<double>::Builder().Build().ValueOrDie();
   EXPECT_GT(count->MemoryUsed(), 0);
 }
 
+TEST(CountTest, CloneEmpty) {
+  std::unique_ptr<Count<int64_t>> prototype =
+      Count<int64_t>::Builder()
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  prototype->AddEntries({1, 2, 3});
+  EXPECT_EQ(GetValue<int64_t>(prototype->PartialResult().ValueOrDie()), 3);
+
+  std::unique_ptr<Algorithm<int64_t>> count =
+      prototype->CloneEmpty().ValueOrDie();
+  EXPECT_EQ(count->GetEpsilon(), prototype->GetEpsilon());
+  EXPECT_EQ(count->RemainingPrivacyBudget(), 1);
+  count->AddEntry(1);
+  EXPECT_EQ(GetValue<int64_t>(count->PartialResult().ValueOrDie()), 1);
+}
+
+TEST(CountTest, AlgorithmsShareMechanism) {
+  Count<double>::Builder builder;
+  builder.SetEpsilon(1.0);
+  std::unique_ptr<Count<double>> first = builder.Build().ValueOrDie();
+  const int64_t memory = first->MemoryUsed();
+  std::unique_ptr<Count<double>> second = builder.Build().ValueOrDie();
+  // The mechanism is accounted for once by both counts together.
+  EXPECT_LT(first->MemoryUsed(), memory);
+  EXPECT_NEAR(first->MemoryUsed() + second->MemoryUsed(),
+              memory + sizeof(Count<double>), 1);
+}
+
 }  // namespace
 }  // namespace differential_privacy
@@ -15,10 +15,12 @@
 //
 #include "algorithms/distributions.h"
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
 #include "absl/memory/memory.h"
+#include "absl/numeric/bits.h"
 #include "absl/random/random.h"
 #include "base/statusor.h"
 #include "absl/strings/string_view.h"
@@ -40,16 +42,104 @@ static constexpr double kPi = 3.14159265358979323846;
 // root is set to 2^57.
 static constexpr double kBinomialBound = (double)(1LL << 57);
 
-// Approximates the probability of a random sample m + n / 2 drawn from a
-// binomial distribution of n Bernoulli trials that have a success probability
-// of 1 / 2 each. The approximation is taken from Lemma 7 of the noise
-// generation documentation available in
-// https://github.com/google/differential-privacy/blob/main/common_docs/Secure_Noise_Generation.pdf
-double ApproximateBinomialProbability(double sqrt_n, int64_t m) {
-  if (abs(m) > sqrt_n * sqrt(log(sqrt_n) / 2)) return 0;
+// Hands out uniformly random bits taken from whole 64-bit words of the secure
+// URBG, so that geometric(1/2) and sign samples do not cost a URBG draw per bit.
+class RandomBitSource {
+ public:
+  explicit RandomBitSource(SecureURBG& random) : random_(random) {}
+
+  bool NextBit() {
+    if (num_bits_ == 0) Refill();
+    bool bit = bits_ >> 63;
+    bits_ <<= 1;
+    --num_bits_;
+    return bit;
+  }
+
+  // Returns the number of zero bits before the first one bit, i.e., a sample
+  // from the geometric distribution with success probability 1/2. Unused bits
+  // are shifted out at the bottom of bits_ as zeros, so counting the leading
+  // zeros of the word covers all remaining bits at once.
+  int NextGeometric() {
+    int count = 0;
+    while (true) {
+      if (num_bits_ == 0) Refill();
+      int zeros = absl::countl_zero(bits_);
+      if (zeros < num_bits_) {
+        count += zeros;
+        bits_ = zeros < 63 ? bits_ << (zeros + 1) : 0;
+        num_bits_ -= zeros + 1;
+        return count;
+      }
+      count += num_bits_;
+      num_bits_ = 0;
+    }
+  }
+
+ private:
+  void Refill() {
+    bits_ = random_();
+    num_bits_ = 64;
+  }
+
+  SecureURBG& random_;
+  uint64_t bits_ = 0;
+  int num_bits_ = 0;
+};
+
+// Constants of the binomial sampler that only depend on sqrt(n), so that they
+// can be computed once per batch instead of in every rejection round.
+struct BinomialParameters {
+  explicit BinomialParameters(double sqrt_n)
+      : step_size(static_cast<int64_t>(round(sqrt(2.0) * sqrt_n + 1))),
+        max_abs_m(sqrt_n * sqrt(log(sqrt_n) / 2)),
+        probability_factor(sqrt(2 / kPi) / sqrt_n *
+                           (1 - 0.4 * (2 * pow(log(sqrt_n), 1.5)) / sqrt_n)),
+        exponent_factor(-2.0 / (sqrt_n * sqrt_n)) {}
+
+  // Approximates the probability of a random sample m + n / 2 drawn from a
+  // binomial distribution of n Bernoulli trials that have a success
+  // probability of 1 / 2 each. The approximation is taken from Lemma 7 of the
+  // noise generation documentation available in
+  // https://github.com/google/differential-privacy/blob/main/common_docs/Secure_Noise_Generation.pdf
+  double ApproximateProbability(int64_t m) const {
+    double m_dbl = static_cast<double>(m);
+    if (std::abs(m_dbl) > max_abs_m) return 0;
+    return probability_factor * exp(exponent_factor * m_dbl * m_dbl);
+  }
+
+  int64_t step_size;
+  double max_abs_m;
+  double probability_factor;
+  double exponent_factor;
+};
+
+// Returns a random sample m where {@code m + n / 2} is drawn from a binomial
+// distribution of n Bernoulli trials that have a success probability of 1 / 2
+// each. The sampling technique is based on Bringmann et al.'s rejection
+// sampling approach proposed in "Internal DLA: Efficient Simulation of a
+// Physical Growth Model", available
+// https://people.mpi-inf.mpg.de/~kbringma/paper/2014ICALP.pdf. The square root
+// of n must be at least 10^6. This is to ensure an accurate approximation of a
+// Gaussian distribution.
+int64_t SampleBinomial(const BinomialParameters& params, SecureURBG& random,
+                       RandomBitSource& bits) {
+  while (true) {
+    int geom_sample = bits.NextGeometric();
+    int two_sided_geom = bits.NextBit() ? geom_sample : (-geom_sample - 1);
+    int64_t uniform_sample =
+        absl::Uniform<int64_t>(random, 0, params.step_size);
+    int64_t result = params.step_size * two_sided_geom + uniform_sample;
+
+    double result_prob = params.ApproximateProbability(result);
+    double reject_prob = UniformDouble();
 
-  return sqrt(2 / kPi) / sqrt_n * exp(-2.0 * m * m / (sqrt_n * sqrt_n)) *
-         (1 - 0.4 * (2 * pow(log(sqrt_n), 1.5)) / sqrt_n);
+    if (result_prob > 0 && reject_prob > 0 &&
+        reject_prob < std::ldexp(result_prob * params.step_size,
+                                 geom_sample - 2)) {
+      return result;
+    }
+  }
 }
 
 }  // namespace
@@ -59,6 +149,12 @@ GaussianDistribution::GaussianDistribution(double stddev) : stddev_(stddev) {
 }
 
 double GaussianDistribution::Sample(double scale) {
+  double sample;
+  SampleBatch(absl::Span<double>(&sample, 1), scale);
+  return sample;
+}
+
+void GaussianDistribution::SampleBatch(absl::Span<double> out, double scale) {
   DCHECK_GT(scale, 0);
   // TODO: make graceful behaviour when sigma is too big.
   double sigma = scale * stddev_;
@@ -72,7 +168,12 @@ double GaussianDistribution::Sample(double scale) {
   // The sqrt(n) is taken instead of n, to ensure that all results of arithmetic
   // operations fit in 64 bit integer range.
   double sqrt_n = 2.0 * sigma / granularity;
-  return SampleBinomial(sqrt_n) * granularity;
+  BinomialParameters params(sqrt_n);
+  SecureURBG& random = SecureURBG::GetThreadLocal();
+  RandomBitSource bits(random);
+  for (double& sample : out) {
+    sample = SampleBinomial(params, random, bits) * granularity;
+  }
 }
 
 double GaussianDistribution::Sample() { return Sample(1.0); }
@@ -84,57 +185,52 @@ double GaussianDistribution::GetGranularity(double scale) const {
   return GetNextPowerOfTwo(2 * sigma / kBinomialBound);
 }
 
-GeometricDistribution::GeometricDistribution(double lambda) : lambda_(lambda) {
+GeometricDistribution::GeometricDistribution(double lambda,
+                                             GeometricSampler sampler)
+    : lambda_(lambda), sampler_(sampler) {
   DCHECK_GE(lambda, 0);
 }
 
-double GaussianDistribution::SampleGeometric() {
-  int geom_sample = 0;
-  while (absl::Bernoulli(SecureURBG::GetSingleton(), 0.5)) ++geom_sample;
-  return geom_sample;
-}
-
-// Returns a random sample m where {@code m + n / 2} is drawn from a binomial
-// distribution of n Bernoulli trials that have a success probability of 1 / 2
-// each. The sampling technique is based on Bringmann et al.'s rejection
-// sampling approach proposed in "Internal DLA: Efficient Simulation of a
-// Physical Growth Model", available
-// https://people.mpi-inf.mpg.de/~kbringma/paper/2014ICALP.pdf. The square root
-// of n must be at least 10^6. This is to ensure an accurate approximation of a
-// Gaussian distribution.
-double GaussianDistribution::SampleBinomial(double sqrt_n) {
-  long long step_size = static_cast<long long>(round(sqrt(2.0) * sqrt_n + 1));
-
-  SecureURBG& random = SecureURBG::GetSingleton();
-  while (true) {
-    int geom_sample = SampleGeometric();
-    int two_sided_geom =
-        absl::Bernoulli(random, 0.5) ? geom_sample : (-geom_sample - 1);
-    long long uniform_sample = absl::Uniform(random, 0u, step_size);
-    long long result = step_size * two_sided_geom + uniform_sample;
-
-    double result_prob = ApproximateBinomialProbability(sqrt_n, result);
-    double reject_prob = UniformDouble();
-
-    if (result_prob > 0 && reject_prob > 0 &&
-        reject_prob < result_prob * step_size * pow(2.0, geom_sample - 2)) {
-      return result;
-    }
-  }
-}
-
 double GeometricDistribution::GetUniformDouble() { return UniformDouble(); }
 
 int64_t GeometricDistribution::Sample() { return Sample(1.0); }
 
 int64_t GeometricDistribution::Sample(double scale) {
+  int64_t sample;
+  SampleBatch(absl::Span<int64_t>(&sample, 1), scale);
+  return sample;
+}
+
+void GeometricDistribution::SampleBatch(absl::Span<int64_t> out,
+                                        double scale) {
   if (lambda_ == std::numeric_limits<double>::infinity()) {
-    return 0;
+    std::fill(out.begin(), out.end(), 0);
+    return;
   }
   double lambda = lambda_ / scale;
+  if (sampler_ == GeometricSampler::kDecomposition) {
+    // The block size is the largest power of two that is at most 1 / lambda,
+    // so that lambda * block_size lies in (1/2, 1] unless it is clamped. This
+    // keeps both the remainder acceptance probability and the quotient
+    // termination probability bounded away from zero.
+    int block_exponent = std::min(std::max(std::ilogb(1.0 / lambda), 0), 62);
+    int64_t block_size = int64_t{1} << block_exponent;
+    double continue_prob = std::exp(-lambda * block_size);
+    for (int64_t& sample : out) {
+      sample = SampleDecomposed(lambda, block_size, continue_prob);
+    }
+    return;
+  }
+  double overflow_threshold =
+      -1.0 * expm1(-1.0 * lambda * std::numeric_limits<int64_t>::max());
+  for (int64_t& sample : out) {
+    sample = SampleScaled(lambda, overflow_threshold);
+  }
+}
 
-  if (GetUniformDouble() >
-      -1.0 * expm1(-1.0 * lambda * std::numeric_limits<int64_t>::max())) {
+int64_t GeometricDistribution::SampleScaled(double lambda,
+                                            double overflow_threshold) {
+  if (GetUniformDouble() > overflow_threshold) {
     return std::numeric_limits<int64_t>::max();
   }
 
@@ -161,6 +257,34 @@ int64_t GeometricDistribution::Sample(double scale) {
   return hi - 1;
 }
 
+// A geometric sample G with ratio q = e^-lambda can be written as
+// G = Q * block_size + R, where Q and R are independent. Q is geometric with
+// ratio q^block_size and R follows the geometric distribution truncated to
+// [0, block_size), i.e., P(R = r) is proportional to q^r. R is drawn by
+// proposing a uniform integer r and accepting it with probability q^r. Q is
+// drawn by counting Bernoulli(q^block_size) successes until the first failure.
+int64_t GeometricDistribution::SampleDecomposed(double lambda,
+                                                int64_t block_size,
+                                                double continue_prob) {
+  SecureURBG& random = SecureURBG::GetThreadLocal();
+  int64_t remainder = 0;
+  if (block_size > 1) {
+    do {
+      remainder = absl::Uniform<int64_t>(random, 0, block_size);
+    } while (GetUniformDouble() >= std::exp(-lambda * remainder));
+  }
+
+  int64_t max_quotient =
+      (std::numeric_limits<int64_t>::max() - remainder) / block_size;
+  int64_t quotient = 0;
+  while (GetUniformDouble() < continue_prob) {
+    if (++quotient > max_quotient) {
+      return std::numeric_limits<int64_t>::max();
+    }
+  }
+  return quotient * block_size + remainder;
+}
+
 double GeometricDistribution::Lambda() { return lambda_; }
 
 // This is 2^K, with K hardcoded as 40. To generate laplace noise, we sample an
@@ -185,7 +309,8 @@ base::StatusOr<double> CalculateGranularity(double epsilon,
   return gran;
 }
 
-LaplaceDistribution::LaplaceDistribution(double epsilon, double sensitivity) {
+LaplaceDistribution::LaplaceDistribution(double epsilon, double sensitivity,
+                                         GeometricSampler sampler) {
   epsilon_ = epsilon;
   sensitivity_ = sensitivity;
   granularity_ = CalculateGranularity(epsilon_, sensitivity_).ValueOrDie();
@@ -196,13 +321,13 @@ LaplaceDistribution::LaplaceDistribution(double epsilon, double sensitivity) {
   } else {
     lambda = granularity_ * epsilon_ / (sensitivity_ + granularity_);
   }
-  geometric_distro_ = absl::make_unique<GeometricDistribution>(lambda);
+  geometric_distro_ = absl::make_unique<GeometricDistribution>(lambda, sampler);
 }
 
 double LaplaceDistribution::GetUniformDouble() { return UniformDouble(); }
 
 bool LaplaceDistribution::GetBoolean() {
-  return absl::Bernoulli(SecureURBG::GetSingleton(), 0.5);
+  return absl::Bernoulli(SecureURBG::GetThreadLocal(), 0.5);
 }
 double LaplaceDistribution::Sample() { return Sample(1.0); }
 
@@ -219,6 +344,45 @@ double LaplaceDistribution::Sample(double scale) {
   return sample * granularity_;
 }
 
+void LaplaceDistribution::SampleBatch(absl::Span<double> out, double scale) {
+  // Geometric samples are drawn in chunks so that the per-scale setup of the
+  // geometric distribution is done once per chunk rather than once per sample.
+  constexpr size_t kChunkSize = 64;
+  int64_t geometric_samples[kChunkSize];
+
+  SecureURBG& random = SecureURBG::GetThreadLocal();
+  uint64_t sign_bits = 0;
+  int num_sign_bits = 0;
+  auto next_sign = [&random, &sign_bits, &num_sign_bits]() {
+    if (num_sign_bits == 0) {
+      sign_bits = random();
+      num_sign_bits = 64;
+    }
+    bool sign = sign_bits & 1;
+    sign_bits >>= 1;
+    --num_sign_bits;
+    return sign;
+  };
+
+  for (size_t start = 0; start < out.size(); start += kChunkSize) {
+    size_t chunk_size = std::min(kChunkSize, out.size() - start);
+    geometric_distro_->SampleBatch(
+        absl::Span<int64_t>(geometric_samples, chunk_size), scale);
+    for (size_t i = 0; i < chunk_size; ++i) {
+      int64_t sample = geometric_samples[i];
+      bool sign = next_sign();
+      // Keep a sample of 0 only if the sign is positive. Otherwise, the
+      // probability of 0 would be twice as high as it should be.
+      while (sample == 0 && !sign) {
+        sample = geometric_distro_->Sample(scale);
+        sign = next_sign();
+      }
+      sample = sign ? sample : -sample;
+      out[start + i] = sample * granularity_;
+    }
+  }
+}
+
 double LaplaceDistribution::GetGranularity() { return granularity_; }
 
 double LaplaceDistribution::GetDiversity() { return sensitivity_ / epsilon_; }
@@ -238,5 +402,46 @@ int64_t LaplaceDistribution::MemoryUsed() {
   return memory;
 }
 
+DiscreteLaplaceDistribution::DiscreteLaplaceDistribution(
+    double epsilon, double sensitivity, GeometricSampler sampler) {
+  double lambda;
+  if (sensitivity == 0) {
+    lambda = std::numeric_limits<double>::infinity();
+  } else {
+    lambda = epsilon / sensitivity;
+  }
+  geometric_distro_ = absl::make_unique<GeometricDistribution>(lambda, sampler);
+}
+
+bool DiscreteLaplaceDistribution::GetBoolean() {
+  return absl::Bernoulli(SecureURBG::GetThreadLocal(), 0.5);
+}
+
+int64_t DiscreteLaplaceDistribution::Sample() { return Sample(1.0); }
+
+int64_t DiscreteLaplaceDistribution::Sample(double scale) {
+  int64_t sample;
+  bool sign;
+  do {
+    sample = geometric_distro_->Sample(scale);
+    sign = GetBoolean();
+    // Keep a sample of 0 only if the sign is positive. Otherwise, the
+    // probability of 0 would be twice as high as it should be.
+  } while (sample == 0 && !sign);
+  return sign ? sample : -sample;
+}
+
+bool DiscreteLaplaceDistribution::SupportsScale(double scale) {
+  return geometric_distro_->Lambda() / scale >= 1.0 / (int64_t{1} << 59);
+}
+
+int64_t DiscreteLaplaceDistribution::MemoryUsed() {
+  int64_t memory = sizeof(DiscreteLaplaceDistribution);
+  if (geometric_distro_ != nullptr) {
+    memory += sizeof(*geometric_distro_);
+  }
+  return memory;
+}
+
 }  // namespace internal
 }  // namespace differential_privacy
@@ -20,6 +20,7 @@
 #include <memory>
 
 #include <cstdint>
+#include "absl/types/span.h"
 #include "base/statusor.h"
 
 namespace differential_privacy {
@@ -44,6 +45,11 @@ class GaussianDistribution {
   // Samples the Gaussian with distribution Gauss(scale*stddev).
   virtual double Sample(double scale);
 
+  // Fills `out` with independent samples of Gauss(scale*stddev). Equivalent to
+  // calling Sample(scale) for each element, but the granularity and binomial
+  // parameters are only computed once per batch.
+  virtual void SampleBatch(absl::Span<double> out, double scale);
+
   // Returns the standard deviation of this distribution.
   double Stddev();
 
@@ -53,14 +59,22 @@ class GaussianDistribution {
   double GetGranularity(double scale) const;
 
  private:
-  // Sample from geometric distribution with probability 0.5. It is much faster
-  // then using GeometricDistribution which is suitable for any probability.
-  double SampleGeometric();
-  double SampleBinomial(double sqrt_n);
-
   double stddev_;
 };
 
+// Algorithms available for drawing geometric samples. Both sample the exact
+// same distribution.
+enum class GeometricSampler {
+  // Binary search over [0, max int64_t]. Takes about 63 uniform draws and
+  // several transcendental function calls per sample.
+  kBinarySearch,
+  // Splits the sample into a quotient and a remainder modulo a power of two
+  // block size close to 1 / lambda. The remainder is drawn by rejection from a
+  // uniform integer and the quotient by Bernoulli trials with a precomputed
+  // probability, so a sample takes O(1) uniform draws in expectation.
+  kDecomposition,
+};
+
 // Returns a sample drawn from the geometric distribution of probability
 // p = 1 - e^-lambda, i.e. the number of bernoulli trial failures before the
 // first success where the success probability is as defined above. lambda must
@@ -69,7 +83,8 @@ class GaussianDistribution {
 // of their distribution.
 class GeometricDistribution {
  public:
-  explicit GeometricDistribution(double lambda);
+  explicit GeometricDistribution(
+      double lambda, GeometricSampler sampler = GeometricSampler::kBinarySearch);
 
   virtual ~GeometricDistribution() {}
 
@@ -79,10 +94,25 @@ class GeometricDistribution {
 
   virtual int64_t Sample(double scale);
 
+  // Fills `out` with independent samples of Sample(scale). The per-scale
+  // parameters are only computed once per batch.
+  virtual void SampleBatch(absl::Span<int64_t> out, double scale);
+
   double Lambda();
 
  private:
+  // Draws one sample for the already scaled lambda. overflow_threshold is
+  // the probability of not overflowing, i.e., 1 - e^(-lambda * max int64_t).
+  int64_t SampleScaled(double lambda, double overflow_threshold);
+
+  // Draws one sample for the already scaled lambda using the decomposition
+  // sampler. block_size is a power of two and continue_prob is
+  // e^(-lambda * block_size).
+  int64_t SampleDecomposed(double lambda, int64_t block_size,
+                           double continue_prob);
+
   double lambda_;
+  GeometricSampler sampler_;
 };
 
 // Calculates 'r' from the secure noise paper (see
@@ -99,7 +129,9 @@ base::StatusOr<double> CalculateGranularity(double epsilon, double sensitivity);
 // Differential Privacy".
 class LaplaceDistribution {
  public:
-  explicit LaplaceDistribution(double epsilon, double sensitivity);
+  explicit LaplaceDistribution(
+      double epsilon, double sensitivity,
+      GeometricSampler sampler = GeometricSampler::kBinarySearch);
 
   virtual ~LaplaceDistribution() = default;
 
@@ -110,6 +142,12 @@ class LaplaceDistribution {
   // Samples the Laplacian with distribution Lap(scale*b)
   virtual double Sample(double scale);
 
+  // Fills `out` with independent samples of Lap(scale*b). Has the same
+  // distribution as calling Sample(scale) for each element, but hoists the
+  // per-scale setup out of the loop and draws the sign bits 64 at a time.
+  // Subclasses overriding Sample() should override this as well.
+  virtual void SampleBatch(absl::Span<double> out, double scale);
+
   virtual int64_t MemoryUsed();
 
   virtual bool GetBoolean();
@@ -131,6 +169,40 @@ class LaplaceDistribution {
   std::unique_ptr<GeometricDistribution> geometric_distro_;
 };
 
+// DO NOT USE. Use LaplaceMechanism::AddInt64Noise instead.
+//
+// Allows sampling from the discrete laplace distribution, where the probability
+// of each integer k is proportional to e^(-|k| * epsilon / sensitivity). Adding
+// a sample to an integer-valued statistic of the given sensitivity provides
+// epsilon-differential privacy, so, unlike LaplaceDistribution, the sample is
+// never scaled by a granularity and never leaves the integer domain.
+class DiscreteLaplaceDistribution {
+ public:
+  explicit DiscreteLaplaceDistribution(
+      double epsilon, double sensitivity,
+      GeometricSampler sampler = GeometricSampler::kBinarySearch);
+
+  virtual ~DiscreteLaplaceDistribution() = default;
+
+  virtual int64_t Sample();
+
+  // Samples the discrete laplace distribution with parameter
+  // epsilon / (scale * sensitivity).
+  virtual int64_t Sample(double scale);
+
+  virtual bool GetBoolean();
+
+  // Returns whether samples for the given scale can be drawn without risking an
+  // overflow of the underlying geometric samples. Uses the same bound as
+  // CalculateGranularity.
+  bool SupportsScale(double scale);
+
+  virtual int64_t MemoryUsed();
+
+ protected:
+  std::unique_ptr<GeometricDistribution> geometric_distro_;
+};
+
 }  // namespace internal
 }  // namespace differential_privacy
 #endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_DISTRIBUTIONS_H_
@@ -14,6 +14,8 @@
 // limitations under the License.
 //
 
+#include <cmath>
+
 #include "absl/strings/str_format.h"
 #include "benchmark/benchmark.h"
 #include "algorithms/distributions.h"
@@ -72,8 +74,20 @@ double LaplaceChiSquared(const std::vector<double>& v, double scale) {
   return chi_squared;
 }
 
+// Benchmark argument selecting the geometric sampler used by the Laplace
+// distribution.
+GeometricSampler SamplerFromState(const benchmark::State& state) {
+  return static_cast<GeometricSampler>(state.range(0));
+}
+
+void ApplySamplerArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgName("sampler")
+      ->Arg(static_cast<int>(GeometricSampler::kBinarySearch))
+      ->Arg(static_cast<int>(GeometricSampler::kDecomposition));
+}
+
 void BM_laplace_chi_squared(benchmark::State& state) {
-  LaplaceDistribution dist(1.0, 1.0);
+  LaplaceDistribution dist(1.0, 1.0, SamplerFromState(state));
   std::vector<double> samples(kNumSamples);
   for (auto _ : state) {
     std::generate(samples.begin(), samples.end(),
@@ -85,7 +99,27 @@ void BM_laplace_chi_squared(benchmark::State& state) {
                         chi_sq, kChiSquaredConfidence, kPChiSquared));
   }
 }
-BENCHMARK(BM_laplace_chi_squared);
+BENCHMARK(BM_laplace_chi_squared)->Apply(ApplySamplerArgs);
+
+void BM_laplace_sample(benchmark::State& state) {
+  LaplaceDistribution dist(1.0, 1.0, SamplerFromState(state));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dist.Sample());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_laplace_sample)->Apply(ApplySamplerArgs);
+
+void BM_geometric_sample(benchmark::State& state) {
+  // Lambda as used by a Laplace distribution with epsilon = sensitivity = 1,
+  // i.e., roughly 2^-40.
+  GeometricDistribution dist(std::ldexp(1.0, -40), SamplerFromState(state));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dist.Sample());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_geometric_sample)->Apply(ApplySamplerArgs);
 
 }  // namespace
 }  // namespace internal
@@ -23,6 +23,7 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/str_replace.h"
 #include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/rand.h"
 #include "algorithms/util.h"
 #include "base/status.h"
 
@@ -71,6 +72,19 @@ TEST(LaplaceDistributionTest, CheckStatisticsForGeoUnitValues) {
   EXPECT_NEAR(3.0, Kurtosis(samples, mean, var), 0.1);
 }
 
+TEST(LaplaceDistributionTest, CheckStatisticsForDecompositionSampler) {
+  LaplaceDistribution dist(1.0, 1.0, GeometricSampler::kDecomposition);
+  std::vector<double> samples(kNumGeometricSamples);
+  std::generate(samples.begin(), samples.end(),
+                [&dist]() { return dist.Sample(1.0); });
+  double mean = Mean(samples);
+  double var = Variance(samples);
+  EXPECT_NEAR(0.0, mean, 0.01);
+  EXPECT_NEAR(2.0, var, 0.1);
+  EXPECT_NEAR(0.0, Skew(samples, mean, std::sqrt(var)), 0.1);
+  EXPECT_NEAR(3.0, Kurtosis(samples, mean, var), 0.1);
+}
+
 TEST(LaplaceDistributionTest, CheckStatisticsForGeoSpecificDistribution) {
   double sensitivity = kOneOverLog2;
   LaplaceDistribution dist(1.0, sensitivity);
@@ -98,12 +112,72 @@ TEST(LaplaceDistributionTest, CheckStatisticsForGeoSpecificScaledDistribution) {
               Variance(samples), 0.15 * scale);
 }
 
+TEST(LaplaceDistributionTest, CheckStatisticsForBatchedSamples) {
+  double sensitivity = kOneOverLog2;
+  double scale = 3.0;
+  LaplaceDistribution dist(1.0, sensitivity);
+  std::vector<double> samples(kNumGeometricSamples);
+  dist.SampleBatch(absl::MakeSpan(samples), scale);
+  double mean = Mean(samples);
+  double var = Variance(samples);
+  EXPECT_NEAR(0.0, mean, 0.01 * scale);
+  EXPECT_NEAR(2.0 * scale * scale * sensitivity * sensitivity, var,
+              0.15 * scale);
+  EXPECT_NEAR(0.0, Skew(samples, mean, std::sqrt(var)), 0.1);
+  EXPECT_NEAR(3.0, Kurtosis(samples, mean, var), 0.1);
+}
+
+TEST(LaplaceDistributionTest, BatchedSamplesAreMultiplesOfGranularity) {
+  LaplaceDistribution dist(1.0, 1.0);
+  std::vector<double> samples(1000);
+  dist.SampleBatch(absl::MakeSpan(samples), 1.0);
+  for (double sample : samples) {
+    EXPECT_EQ(sample, RoundToNearestMultiple(sample, dist.GetGranularity()));
+  }
+}
+
 TEST(LaplaceDistributionTest, Cdf) {
   EXPECT_EQ(LaplaceDistribution::cdf(5, 0), .5);
   EXPECT_EQ(LaplaceDistribution::cdf(1, -1), .5 * exp(-1));
   EXPECT_EQ(LaplaceDistribution::cdf(1, 1), 1 - .5 * exp(-1));
 }
 
+TEST(DiscreteLaplaceDistributionTest, CheckStatisticsForUnitValues) {
+  DiscreteLaplaceDistribution dist(1.0, 1.0);
+  std::vector<double> samples(kNumGeometricSamples);
+  std::generate(samples.begin(), samples.end(),
+                [&dist]() { return dist.Sample(1.0); });
+  // The discrete laplace distribution with ratio q = e^-1 has a variance of
+  // 2q / (1 - q)^2.
+  double q = std::exp(-1.0);
+  EXPECT_NEAR(0.0, Mean(samples), 0.01);
+  EXPECT_NEAR(2 * q / std::pow(1 - q, 2), Variance(samples), 0.1);
+}
+
+TEST(DiscreteLaplaceDistributionTest, CheckStatisticsForScaledDistribution) {
+  DiscreteLaplaceDistribution dist(1.0, 2.0, GeometricSampler::kDecomposition);
+  std::vector<double> samples(kNumGeometricSamples);
+  std::generate(samples.begin(), samples.end(),
+                [&dist]() { return dist.Sample(2.0); });
+  double q = std::exp(-0.25);
+  EXPECT_NEAR(0.0, Mean(samples), 0.05);
+  EXPECT_NEAR(2 * q / std::pow(1 - q, 2), Variance(samples), 1.0);
+}
+
+TEST(DiscreteLaplaceDistributionTest, ZeroSensitivityHasNoNoise) {
+  DiscreteLaplaceDistribution dist(1.0, 0.0);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(dist.Sample(), 0);
+  }
+}
+
+TEST(DiscreteLaplaceDistributionTest, SupportsScale) {
+  DiscreteLaplaceDistribution dist(1.0, 1.0);
+  EXPECT_TRUE(dist.SupportsScale(1.0));
+  EXPECT_TRUE(dist.SupportsScale(std::pow(2.0, 59)));
+  EXPECT_FALSE(dist.SupportsScale(std::pow(2.0, 60)));
+}
+
 TEST(GaussDistributionTest, CheckStatisticsForUnitValues) {
   GaussianDistribution dist(1.0);
   std::vector<double> samples(kGaussianSamples);
@@ -134,6 +208,16 @@ TEST(GaussDistributionTest, CheckStatisticsForSpecificScaledDistribution) {
   EXPECT_NEAR(stddev * stddev * scale * scale, Variance(samples), 0.1 * scale);
 }
 
+TEST(GaussDistributionTest, CheckStatisticsForBatchedSamples) {
+  double stddev = kOneOverLog2;
+  double scale = 3.0;
+  GaussianDistribution dist(stddev);
+  std::vector<double> samples(kGaussianSamples);
+  dist.SampleBatch(absl::MakeSpan(samples), scale);
+  EXPECT_NEAR(0.0, Mean(samples), 0.01 * scale);
+  EXPECT_NEAR(stddev * stddev * scale * scale, Variance(samples), 0.1 * scale);
+}
+
 TEST(GaussDistributionTest, StandardDeviationGetter) {
   double stddev = kOneOverLog2;
   GaussianDistribution dist(stddev);
@@ -159,6 +243,61 @@ TEST(GeometricDistributionTest, LargeProbabilityStats) {
   EXPECT_NEAR(std::sqrt(2), std::sqrt(Variance(samples)), 0.05);
 }
 
+TEST(GeometricDistributionTest, BatchedStats) {
+  GeometricDistribution dist(-1.0 * std::log(1.0 - 0.5));
+  std::vector<int64_t> samples(kNumGeometricSamples);
+  dist.SampleBatch(absl::MakeSpan(samples), 1.0);
+  for (int64_t& sample : samples) {
+    ++sample;
+  }
+  EXPECT_NEAR(2, Mean(samples), 0.01);
+  EXPECT_NEAR(std::sqrt(2), std::sqrt(Variance(samples)), 0.05);
+}
+
+TEST(GeometricDistributionTest, DecompositionSmallProbabilityStats) {
+  GeometricDistribution dist(-1.0 * std::log(1.0 - 1e-6),
+                             GeometricSampler::kDecomposition);
+  std::vector<int64_t> samples(kNumGeometricSamples);
+  std::generate(samples.begin(), samples.end(),
+                [&dist]() { return dist.Sample() + 1; });
+  EXPECT_NEAR(1000000, Mean(samples), 10000);
+  EXPECT_NEAR(999999.5, std::sqrt(Variance(samples)), 10000);
+}
+
+TEST(GeometricDistributionTest, DecompositionLargeProbabilityStats) {
+  GeometricDistribution dist(-1.0 * std::log(1.0 - 0.5),
+                             GeometricSampler::kDecomposition);
+  std::vector<int64_t> samples(kNumGeometricSamples);
+  std::generate(samples.begin(), samples.end(),
+                [&dist]() { return dist.Sample() + 1; });
+  EXPECT_NEAR(2, Mean(samples), 0.01);
+  EXPECT_NEAR(std::sqrt(2), std::sqrt(Variance(samples)), 0.05);
+}
+
+TEST(GeometricDistributionTest, DecompositionRatios) {
+  double p = 1e-2;
+  GeometricDistribution dist(-1.0 * std::log(1.0 - p),
+                             GeometricSampler::kDecomposition);
+  std::vector<int64_t> counts(51, 0);
+  for (int i = 0; i < kNumGeometricSamples; ++i) {
+    int64_t sample = dist.Sample();
+    if (sample < counts.size()) {
+      ++counts[sample];
+    }
+  }
+  std::vector<double> ratios;
+  for (int i = 0; i < counts.size() - 1; ++i) {
+    ratios.push_back(static_cast<double>(counts[i + 1]) /
+                     static_cast<double>(counts[i]));
+  }
+  EXPECT_NEAR(1 - p, Mean(ratios), 1e-2);
+}
+
+TEST(GeometricDistributionTest, DecompositionZeroLambdaOverflows) {
+  GeometricDistribution dist(0, GeometricSampler::kDecomposition);
+  EXPECT_EQ(dist.Sample(), std::numeric_limits<int64_t>::max());
+}
+
 TEST(GeometricDistributionTest, Ratios) {
   double p = 1e-2;
   GeometricDistribution dist(-1.0 * std::log(1.0 - p));
@@ -327,6 +466,40 @@ TEST(GeometricDistribution, ImpossibleDoubles) {
   EXPECT_GT(count, 0);
 }
 
+TEST(GeometricDistribution, DecompositionImpossibleDoubles) {
+  GeometricDistribution distribution(1e-15, GeometricSampler::kDecomposition);
+  double count = 0;
+  constexpr int kIter = 1000000;
+  for (int i = 0; i < kIter; ++i) {
+    int64_t val = distribution.Sample();
+    ASSERT_GE(val, 0);
+
+    if (val > (1LL << 53) && val % 2) {
+      ++count;
+    }
+  }
+  EXPECT_GT(count, 0);
+}
+
+#ifdef DIFFERENTIAL_PRIVACY_DETERMINISTIC_RNG_FOR_TESTING
+TEST(DeterministicRandomnessTest, NoiseIsReproducibleForSameSeed) {
+  constexpr int kNumSamples = 1000;
+  auto draw = [](uint64_t seed) {
+    ScopedDeterministicRandomnessForTesting scope(seed);
+    LaplaceDistribution laplace(1.0, 1.0);
+    GaussianDistribution gaussian(1.0);
+    std::vector<double> samples;
+    for (int i = 0; i < kNumSamples; ++i) {
+      samples.push_back(laplace.Sample());
+      samples.push_back(gaussian.Sample());
+    }
+    return samples;
+  };
+  EXPECT_EQ(draw(1), draw(1));
+  EXPECT_NE(draw(1), draw(2));
+}
+#endif
+
 }  // namespace
 }  // namespace internal
 }  // namespace differential_privacy
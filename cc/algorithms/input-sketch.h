@@ -0,0 +1,252 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_INPUT_SKETCH_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_INPUT_SKETCH_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "base/percentile.h"
+#include "base/status.h"
+#include "proto/summary.pb.h"
+#include "proto/util.h"
+#include "base/canonical_errors.h"
+
+namespace differential_privacy {
+
+// The inputs of an order statistic, from which BinarySearch takes the relative
+// ranks of the values it searches. See base::Percentile for the meaning of the
+// relative ranks.
+//
+// Adding or removing a single input must change the rank of any value, i.e.,
+// the relative rank times the number of inputs, by at most one, since the
+// search adds noise calibrated to that sensitivity.
+template <typename T>
+class InputSketch {
+ public:
+  virtual ~InputSketch() = default;
+
+  virtual void Add(const T& t) = 0;
+
+  virtual void Reset() = 0;
+
+  virtual void Serialize(BinarySearchSummary* summary) = 0;
+
+  virtual base::Status Merge(const BinarySearchSummary& summary) = 0;
+
+  virtual int64_t Memory() = 0;
+
+  virtual int64_t num_values() = 0;
+
+  virtual std::pair<double, double> GetRelativeRank(const T& t) = 0;
+
+  // Width of the intervals within which the sketch cannot tell inputs apart,
+  // or 0 if it keeps the inputs themselves.
+  virtual double Resolution() const { return 0; }
+};
+
+// Keeps every input, so that ranks are exact. Memory and summaries grow
+// linearly with the number of inputs.
+template <typename T>
+class ExactInputSketch : public InputSketch<T> {
+ public:
+  ExactInputSketch() = default;
+
+  explicit ExactInputSketch(std::unique_ptr<base::Percentile<T>> percentile)
+      : percentile_(std::move(*percentile)) {}
+
+  void Add(const T& t) override { percentile_.Add(t); }
+
+  void Reset() override { percentile_.Reset(); }
+
+  void Serialize(BinarySearchSummary* summary) override {
+    percentile_.SerializeToProto(summary->mutable_input());
+  }
+
+  base::Status Merge(const BinarySearchSummary& summary) override {
+    if (summary.has_binned_input()) {
+      return base::InvalidArgumentError(
+          "Binned inputs cannot be merged into exact inputs.");
+    }
+    percentile_.MergeFromProto(summary.input());
+    return base::OkStatus();
+  }
+
+  int64_t Memory() override {
+    return sizeof(ExactInputSketch<T>) - sizeof(base::Percentile<T>) +
+           percentile_.Memory();
+  }
+
+  int64_t num_values() override { return percentile_.num_values(); }
+
+  std::pair<double, double> GetRelativeRank(const T& t) override {
+    return percentile_.GetRelativeRank(t);
+  }
+
+ private:
+  base::Percentile<T> percentile_;
+};
+
+// Counts the inputs in a fixed number of equal-width bins over [lower, upper],
+// plus one count each for the inputs below and above. Memory and summaries are
+// linear in the number of bins, regardless of the number of inputs, and
+// summaries with the same parameters merge by adding counts.
+//
+// The rank of a value within a bin is interpolated, assuming the inputs of the
+// bin are spread uniformly over it. This keeps the sensitivity of ranks at one,
+// unlike sketches whose compaction depends on the other inputs (e.g., KLL). The
+// cost is that ranks are only exact at bin boundaries.
+template <typename T>
+class BinnedInputSketch : public InputSketch<T> {
+ public:
+  BinnedInputSketch(T lower, T upper, int num_bins)
+      : lower_(lower),
+        upper_(upper),
+        // Halve the bounds so that the range does not overflow.
+        half_lower_(lower / 2.0),
+        half_range_(upper / 2.0 - lower / 2.0),
+        counts_(num_bins + 2, 0) {}
+
+  void Add(const T& t) override {
+    if (std::isnan(static_cast<double>(t))) return;
+    ++counts_[CountIndex(t)];
+    ++num_values_;
+    cumulative_counts_.clear();
+  }
+
+  void Reset() override {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    num_values_ = 0;
+    cumulative_counts_.clear();
+  }
+
+  void Serialize(BinarySearchSummary* summary) override {
+    BinnedInputs* binned = summary->mutable_binned_input();
+    binned->set_lower(lower_);
+    binned->set_upper(upper_);
+    binned->set_below_count(counts_.front());
+    binned->mutable_bin_count()->Reserve(num_bins());
+    for (int i = 1; i <= num_bins(); ++i) {
+      binned->add_bin_count(counts_[i]);
+    }
+    binned->set_above_count(counts_.back());
+  }
+
+  base::Status Merge(const BinarySearchSummary& summary) override {
+    if (!summary.has_binned_input()) {
+      // Exact inputs can be sketched like any other input.
+      for (const ValueType& input : summary.input()) {
+        Add(GetValue<T>(input));
+      }
+      return base::OkStatus();
+    }
+    const BinnedInputs& binned = summary.binned_input();
+    if (binned.lower() != static_cast<double>(lower_) ||
+        binned.upper() != static_cast<double>(upper_) ||
+        binned.bin_count_size() != num_bins()) {
+      return base::InvalidArgumentError(
+          "Merged binned inputs must have the same bounds and number of "
+          "bins.");
+    }
+    counts_.front() += binned.below_count();
+    for (int i = 0; i < num_bins(); ++i) {
+      counts_[i + 1] += binned.bin_count(i);
+    }
+    counts_.back() += binned.above_count();
+    num_values_ = std::accumulate(counts_.begin(), counts_.end(), int64_t{0});
+    cumulative_counts_.clear();
+    return base::OkStatus();
+  }
+
+  int64_t Memory() override {
+    return sizeof(BinnedInputSketch<T>) +
+           sizeof(int64_t) *
+               (counts_.capacity() + cumulative_counts_.capacity());
+  }
+
+  int64_t num_values() override { return num_values_; }
+
+  // Returns the interpolated fraction of inputs less than t as both ranks,
+  // since the sketch cannot tell inputs equal to t apart from the others in
+  // the bin of t.
+  std::pair<double, double> GetRelativeRank(const T& t) override {
+    if (num_values_ == 0) {
+      return std::make_pair(0, 1);
+    }
+    if (cumulative_counts_.empty()) {
+      // cumulative_counts_[i] is the number of inputs in counts_[0, i).
+      cumulative_counts_.resize(counts_.size() + 1);
+      cumulative_counts_[0] = 0;
+      std::partial_sum(counts_.begin(), counts_.end(),
+                       cumulative_counts_.begin() + 1);
+    }
+
+    double num_less;
+    if (t < lower_) {
+      num_less = 0;
+    } else if (t > upper_) {
+      num_less = num_values_ - counts_.back();
+    } else {
+      double position = Position(t);
+      int bin = std::min(static_cast<int>(position), num_bins() - 1);
+      num_less = cumulative_counts_[bin + 1] +
+                 counts_[bin + 1] * std::min(position - bin, 1.0);
+    }
+    double rank = num_less / num_values_;
+    return std::make_pair(rank, rank);
+  }
+
+  double Resolution() const override { return 2 * half_range_ / num_bins(); }
+
+  int num_bins() const { return counts_.size() - 2; }
+
+ private:
+  // Position of a value in [lower, upper] in units of bins from lower.
+  double Position(const T& t) const {
+    if (half_range_ <= 0) return 0;
+    return (t / 2.0 - half_lower_) / half_range_ * num_bins();
+  }
+
+  // Index into counts_ of the count a value is added to.
+  int CountIndex(const T& t) const {
+    if (t < lower_) return 0;
+    if (t > upper_) return counts_.size() - 1;
+    return std::min(static_cast<int>(Position(t)), num_bins() - 1) + 1;
+  }
+
+  T lower_;
+  T upper_;
+  double half_lower_;
+  double half_range_;
+
+  // Number of inputs below lower, in each bin, and above upper.
+  std::vector<int64_t> counts_;
+  int64_t num_values_ = 0;
+
+  // Prefix sums of counts_, computed when ranks are first needed after the
+  // counts have changed.
+  std::vector<int64_t> cumulative_counts_;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_INPUT_SKETCH_H_
@@ -0,0 +1,160 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/input-sketch.h"
+
+#include <limits>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/random/random.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::testing::DoubleNear;
+using ::testing::Pair;
+
+TEST(BinnedInputSketchTest, InterpolatesRanksWithinBins) {
+  BinnedInputSketch<double> sketch(0, 10, 10);
+  for (double input : {0.5, 1.5, 1.5, 2.5}) {
+    sketch.Add(input);
+  }
+  EXPECT_EQ(sketch.num_values(), 4);
+  EXPECT_THAT(sketch.GetRelativeRank(0), Pair(0, 0));
+  EXPECT_THAT(sketch.GetRelativeRank(1), Pair(.25, .25));
+  EXPECT_THAT(sketch.GetRelativeRank(1.5), Pair(.5, .5));
+  EXPECT_THAT(sketch.GetRelativeRank(2), Pair(.75, .75));
+  EXPECT_THAT(sketch.GetRelativeRank(10), Pair(1, 1));
+  EXPECT_EQ(sketch.Resolution(), 1);
+}
+
+TEST(BinnedInputSketchTest, CountsInputsOutsideBounds) {
+  BinnedInputSketch<int64_t> sketch(0, 100, 4);
+  for (int64_t input : {-5, -1, 50, 200}) {
+    sketch.Add(input);
+  }
+  EXPECT_EQ(sketch.num_values(), 4);
+  EXPECT_THAT(sketch.GetRelativeRank(0), Pair(.5, .5));
+  EXPECT_THAT(sketch.GetRelativeRank(100), Pair(.75, .75));
+}
+
+TEST(BinnedInputSketchTest, HandlesFullRangeOfType) {
+  BinnedInputSketch<double> sketch(std::numeric_limits<double>::lowest(),
+                                   std::numeric_limits<double>::max(), 2);
+  sketch.Add(-1e308);
+  sketch.Add(std::numeric_limits<double>::max());
+  EXPECT_THAT(sketch.GetRelativeRank(0), Pair(.5, .5));
+  EXPECT_THAT(sketch.GetRelativeRank(std::numeric_limits<double>::max()),
+              Pair(1, 1));
+}
+
+TEST(BinnedInputSketchTest, SingleInputChangesRanksByAtMostOne) {
+  absl::BitGen gen;
+  BinnedInputSketch<double> sketch(-100, 100, 37);
+  for (int i = 0; i < 1000; ++i) {
+    sketch.Add(absl::Gaussian(gen, 0.0, 30.0));
+  }
+  std::vector<double> ranks;
+  for (double value = -100; value <= 100; value += 0.7) {
+    ranks.push_back(sketch.GetRelativeRank(value).first * sketch.num_values());
+  }
+  sketch.Add(absl::Uniform(gen, -100.0, 100.0));
+  int i = 0;
+  for (double value = -100; value <= 100; value += 0.7) {
+    double rank = sketch.GetRelativeRank(value).first * sketch.num_values();
+    EXPECT_THAT(rank - ranks[i++], DoubleNear(0.5, 0.5 + 1e-9));
+  }
+}
+
+TEST(BinnedInputSketchTest, SerializeAndMerge) {
+  BinnedInputSketch<double> first(0, 8, 8);
+  BinnedInputSketch<double> second(0, 8, 8);
+  BinnedInputSketch<double> all(0, 8, 8);
+  for (double input : {-1.0, 0.5, 3.5, 3.7, 9.0}) {
+    first.Add(input);
+    all.Add(input);
+  }
+  for (double input : {1.5, 7.5, 8.0}) {
+    second.Add(input);
+    all.Add(input);
+  }
+
+  BinarySearchSummary summary;
+  first.Serialize(&summary);
+  EXPECT_EQ(summary.binned_input().bin_count_size(), 8);
+  EXPECT_EQ(summary.binned_input().below_count(), 1);
+  EXPECT_EQ(summary.binned_input().above_count(), 1);
+  EXPECT_TRUE(second.Merge(summary).ok());
+  EXPECT_EQ(second.num_values(), all.num_values());
+  for (double value = 0; value <= 8; value += 0.25) {
+    EXPECT_EQ(second.GetRelativeRank(value), all.GetRelativeRank(value));
+  }
+}
+
+TEST(BinnedInputSketchTest, MergeRequiresSameBins) {
+  BinnedInputSketch<double> sketch(0, 8, 8);
+  BinarySearchSummary summary;
+  BinnedInputSketch<double>(0, 8, 4).Serialize(&summary);
+  EXPECT_FALSE(sketch.Merge(summary).ok());
+  summary.Clear();
+  BinnedInputSketch<double>(0, 16, 8).Serialize(&summary);
+  EXPECT_FALSE(sketch.Merge(summary).ok());
+}
+
+TEST(BinnedInputSketchTest, MergesExactInputs) {
+  ExactInputSketch<int> exact;
+  exact.Add(3);
+  exact.Add(5);
+  BinarySearchSummary summary;
+  exact.Serialize(&summary);
+
+  BinnedInputSketch<int> binned(0, 8, 8);
+  EXPECT_TRUE(binned.Merge(summary).ok());
+  EXPECT_EQ(binned.num_values(), 2);
+  EXPECT_THAT(binned.GetRelativeRank(4), Pair(.5, .5));
+
+  // The other way around would need the inputs that were binned.
+  summary.Clear();
+  binned.Serialize(&summary);
+  EXPECT_FALSE(exact.Merge(summary).ok());
+}
+
+TEST(BinnedInputSketchTest, Reset) {
+  BinnedInputSketch<double> sketch(0, 1, 4);
+  sketch.Add(0.5);
+  sketch.Reset();
+  EXPECT_EQ(sketch.num_values(), 0);
+  sketch.Add(0.1);
+  EXPECT_THAT(sketch.GetRelativeRank(0.5), Pair(1, 1));
+}
+
+TEST(ExactInputSketchTest, MatchesPercentile) {
+  ExactInputSketch<double> sketch;
+  base::Percentile<double> percentile;
+  for (double input : {1.0, 2.0, 2.0, 3.0, 5.0}) {
+    sketch.Add(input);
+    percentile.Add(input);
+  }
+  EXPECT_EQ(sketch.Resolution(), 0);
+  for (double value : {0.0, 2.0, 3.0, 4.0, 6.0}) {
+    EXPECT_EQ(sketch.GetRelativeRank(value), percentile.GetRelativeRank(value));
+  }
+}
+
+}  // namespace
+}  // namespace differential_privacy
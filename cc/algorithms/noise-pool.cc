@@ -0,0 +1,169 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/noise-pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "absl/memory/memory.h"
+#include "algorithms/util.h"
+#include "base/canonical_errors.h"
+
+namespace differential_privacy {
+namespace {
+
+// Overwrites samples with zeros through a volatile pointer, so that the writes
+// are not optimized away when the memory is freed afterwards.
+void ZeroSamples(absl::Span<double> samples) {
+  volatile double* data = samples.data();
+  for (size_t i = 0; i < samples.size(); ++i) {
+    data[i] = 0;
+  }
+}
+
+}  // namespace
+
+base::StatusOr<std::unique_ptr<NoisePool>> NoisePool::Create(
+    std::unique_ptr<NumericalMechanism> mechanism, double privacy_budget,
+    const Options& options) {
+  if (mechanism == nullptr) {
+    return base::InvalidArgumentError("Mechanism must be set.");
+  }
+  if (std::isnan(privacy_budget) ||
+      !(0 < privacy_budget && privacy_budget <= 1)) {
+    return base::InvalidArgumentError(
+        "Privacy budget must be in the interval (0, 1].");
+  }
+  if (options.capacity < 1) {
+    return base::InvalidArgumentError("Capacity must be positive.");
+  }
+  if (options.low_watermark < 0 ||
+      options.low_watermark >= options.high_watermark) {
+    return base::InvalidArgumentError(
+        "Low watermark must be nonnegative and less than the high watermark.");
+  }
+  if (options.high_watermark > options.capacity) {
+    return base::InvalidArgumentError(
+        "High watermark must not exceed the capacity.");
+  }
+  double granularity = mechanism->GetGranularity(privacy_budget);
+  return absl::WrapUnique(new NoisePool(std::move(mechanism), privacy_budget,
+                                        granularity, options));
+}
+
+NoisePool::NoisePool(std::unique_ptr<NumericalMechanism> mechanism,
+                     double privacy_budget, double granularity,
+                     const Options& options)
+    : privacy_budget_(privacy_budget),
+      granularity_(granularity),
+      options_(options),
+      mechanism_(std::move(mechanism)),
+      ring_(options.capacity, 0.0) {
+  worker_ = std::thread([this]() { Refill(); });
+}
+
+NoisePool::~NoisePool() {
+  {
+    absl::MutexLock lock(&ring_mutex_);
+    stopped_ = true;
+  }
+  worker_.join();
+  absl::MutexLock lock(&ring_mutex_);
+  ZeroSamples(absl::MakeSpan(ring_));
+}
+
+double NoisePool::AddNoise(double result) {
+  double noise;
+  if (!Pop(&noise)) {
+    Generate(absl::Span<double>(&noise, 1));
+  }
+  if (granularity_ > 0) {
+    result = RoundToNearestMultiple(result, granularity_);
+  }
+  return result + noise;
+}
+
+int64_t NoisePool::Available() {
+  absl::MutexLock lock(&ring_mutex_);
+  return size_;
+}
+
+NoisePool::Stats NoisePool::GetStats() {
+  absl::MutexLock lock(&ring_mutex_);
+  return {pooled_, synchronous_};
+}
+
+int64_t NoisePool::MemoryUsed() {
+  absl::MutexLock lock(&mechanism_mutex_);
+  return sizeof(NoisePool) + options_.capacity * sizeof(double) +
+         mechanism_->MemoryUsed();
+}
+
+bool NoisePool::Pop(double* noise) {
+  absl::MutexLock lock(&ring_mutex_);
+  if (size_ == 0) {
+    ++synchronous_;
+    return false;
+  }
+  *noise = ring_[head_];
+  ring_[head_] = 0;
+  head_ = (head_ + 1) % options_.capacity;
+  --size_;
+  ++pooled_;
+  return true;
+}
+
+void NoisePool::Generate(absl::Span<double> noise) {
+  std::fill(noise.begin(), noise.end(), 0.0);
+  absl::MutexLock lock(&mechanism_mutex_);
+  mechanism_->AddNoiseBatch(noise, noise, privacy_budget_);
+}
+
+void NoisePool::Refill() {
+  std::vector<double> chunk(kNoiseBatchSize);
+  while (true) {
+    int64_t missing;
+    {
+      absl::MutexLock lock(&ring_mutex_);
+      auto needs_refill = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(ring_mutex_) {
+        return stopped_ || size_ <= options_.low_watermark;
+      };
+      ring_mutex_.Await(absl::Condition(&needs_refill));
+      if (stopped_) break;
+      missing = options_.high_watermark - size_;
+    }
+    // Samples are generated without holding ring_mutex_ and published in
+    // chunks, so that consumers can pop while the worker is generating.
+    while (missing > 0) {
+      int64_t count = std::min<int64_t>(missing, chunk.size());
+      Generate(absl::Span<double>(chunk.data(), count));
+      absl::MutexLock lock(&ring_mutex_);
+      if (stopped_) break;
+      count = std::min(count, options_.capacity - size_);
+      for (int64_t i = 0; i < count; ++i) {
+        ring_[(head_ + size_) % options_.capacity] = chunk[i];
+        ++size_;
+      }
+      missing -= count;
+      if (size_ == options_.capacity) break;
+    }
+    ZeroSamples(absl::MakeSpan(chunk));
+  }
+  ZeroSamples(absl::MakeSpan(chunk));
+}
+
+}  // namespace differential_privacy
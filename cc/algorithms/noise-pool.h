@@ -0,0 +1,126 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_NOISE_POOL_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_NOISE_POOL_H_
+
+#include <cstdint>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "base/statusor.h"
+#include "algorithms/numerical-mechanisms.h"
+
+namespace differential_privacy {
+
+// Keeps a bounded ring of noise samples for one mechanism configuration
+// (mechanism and privacy budget) that a worker thread generates ahead of time,
+// so that AddNoise() only has to pop a sample. Meant for interactive serving,
+// where noise for the next release can be drawn before the release is
+// requested.
+//
+// Noise does not depend on the data, so drawing it early does not change the
+// privacy guarantees. Every sample is handed out at most once and its slot is
+// zeroed when it is popped. If the ring is empty, AddNoise() draws the noise
+// synchronously.
+//
+// The mechanism must satisfy the contract of
+// NumericalMechanism::GetGranularity(), which LaplaceMechanism and
+// GaussianMechanism do. The pool is thread-safe.
+class NoisePool {
+ public:
+  struct Options {
+    // Maximum number of samples held, which bounds the memory of the ring to
+    // capacity * sizeof(double) bytes.
+    int64_t capacity = 4096;
+    // The worker starts refilling once at most low_watermark samples are left.
+    int64_t low_watermark = 1024;
+    // The worker refills up to high_watermark samples. At most capacity.
+    int64_t high_watermark = 4096;
+  };
+
+  // Counters for monitoring how often AddNoise() was served from the ring.
+  struct Stats {
+    int64_t pooled;
+    int64_t synchronous;
+  };
+
+  // Creates a pool for noise that mechanism adds with privacy_budget and
+  // starts its worker thread.
+  static base::StatusOr<std::unique_ptr<NoisePool>> Create(
+      std::unique_ptr<NumericalMechanism> mechanism, double privacy_budget,
+      const Options& options);
+
+  static base::StatusOr<std::unique_ptr<NoisePool>> Create(
+      std::unique_ptr<NumericalMechanism> mechanism, double privacy_budget) {
+    return Create(std::move(mechanism), privacy_budget, Options());
+  }
+
+  // Stops the worker thread and zeroes all unused samples.
+  ~NoisePool();
+
+  NoisePool(const NoisePool&) = delete;
+  NoisePool& operator=(const NoisePool&) = delete;
+
+  // Has the same distribution as mechanism->AddNoise(result, privacy_budget).
+  double AddNoise(double result);
+
+  // Returns the number of samples currently in the ring.
+  int64_t Available();
+
+  Stats GetStats();
+
+  int64_t MemoryUsed();
+
+ private:
+  NoisePool(std::unique_ptr<NumericalMechanism> mechanism,
+            double privacy_budget, double granularity, const Options& options);
+
+  // Pops a sample from the ring into *noise. Returns false if it is empty.
+  bool Pop(double* noise) ABSL_LOCKS_EXCLUDED(ring_mutex_);
+
+  // Draws samples into noise using the mechanism.
+  void Generate(absl::Span<double> noise) ABSL_LOCKS_EXCLUDED(mechanism_mutex_);
+
+  // Body of the worker thread.
+  void Refill() ABSL_LOCKS_EXCLUDED(ring_mutex_);
+
+  const double privacy_budget_;
+  const double granularity_;
+  const Options options_;
+
+  absl::Mutex mechanism_mutex_;
+  std::unique_ptr<NumericalMechanism> mechanism_
+      ABSL_GUARDED_BY(mechanism_mutex_);
+
+  absl::Mutex ring_mutex_;
+  std::vector<double> ring_ ABSL_GUARDED_BY(ring_mutex_);
+  // Index of the oldest sample and number of samples in the ring.
+  int64_t head_ ABSL_GUARDED_BY(ring_mutex_) = 0;
+  int64_t size_ ABSL_GUARDED_BY(ring_mutex_) = 0;
+  bool stopped_ ABSL_GUARDED_BY(ring_mutex_) = false;
+  int64_t pooled_ ABSL_GUARDED_BY(ring_mutex_) = 0;
+  int64_t synchronous_ ABSL_GUARDED_BY(ring_mutex_) = 0;
+
+  std::thread worker_;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_NOISE_POOL_H_
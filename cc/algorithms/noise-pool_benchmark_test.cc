@@ -0,0 +1,115 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "algorithms/noise-pool.h"
+#include "algorithms/numerical-mechanisms.h"
+
+namespace differential_privacy {
+namespace {
+
+// Number of AddNoise() calls per benchmark run. Releases of this size fit into
+// the pool, as if noise had been pre-generated between interactive requests.
+constexpr int64_t kNumCalls = 1 << 14;
+
+std::unique_ptr<NumericalMechanism> BuildMechanism(bool gaussian) {
+  if (gaussian) {
+    return GaussianMechanism::Builder()
+        .SetL2Sensitivity(1.0)
+        .SetEpsilon(1.0)
+        .SetDelta(1e-5)
+        .Build()
+        .ValueOrDie();
+  }
+  return LaplaceMechanism::Builder()
+      .SetL1Sensitivity(1.0)
+      .SetEpsilon(1.0)
+      .Build()
+      .ValueOrDie();
+}
+
+// Times every call of add_noise and reports the latency percentiles.
+void RecordLatencies(benchmark::State& state,
+                     const std::function<double(double)>& add_noise,
+                     const std::function<void()>& prepare) {
+  std::vector<int64_t> latencies;
+  for (auto _ : state) {
+    state.PauseTiming();
+    prepare();
+    state.ResumeTiming();
+    for (int64_t i = 0; i < kNumCalls; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      benchmark::DoNotOptimize(add_noise(1.0));
+      auto end = std::chrono::steady_clock::now();
+      latencies.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+              .count());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumCalls);
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return static_cast<double>(
+        latencies[static_cast<size_t>(p * (latencies.size() - 1))]);
+  };
+  state.counters["p50_ns"] = percentile(0.5);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["p999_ns"] = percentile(0.999);
+}
+
+// Argument 0 benchmarks Laplace noise, 1 Gaussian noise.
+void BM_MechanismAddNoise(benchmark::State& state) {
+  std::unique_ptr<NumericalMechanism> mechanism =
+      BuildMechanism(state.range(0) != 0);
+  RecordLatencies(
+      state,
+      [&mechanism](double value) { return mechanism->AddNoise(value, 1.0); },
+      []() {});
+}
+BENCHMARK(BM_MechanismAddNoise)->ArgName("gaussian")->Arg(0)->Arg(1);
+
+void BM_NoisePoolAddNoise(benchmark::State& state) {
+  // Whenever at most kNumCalls samples are left, the worker refills to
+  // 2 * kNumCalls, so waiting for more than kNumCalls samples terminates.
+  NoisePool::Options options;
+  options.capacity = 2 * kNumCalls;
+  options.low_watermark = kNumCalls;
+  options.high_watermark = 2 * kNumCalls;
+  std::unique_ptr<NoisePool> pool =
+      NoisePool::Create(BuildMechanism(state.range(0) != 0), 1.0, options)
+          .ValueOrDie();
+  RecordLatencies(
+      state, [&pool](double value) { return pool->AddNoise(value); },
+      [&pool]() {
+        // Give the worker time to refill between releases.
+        while (pool->Available() <= kNumCalls) {
+          std::this_thread::yield();
+        }
+      });
+  NoisePool::Stats stats = pool->GetStats();
+  state.counters["synchronous"] = stats.synchronous;
+}
+BENCHMARK(BM_NoisePoolAddNoise)->ArgName("gaussian")->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,216 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/noise-pool.h"
+
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/util.h"
+#include "base/testing/status_matchers.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::HasSubstr;
+
+// Adds 1, 2, 3, ... to consecutive results, so that every noise sample is
+// distinguishable.
+class CountingMechanism : public NumericalMechanism {
+ public:
+  CountingMechanism() : NumericalMechanism(1.0) {}
+
+  double AddNoise(double result, double privacy_budget) override {
+    return result + ++count_;
+  }
+
+  int64_t MemoryUsed() override { return sizeof(CountingMechanism); }
+
+ private:
+  int64_t count_ = 0;
+};
+
+void WaitUntilAvailable(NoisePool& pool, int64_t count) {
+  while (pool.Available() < count) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+}
+
+TEST(NoisePoolTest, CreateFailsForInvalidArguments) {
+  EXPECT_THAT(NoisePool::Create(nullptr, 1.0),
+              StatusIs(base::StatusCode::kInvalidArgument,
+                       HasSubstr("Mechanism must be set")));
+  EXPECT_THAT(NoisePool::Create(absl::make_unique<LaplaceMechanism>(1.0), 0),
+              StatusIs(base::StatusCode::kInvalidArgument,
+                       HasSubstr("Privacy budget")));
+  EXPECT_THAT(NoisePool::Create(absl::make_unique<LaplaceMechanism>(1.0), 1.5),
+              StatusIs(base::StatusCode::kInvalidArgument,
+                       HasSubstr("Privacy budget")));
+
+  NoisePool::Options options;
+  options.capacity = 0;
+  EXPECT_THAT(
+      NoisePool::Create(absl::make_unique<LaplaceMechanism>(1.0), 1, options),
+      StatusIs(base::StatusCode::kInvalidArgument, HasSubstr("Capacity")));
+
+  options = NoisePool::Options();
+  options.low_watermark = options.high_watermark;
+  EXPECT_THAT(
+      NoisePool::Create(absl::make_unique<LaplaceMechanism>(1.0), 1, options),
+      StatusIs(base::StatusCode::kInvalidArgument, HasSubstr("Low watermark")));
+
+  options = NoisePool::Options();
+  options.high_watermark = options.capacity + 1;
+  EXPECT_THAT(
+      NoisePool::Create(absl::make_unique<LaplaceMechanism>(1.0), 1, options),
+      StatusIs(base::StatusCode::kInvalidArgument,
+               HasSubstr("High watermark")));
+}
+
+TEST(NoisePoolTest, FillsUpToHighWatermark) {
+  NoisePool::Options options;
+  options.capacity = 100;
+  options.low_watermark = 10;
+  options.high_watermark = 50;
+  std::unique_ptr<NoisePool> pool =
+      NoisePool::Create(absl::make_unique<LaplaceMechanism>(1.0), 1.0, options)
+          .ValueOrDie();
+  WaitUntilAvailable(*pool, 50);
+  absl::SleepFor(absl::Milliseconds(10));
+  EXPECT_EQ(pool->Available(), 50);
+
+  pool->AddNoise(0);
+  EXPECT_EQ(pool->Available(), 49);
+  EXPECT_EQ(pool->GetStats().pooled, 1);
+  EXPECT_EQ(pool->GetStats().synchronous, 0);
+}
+
+TEST(NoisePoolTest, EverySampleIsUsedOnce) {
+  constexpr int kNumCalls = 10000;
+  NoisePool::Options options;
+  options.capacity = 64;
+  options.low_watermark = 16;
+  options.high_watermark = 64;
+  std::unique_ptr<NoisePool> pool =
+      NoisePool::Create(absl::make_unique<CountingMechanism>(), 1.0, options)
+          .ValueOrDie();
+  absl::flat_hash_set<double> seen;
+  for (int i = 0; i < kNumCalls; ++i) {
+    EXPECT_TRUE(seen.insert(pool->AddNoise(0)).second);
+  }
+  NoisePool::Stats stats = pool->GetStats();
+  EXPECT_EQ(stats.pooled + stats.synchronous, kNumCalls);
+}
+
+TEST(NoisePoolTest, ConcurrentCallersGetDistinctSamples) {
+  constexpr int kNumThreads = 4;
+  constexpr int kCallsPerThread = 2500;
+  std::unique_ptr<NoisePool> pool =
+      NoisePool::Create(absl::make_unique<CountingMechanism>(), 1.0)
+          .ValueOrDie();
+  std::vector<std::vector<double>> results(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&pool, &results, t]() {
+      for (int i = 0; i < kCallsPerThread; ++i) {
+        results[t].push_back(pool->AddNoise(0));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  absl::flat_hash_set<double> seen;
+  for (const std::vector<double>& thread_results : results) {
+    for (double result : thread_results) {
+      EXPECT_TRUE(seen.insert(result).second);
+    }
+  }
+}
+
+TEST(NoisePoolTest, LaplaceNoiseMatchesMechanism) {
+  constexpr int kNumSamples = 100000;
+  // Laplace with diversity 1 / (epsilon * budget) = 2 has variance 8.
+  std::unique_ptr<NoisePool> pool =
+      NoisePool::Create(LaplaceMechanism::Builder()
+                            .SetL1Sensitivity(1.0)
+                            .SetEpsilon(1.0)
+                            .Build()
+                            .ValueOrDie(),
+                        0.5)
+          .ValueOrDie();
+  std::vector<double> samples(kNumSamples);
+  for (double& sample : samples) {
+    sample = pool->AddNoise(10.0);
+  }
+  EXPECT_NEAR(Mean(samples), 10.0, 0.1);
+  EXPECT_NEAR(Variance(samples), 8.0, 0.4);
+}
+
+TEST(NoisePoolTest, GaussianNoiseMatchesMechanism) {
+  constexpr int kNumSamples = 100000;
+  std::unique_ptr<NumericalMechanism> mechanism =
+      GaussianMechanism::Builder()
+          .SetL2Sensitivity(1.0)
+          .SetEpsilon(1.0)
+          .SetDelta(1e-5)
+          .Build()
+          .ValueOrDie();
+  const double stddev =
+      dynamic_cast<GaussianMechanism*>(mechanism.get())
+          ->CalculateStddev(1.0, 1e-5);
+  std::unique_ptr<NoisePool> pool =
+      NoisePool::Create(std::move(mechanism), 1.0).ValueOrDie();
+  std::vector<double> samples(kNumSamples);
+  for (double& sample : samples) {
+    sample = pool->AddNoise(-3.0);
+  }
+  EXPECT_NEAR(Mean(samples), -3.0, 0.05 * stddev);
+  EXPECT_NEAR(Variance(samples), stddev * stddev, 0.05 * stddev * stddev);
+}
+
+TEST(NoisePoolTest, ZeroNoiseMechanismReturnsInput) {
+  std::unique_ptr<NoisePool> pool =
+      NoisePool::Create(test_utils::ZeroNoiseMechanism::Builder()
+                            .SetEpsilon(1.0)
+                            .Build()
+                            .ValueOrDie(),
+                        1.0)
+          .ValueOrDie();
+  EXPECT_EQ(pool->AddNoise(0.1234), 0.1234);
+}
+
+TEST(NoisePoolTest, MemoryUsedIncludesRing) {
+  NoisePool::Options options;
+  options.capacity = 1000;
+  options.low_watermark = 0;
+  options.high_watermark = 1;
+  std::unique_ptr<NoisePool> pool =
+      NoisePool::Create(absl::make_unique<LaplaceMechanism>(1.0), 1.0, options)
+          .ValueOrDie();
+  EXPECT_GE(pool->MemoryUsed(), 1000 * sizeof(double));
+}
+
+}  // namespace
+}  // namespace differential_privacy
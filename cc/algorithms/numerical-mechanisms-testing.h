@@ -56,6 +56,17 @@ class ZeroNoiseMechanism : public LaplaceMechanism {
     return result;
   }
 
+  void AddNoiseBatch(absl::Span<const double> in, absl::Span<double> out,
+                     double privacy_budget) override {
+    std::copy(in.begin(), in.end(), out.begin());
+  }
+
+  int64_t AddInt64Noise(int64_t result, double privacy_budget) override {
+    return result;
+  }
+
+  double GetGranularity(double privacy_budget) override { return 0; }
+
   base::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
       double confidence_level, double privacy_budget) override {
     ConfidenceInterval confidence;
@@ -107,6 +118,13 @@ class SeededLaplaceDistribution : public internal::LaplaceDistribution {
 
   bool GetBoolean() override { return absl::Bernoulli(*rand_gen_, 0.5); }
 
+  // Draws every sample through Sample() so that batches use the seeded RNG.
+  void SampleBatch(absl::Span<double> out, double scale) override {
+    for (double& sample : out) {
+      sample = Sample(scale);
+    }
+  }
+
  protected:
   std::mt19937* rand_gen_;
   std::mt19937 owned_rand_gen_;
@@ -192,10 +210,21 @@ class MockLaplaceMechanism : public LaplaceMechanism {
     std::unique_ptr<MockLaplaceMechanism> mock_;
   };
 
-  MockLaplaceMechanism() : LaplaceMechanism(1, 1) {}
+  MockLaplaceMechanism() : MockLaplaceMechanism(1, 1) {}
   MockLaplaceMechanism(double epsilon, double sensitivity)
-      : LaplaceMechanism(epsilon, sensitivity) {}
+      : LaplaceMechanism(epsilon, sensitivity,
+                         absl::make_unique<internal::LaplaceDistribution>(
+                             epsilon, sensitivity)) {}
   MOCK_METHOD2_T(AddNoise, double(double result, double privacy_budget));
+
+  // Routes batches through the mocked AddNoise.
+  void AddNoiseBatch(absl::Span<const double> in, absl::Span<double> out,
+                     double privacy_budget) override {
+    for (size_t i = 0; i < in.size(); ++i) {
+      out[i] = AddNoise(in[i], privacy_budget);
+    }
+  }
+
   MOCK_METHOD2_T(NoiseConfidenceInterval,
                  base::StatusOr<ConfidenceInterval>(double confidence_level,
                                                     double privacy_budget));
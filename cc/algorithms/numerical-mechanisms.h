@@ -19,20 +19,27 @@
 
 #include <math.h>
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <typeinfo>
 #include <utility>
 
 #include <cstdint>
 #include "base/logging.h"
 #include "absl/base/attributes.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "base/status.h"
 #include "base/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "algorithms/distributions.h"
 #include "algorithms/util.h"
 #include "proto/confidence-interval.pb.h"
@@ -56,6 +63,10 @@ static const double kMaxOverflowProbability = std::pow(2.0, -64);
 // privacy given the sensitivities.
 static const double kGaussianSigmaAccuracy = 1e-3;
 
+// The number of noise samples AddNoiseBatch() draws from a distribution at a
+// time. Bounds the stack space used for the samples.
+static constexpr size_t kNoiseBatchSize = 256;
+
 // Provides a common abstraction for NumericalMechanism.  Numerical mechanisms
 // can add noise to data and track the remaining privacy budget.
 class NumericalMechanism {
@@ -68,8 +79,50 @@ class NumericalMechanism {
 
   double AddNoise(double result) { return AddNoise(result, 1.0); }
 
+  // Adds noise to every value of `in` and writes the results to `out`, which
+  // must have the same size. `in` and `out` may be the same span. Each value
+  // consumes the given privacy_budget, exactly as if AddNoise was called on it.
+  // Mechanisms override this to hoist the per-call setup out of the loop.
+  virtual void AddNoiseBatch(absl::Span<const double> in,
+                             absl::Span<double> out, double privacy_budget) {
+    DCHECK_EQ(in.size(), out.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+      out[i] = AddNoise(in[i], privacy_budget);
+    }
+  }
+
+  // Adds noise to an integer-valued result and returns an integer. Mechanisms
+  // that can sample their noise in the integer domain override this so that
+  // integer statistics never pass through floating point. By default, the
+  // output of AddNoise is rounded, which is post-processing and so keeps the
+  // privacy guarantee of AddNoise.
+  virtual int64_t AddInt64Noise(int64_t result, double privacy_budget) {
+    int64_t noised_result = 0;
+    SafeCastFromDouble(
+        std::round(AddNoise(static_cast<double>(result), privacy_budget)),
+        noised_result);
+    return noised_result;
+  }
+
   virtual int64_t MemoryUsed() = 0;
 
+  // Returns the memory used by a mechanism that may be shared, divided by the
+  // number of its owners, so that the memory reported by all owners adds up to
+  // the memory of the mechanism. Returns 0 for nullptr.
+  template <typename Mechanism>
+  static int64_t MemoryUsedPerOwner(
+      const std::shared_ptr<Mechanism>& mechanism) {
+    if (mechanism == nullptr) return 0;
+    return mechanism->MemoryUsed() / mechanism.use_count();
+  }
+
+  // Returns the granularity that AddNoise() rounds the result to before adding
+  // noise for the given privacy budget. The noise itself is a multiple of the
+  // granularity, so AddNoise(result, budget) has the same distribution as
+  // RoundToNearestMultiple(result, granularity) + AddNoise(0, budget). Returns
+  // 0 for mechanisms that do not round.
+  virtual double GetGranularity(double privacy_budget) { return 0; }
+
   virtual base::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
       double confidence_level, double privacy_budget, double noised_result) {
     return base::UnimplementedError(
@@ -150,6 +203,15 @@ class NumericalMechanismBuilder {
 
   virtual base::StatusOr<std::unique_ptr<NumericalMechanism>> Build() = 0;
 
+  // Returns a mechanism that may be shared with other callers, e.g. with all
+  // algorithms of a release that use the same parameters. Mechanisms whose
+  // noise methods do not modify them override this to intern the mechanism by
+  // its parameters. By default, every call builds a new mechanism.
+  virtual base::StatusOr<std::shared_ptr<NumericalMechanism>> BuildShared() {
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism, Build());
+    return std::shared_ptr<NumericalMechanism>(std::move(mechanism));
+  }
+
   virtual std::unique_ptr<NumericalMechanismBuilder> Clone() const = 0;
 
  protected:
@@ -205,6 +267,65 @@ class NumericalMechanismBuilder {
   absl::optional<double> linf_sensitivity_;
 };
 
+namespace internal {
+
+// Process-wide cache of mechanisms of type Mechanism keyed by the parameters
+// they were built for. Mechanisms that are not modified by adding noise are
+// interchangeable when their parameters are equal, so all callers with the same
+// parameters share one mechanism, which is freed with the last of them. The
+// cache is thread-safe.
+template <typename Mechanism, typename Key>
+class SharedMechanismCache {
+ public:
+  static SharedMechanismCache& Get() {
+    static SharedMechanismCache* cache = new SharedMechanismCache();
+    return *cache;
+  }
+
+  // Returns the cached mechanism for key, or calls build() and caches the
+  // mechanism it returns.
+  template <typename Build>
+  base::StatusOr<std::shared_ptr<NumericalMechanism>> GetOrBuild(
+      const Key& key, Build build) {
+    absl::MutexLock lock(&mutex_);
+    auto it = mechanisms_.find(key);
+    if (it != mechanisms_.end()) {
+      if (std::shared_ptr<NumericalMechanism> mechanism = it->second.lock()) {
+        return mechanism;
+      }
+    }
+
+    // Drop the mechanisms that are no longer used once the cache has doubled
+    // since the last time, so that dropping them takes amortized constant time.
+    if (mechanisms_.size() >= next_purge_size_) {
+      for (auto entry = mechanisms_.begin(); entry != mechanisms_.end();) {
+        if (entry->second.expired()) {
+          mechanisms_.erase(entry++);
+        } else {
+          ++entry;
+        }
+      }
+      next_purge_size_ = std::max(kMinPurgeSize, 2 * mechanisms_.size());
+    }
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> built, build());
+    std::shared_ptr<NumericalMechanism> mechanism(std::move(built));
+    mechanisms_[key] = mechanism;
+    return mechanism;
+  }
+
+ private:
+  static constexpr size_t kMinPurgeSize = 64;
+
+  SharedMechanismCache() = default;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<Key, std::weak_ptr<NumericalMechanism>> mechanisms_
+      ABSL_GUARDED_BY(mutex_);
+  size_t next_purge_size_ ABSL_GUARDED_BY(mutex_) = kMinPurgeSize;
+};
+
+}  // namespace internal
+
 // Provides differential privacy by adding Laplace noise. This class also
 // contains supporting functions related to the noise added.
 class LaplaceMechanism : public NumericalMechanism {
@@ -242,19 +363,44 @@ class LaplaceMechanism : public NumericalMechanism {
       if (!gran_or_status.ok()) return gran_or_status.status();
 
       std::unique_ptr<NumericalMechanism> result =
-          absl::make_unique<LaplaceMechanism>(epsilon, L1);
+          absl::make_unique<LaplaceMechanism>(epsilon, L1, sampler_);
       return result;
     }
 
+    // Interns the mechanism by epsilon, l1 sensitivity and sampler. Subclasses
+    // that build other mechanisms get a new mechanism for every call.
+    base::StatusOr<std::shared_ptr<NumericalMechanism>> BuildShared()
+        override {
+      if (typeid(*this) != typeid(Builder)) {
+        return NumericalMechanismBuilder::BuildShared();
+      }
+      ASSIGN_OR_RETURN(double epsilon,
+                       GetValueIfSetAndPositive(GetEpsilon(), "Epsilon"));
+      ASSIGN_OR_RETURN(double l1, CalculateL1Sensitivity());
+      using Key = std::tuple<double, double, internal::GeometricSampler>;
+      return internal::SharedMechanismCache<LaplaceMechanism, Key>::Get()
+          .GetOrBuild(Key(epsilon, l1, sampler_),
+                      [this]() { return Builder::Build(); });
+    }
+
     std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
       return absl::make_unique<Builder>(*this);
     }
 
+    // Selects how the geometric samples underlying the noise are drawn. All
+    // samplers draw from the same distribution.
+    Builder& SetGeometricSampler(internal::GeometricSampler sampler) {
+      sampler_ = sampler;
+      return *this;
+    }
+
    protected:
     absl::optional<double> GetL1Sensitivity() const { return l1_sensitivity_; }
 
    private:
     absl::optional<double> l1_sensitivity_;
+    internal::GeometricSampler sampler_ =
+        internal::GeometricSampler::kBinarySearch;
 
     // Returns the l1 sensitivity when it has been set or returns an upper bound
     // on the l1 sensitivity calculated from l0 and linf sensitivities.
@@ -283,18 +429,26 @@ class LaplaceMechanism : public NumericalMechanism {
     }
   };
 
-  explicit LaplaceMechanism(double epsilon, double sensitivity = 1.0)
+  explicit LaplaceMechanism(double epsilon, double sensitivity = 1.0,
+                            internal::GeometricSampler sampler =
+                                internal::GeometricSampler::kBinarySearch)
       : NumericalMechanism(epsilon),
         sensitivity_(sensitivity),
         diversity_(sensitivity / epsilon),
         distro_(absl::make_unique<internal::LaplaceDistribution>(
-            GetEpsilon(), sensitivity_)) {}
+            GetEpsilon(), sensitivity_, sampler)),
+        discrete_distro_(
+            absl::make_unique<internal::DiscreteLaplaceDistribution>(
+                GetEpsilon(), sensitivity_)) {}
 
+  // Draws all noise from distro, including the noise of AddInt64Noise, which
+  // rounds AddNoise.
   LaplaceMechanism(double epsilon, double sensitivity,
                    std::unique_ptr<internal::LaplaceDistribution> distro)
-      : LaplaceMechanism(epsilon, sensitivity) {
-    distro_ = std::move(distro);
-  }
+      : NumericalMechanism(epsilon),
+        sensitivity_(sensitivity),
+        diversity_(sensitivity / epsilon),
+        distro_(std::move(distro)) {}
 
   virtual ~LaplaceMechanism() = default;
 
@@ -312,6 +466,49 @@ class LaplaceMechanism : public NumericalMechanism {
     return RoundToNearestMultiple(result, distro_->GetGranularity()) + sample;
   }
 
+  // Same as calling AddNoise on every value, but samples the noise in batches.
+  void AddNoiseBatch(absl::Span<const double> in, absl::Span<double> out,
+                     double privacy_budget) override {
+    DCHECK_EQ(in.size(), out.size());
+    privacy_budget = CheckAndClampBudget(privacy_budget);
+    const double scale = 1.0 / privacy_budget;
+    const double granularity = distro_->GetGranularity();
+    double samples[kNoiseBatchSize];
+    for (size_t start = 0; start < in.size(); start += kNoiseBatchSize) {
+      size_t batch_size = std::min(kNoiseBatchSize, in.size() - start);
+      distro_->SampleBatch(absl::Span<double>(samples, batch_size), scale);
+      for (size_t i = 0; i < batch_size; ++i) {
+        out[start + i] =
+            RoundToNearestMultiple(in[start + i], granularity) + samples[i];
+      }
+    }
+  }
+
+  double GetGranularity(double privacy_budget) override {
+    return distro_->GetGranularity();
+  }
+
+  // Adds discrete laplace noise to an integer-valued result. The noise is
+  // sampled directly as an integer, so there is no snapping and no rounding.
+  // Falls back to rounding AddNoise when the mechanism was given its
+  // distribution, or when the privacy budget is too small for integer noise
+  // to be sampled safely.
+  int64_t AddInt64Noise(int64_t result, double privacy_budget) override {
+    privacy_budget = CheckAndClampBudget(privacy_budget);
+    const double scale = 1.0 / privacy_budget;
+    if (discrete_distro_ == nullptr ||
+        !discrete_distro_->SupportsScale(scale)) {
+      return NumericalMechanism::AddInt64Noise(result, privacy_budget);
+    }
+    int64_t noise = discrete_distro_->Sample(scale);
+    int64_t noised_result;
+    if (!SafeAdd(result, noise, &noised_result)) {
+      return noise > 0 ? std::numeric_limits<int64_t>::max()
+                       : std::numeric_limits<int64_t>::lowest();
+    }
+    return noised_result;
+  }
+
   virtual double GetUniformDouble() { return distro_->GetUniformDouble(); }
 
   // Returns the confidence interval of the specified confidence level of the
@@ -344,6 +541,9 @@ class LaplaceMechanism : public NumericalMechanism {
     if (distro_) {
       memory += distro_->MemoryUsed();
     }
+    if (discrete_distro_) {
+      memory += discrete_distro_->MemoryUsed();
+    }
     return memory;
   }
 
@@ -356,10 +556,78 @@ class LaplaceMechanism : public NumericalMechanism {
   double sensitivity_;
   double diversity_;
   std::unique_ptr<internal::LaplaceDistribution> distro_;
+  std::unique_ptr<internal::DiscreteLaplaceDistribution> discrete_distro_;
+};
+
+namespace internal {
+
+// Process-wide memo of Gaussian standard deviations keyed by the
+// (epsilon, delta, l2 sensitivity) tuple they were calibrated for. Calibrating
+// a standard deviation takes an exponential and a binary search over erf
+// evaluations, while the parameters rarely change between the many mechanisms
+// of a release. The cache is thread-safe and holds at most kMaxEntries entries;
+// it is cleared when full.
+class GaussianStddevCache {
+ public:
+  static constexpr size_t kMaxEntries = 4096;
+
+  static GaussianStddevCache& Get() {
+    static GaussianStddevCache* cache = new GaussianStddevCache();
+    return *cache;
+  }
+
+  // Returns the cached standard deviation for the parameters, or calls
+  // calculate() and caches its result.
+  template <typename Calculate>
+  double GetOrCalculate(double epsilon, double delta, double l2_sensitivity,
+                        Calculate calculate) {
+    Key key(epsilon, delta, l2_sensitivity);
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      auto it = entries_.find(key);
+      if (it != entries_.end()) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return it->second;
+      }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    double stddev = calculate();
+    absl::MutexLock lock(&mutex_);
+    if (entries_.size() >= kMaxEntries) {
+      entries_.clear();
+    }
+    entries_.emplace(key, stddev);
+    return stddev;
+  }
+
+  int64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+
+  int64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+  using Key = std::tuple<double, double, double>;
+
+  GaussianStddevCache() = default;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<Key, double> entries_ ABSL_GUARDED_BY(mutex_);
+  std::atomic<int64_t> hits_{0};
+  std::atomic<int64_t> misses_{0};
 };
 
+}  // namespace internal
+
 class GaussianMechanism : public NumericalMechanism {
  public:
+  // Counters of the lookups in the standard deviation calibration cache shared
+  // by all Gaussian mechanisms of the process. Repeated calls of a thread with
+  // the same parameters are answered by a per-thread memo without a lookup,
+  // and are not counted.
+  struct StddevCacheStats {
+    int64_t hits;
+    int64_t misses;
+  };
+
   class Builder : public NumericalMechanismBuilder {
    public:
     Builder& SetL2Sensitivity(double l2_sensitivity) {
@@ -377,6 +645,23 @@ class GaussianMechanism : public NumericalMechanism {
       return result;
     }
 
+    // Interns the mechanism by epsilon, delta and l2 sensitivity. Subclasses
+    // that build other mechanisms get a new mechanism for every call.
+    base::StatusOr<std::shared_ptr<NumericalMechanism>> BuildShared()
+        override {
+      if (typeid(*this) != typeid(Builder)) {
+        return NumericalMechanismBuilder::BuildShared();
+      }
+      ASSIGN_OR_RETURN(double epsilon,
+                       GetValueIfSetAndPositive(GetEpsilon(), "Epsilon"));
+      RETURN_IF_ERROR(DeltaIsSetAndValid());
+      ASSIGN_OR_RETURN(double l2, CalculateL2Sensitivity());
+      using Key = std::tuple<double, double, double>;
+      return internal::SharedMechanismCache<GaussianMechanism, Key>::Get()
+          .GetOrBuild(Key(epsilon, GetDelta().value(), l2),
+                      [this]() { return Builder::Build(); });
+    }
+
     std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
       return absl::make_unique<Builder>(*this);
     }
@@ -435,15 +720,38 @@ class GaussianMechanism : public NumericalMechanism {
   double AddNoise(double result, double privacy_budget) override {
     privacy_budget = CheckAndClampBudget(privacy_budget);
 
-    double local_epsilon = privacy_budget * GetEpsilon();
-    double local_delta = privacy_budget * delta_;
-    double stddev = CalculateStddev(local_epsilon, local_delta);
+    double stddev = CalibratedStddev(privacy_budget);
     double sample = distro_->Sample(stddev);
 
     return RoundToNearestMultiple(result, distro_->GetGranularity(stddev)) +
            sample;
   }
 
+  // Same as calling AddNoise on every value, but calibrates the standard
+  // deviation only once and samples the noise in batches.
+  void AddNoiseBatch(absl::Span<const double> in, absl::Span<double> out,
+                     double privacy_budget) override {
+    DCHECK_EQ(in.size(), out.size());
+    privacy_budget = CheckAndClampBudget(privacy_budget);
+
+    const double stddev = CalibratedStddev(privacy_budget);
+    const double granularity = distro_->GetGranularity(stddev);
+    double samples[kNoiseBatchSize];
+    for (size_t start = 0; start < in.size(); start += kNoiseBatchSize) {
+      size_t batch_size = std::min(kNoiseBatchSize, in.size() - start);
+      distro_->SampleBatch(absl::Span<double>(samples, batch_size), stddev);
+      for (size_t i = 0; i < batch_size; ++i) {
+        out[start + i] =
+            RoundToNearestMultiple(in[start + i], granularity) + samples[i];
+      }
+    }
+  }
+
+  double GetGranularity(double privacy_budget) override {
+    privacy_budget = CheckAndClampBudget(privacy_budget);
+    return distro_->GetGranularity(CalibratedStddev(privacy_budget));
+  }
+
   virtual int64_t MemoryUsed() {
     int64_t memory = sizeof(GaussianMechanism);
     if (distro_) {
@@ -468,9 +776,7 @@ class GaussianMechanism : public NumericalMechanism {
     RETURN_IF_ERROR(CheckConfidenceLevel(confidence_level));
     RETURN_IF_ERROR(CheckPrivacyBudget(privacy_budget));
 
-    double local_epsilon = privacy_budget * GetEpsilon();
-    double local_delta = privacy_budget * delta_;
-    double stddev = CalculateStddev(local_epsilon, local_delta);
+    double stddev = CalibratedStddev(privacy_budget);
 
     ConfidenceInterval confidence;
     // calculated using the symmetric properties of the Gaussian distribution
@@ -525,11 +831,46 @@ class GaussianMechanism : public NumericalMechanism {
 
   double GetL2Sensitivity() const { return l2_sensitivity_; }
 
+  static StddevCacheStats GetStddevCacheStats() {
+    internal::GaussianStddevCache& cache = internal::GaussianStddevCache::Get();
+    return {cache.hits(), cache.misses()};
+  }
+
  private:
   double delta_;
   double l2_sensitivity_;
   std::unique_ptr<internal::GaussianDistribution> distro_;
 
+  // The parameters of the last standard deviation calibrated by the thread and
+  // the standard deviation, so that repeated calls with the same parameters
+  // skip the shared cache lookup. It is kept per thread rather than per
+  // mechanism, because mechanisms are shared between threads.
+  struct LastStddev {
+    double epsilon = std::numeric_limits<double>::quiet_NaN();
+    double delta = 0;
+    double l2_sensitivity = 0;
+    double stddev = 0;
+  };
+
+  // Returns CalculateStddev() for the local epsilon and delta of the privacy
+  // budget, using the shared calibration cache.
+  double CalibratedStddev(double privacy_budget) {
+    static thread_local LastStddev last;
+    double local_epsilon = privacy_budget * GetEpsilon();
+    double local_delta = privacy_budget * delta_;
+    if (local_epsilon == last.epsilon && local_delta == last.delta &&
+        l2_sensitivity_ == last.l2_sensitivity) {
+      return last.stddev;
+    }
+    last.stddev = internal::GaussianStddevCache::Get().GetOrCalculate(
+        local_epsilon, local_delta, l2_sensitivity_,
+        [&]() { return CalculateStddev(local_epsilon, local_delta); });
+    last.epsilon = local_epsilon;
+    last.delta = local_delta;
+    last.l2_sensitivity = l2_sensitivity_;
+    return last.stddev;
+  }
+
   double StandardNormalDistributionCDF(double x) {
     return (1 + std::erf(x / sqrt(2))) / 2;
   }
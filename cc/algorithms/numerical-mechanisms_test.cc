@@ -16,10 +16,13 @@
 
 #include "algorithms/numerical-mechanisms.h"
 
+#include <thread>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "base/statusor.h"
 #include "algorithms/distributions.h"
+#include "algorithms/numerical-mechanisms-testing.h"
 
 namespace differential_privacy {
 namespace {
@@ -206,6 +209,35 @@ TEST(NumericalMechanismsTest, LaplaceAddsNoNoiseWhenSensitivityIsZero) {
   EXPECT_THAT(mechanism.AddNoise(12.3), DoubleEq(12.3));
 }
 
+TEST(NumericalMechanismsTest, LaplaceAddNoiseBatchMatchesScalarStatistics) {
+  const int kNumSamples = 100000;
+  LaplaceMechanism mechanism(1.0, 1.0);
+  std::vector<double> in(kNumSamples, 5.0);
+  std::vector<double> out(kNumSamples);
+  mechanism.AddNoiseBatch(in, absl::MakeSpan(out), 0.5);
+
+  // Lap(2) noise has a variance of 8.
+  EXPECT_NEAR(Mean(out), 5.0, 0.1);
+  EXPECT_NEAR(Variance(out), 8.0, 0.4);
+}
+
+TEST(NumericalMechanismsTest, LaplaceAddNoiseBatchInPlace) {
+  LaplaceMechanism mechanism(1.0, 0.0);
+  std::vector<double> values = {1.5, -2.5, 12.3};
+  mechanism.AddNoiseBatch(values, absl::MakeSpan(values), 1.0);
+
+  EXPECT_THAT(values[0], DoubleEq(1.5));
+  EXPECT_THAT(values[1], DoubleEq(-2.5));
+  EXPECT_THAT(values[2], DoubleEq(12.3));
+}
+
+TEST(NumericalMechanismsTest, LaplaceAddNoiseBatchEmpty) {
+  LaplaceMechanism mechanism(1.0, 1.0);
+  std::vector<double> values;
+  mechanism.AddNoiseBatch(values, absl::MakeSpan(values), 1.0);
+  EXPECT_TRUE(values.empty());
+}
+
 TEST(NumericalMechanismsTest, LaplaceDiversityCorrect) {
   LaplaceMechanism mechanism(1.0, 1.0);
   EXPECT_EQ(mechanism.GetDiversity(), 1.0);
@@ -237,6 +269,68 @@ TEST(NumericalMechanismsTest, LaplaceWorksForIntegers) {
   EXPECT_EQ(static_cast<int64_t>(mechanism.AddNoise(0)), 10);
 }
 
+TEST(NumericalMechanismsTest, LaplaceAddInt64NoiseStatistics) {
+  const int kNumSamples = 100000;
+  LaplaceMechanism mechanism(1.0, 1.0);
+  std::vector<double> out(kNumSamples);
+  for (double& value : out) {
+    value = mechanism.AddInt64Noise(5, 0.5);
+  }
+
+  // Discrete laplace noise with ratio q = e^-0.5 has a variance of
+  // 2q / (1 - q)^2.
+  double q = std::exp(-0.5);
+  EXPECT_NEAR(Mean(out), 5.0, 0.1);
+  EXPECT_NEAR(Variance(out), 2 * q / std::pow(1 - q, 2), 0.4);
+}
+
+TEST(NumericalMechanismsTest, LaplaceAddInt64NoiseNoNoiseForZeroSensitivity) {
+  LaplaceMechanism mechanism(1.0, 0.0);
+  EXPECT_EQ(mechanism.AddInt64Noise(std::numeric_limits<int64_t>::max(), 1.0),
+            std::numeric_limits<int64_t>::max());
+  EXPECT_EQ(mechanism.AddInt64Noise(-12, 1.0), -12);
+}
+
+TEST(NumericalMechanismsTest, LaplaceAddInt64NoiseUsesGivenDistribution) {
+  std::seed_seq seed({1, 2, 3});
+  std::seed_seq seed2({1, 2, 3});
+  std::mt19937 gen(seed);
+  std::mt19937 gen2(seed2);
+  // Both mechanisms draw from distributions on equally seeded generators.
+  LaplaceMechanism integer(
+      1.0, 10.0,
+      absl::make_unique<test_utils::SeededLaplaceDistribution>(1.0, 10.0,
+                                                              &gen));
+  LaplaceMechanism rounded(
+      1.0, 10.0,
+      absl::make_unique<test_utils::SeededLaplaceDistribution>(1.0, 10.0,
+                                                              &gen2));
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(integer.AddInt64Noise(i, 1.0),
+              std::round(rounded.AddNoise(i, 1.0)));
+  }
+}
+
+TEST(NumericalMechanismsTest, LaplaceAddInt64NoiseSaturates) {
+  LaplaceMechanism mechanism(1.0, 1e6);
+  for (int i = 0; i < 100; ++i) {
+    int64_t noised = mechanism.AddInt64Noise(
+        std::numeric_limits<int64_t>::max() - 1, 1.0);
+    EXPECT_GE(noised, std::numeric_limits<int64_t>::max() - 1e8);
+  }
+}
+
+TEST(NumericalMechanismsTest, GaussianAddInt64NoiseRoundsAddNoise) {
+  GaussianMechanism mechanism(1.0, 0.5, 1.0);
+  const int kNumSamples = 10000;
+  std::vector<double> out(kNumSamples);
+  for (double& value : out) {
+    value = mechanism.AddInt64Noise(5, 1.0);
+    EXPECT_EQ(value, std::round(value));
+  }
+  EXPECT_NEAR(Mean(out), 5.0, 0.2);
+}
+
 TEST(NumericalMechanismsTest, LaplaceConfidenceInterval) {
   double epsilon = 0.5;
   double sensitivity = 1.0;
@@ -536,6 +630,18 @@ TEST(NumericalMechanismsTest, GaussianMechanismAddsNoise) {
   EXPECT_FALSE(std::isnan(mechanism.AddNoise(1.1, 2.0)));
 }
 
+TEST(NumericalMechanismsTest, GaussianAddNoiseBatchMatchesScalarStatistics) {
+  const int kNumSamples = 100000;
+  GaussianMechanism mechanism(1.0, 0.5, 1.0);
+  const double stddev = mechanism.CalculateStddev(0.5, 0.25);
+  std::vector<double> in(kNumSamples, -3.0);
+  std::vector<double> out(kNumSamples);
+  mechanism.AddNoiseBatch(in, absl::MakeSpan(out), 0.5);
+
+  EXPECT_NEAR(Mean(out), -3.0, 0.05);
+  EXPECT_NEAR(Variance(out), stddev * stddev, 0.05 * stddev * stddev);
+}
+
 TEST(NumericalMechanismsTest,
      GaussianMechanismAddsNoiseForHighEpsilonAndLowDelta) {
   auto test_mechanism = GaussianMechanism::Builder()
@@ -564,6 +670,103 @@ TEST(NumericalMechanismsTest, GaussianBuilderClone) {
       1.2);
 }
 
+TEST(NumericalMechanismsTest, GaussianStddevIsCachedAcrossMechanisms) {
+  // Parameters not used by any other test, so that the first call is a miss.
+  GaussianMechanism first(0.123, 0.0045, 6.7);
+  GaussianMechanism second(0.123, 0.0045, 6.7);
+  const double stddev = first.CalculateStddev(0.123 * 0.5, 0.0045 * 0.5);
+
+  GaussianMechanism::StddevCacheStats before =
+      GaussianMechanism::GetStddevCacheStats();
+  first.AddNoise(1.0, 0.5);
+  // The other thread looks up the shared cache once, then uses its own memo.
+  std::thread([&second]() {
+    second.AddNoise(1.0, 0.5);
+    second.AddNoise(1.0, 0.5);
+  }).join();
+  GaussianMechanism::StddevCacheStats after =
+      GaussianMechanism::GetStddevCacheStats();
+  EXPECT_EQ(after.misses - before.misses, 1);
+  EXPECT_EQ(after.hits - before.hits, 1);
+
+  ConfidenceInterval interval =
+      second.NoiseConfidenceInterval(0.95, 0.5).ValueOrDie();
+  EXPECT_NEAR(interval.upper_bound(), 1.959964 * stddev, 1e-3 * stddev);
+  EXPECT_EQ(GaussianMechanism::GetStddevCacheStats().misses, after.misses);
+}
+
+TEST(NumericalMechanismsTest, GaussianStddevCacheDistinguishesBudgets) {
+  GaussianMechanism mechanism(0.321, 0.0054, 7.6);
+  GaussianMechanism::StddevCacheStats before =
+      GaussianMechanism::GetStddevCacheStats();
+  mechanism.AddNoise(1.0, 0.25);
+  mechanism.AddNoise(1.0, 0.75);
+  mechanism.AddNoise(1.0, 0.25);
+  // Answered by the per-thread memo, without a lookup.
+  mechanism.AddNoise(1.0, 0.25);
+  GaussianMechanism::StddevCacheStats after =
+      GaussianMechanism::GetStddevCacheStats();
+  EXPECT_EQ(after.misses - before.misses, 2);
+  EXPECT_EQ(after.hits - before.hits, 1);
+}
+
+TEST(NumericalMechanismsTest, LaplaceBuildSharedInternsByParameters) {
+  std::shared_ptr<NumericalMechanism> first =
+      LaplaceMechanism::Builder()
+          .SetEpsilon(0.5)
+          .SetL0Sensitivity(2)
+          .SetLInfSensitivity(3)
+          .BuildShared()
+          .ValueOrDie();
+  // Same epsilon and l1 sensitivity.
+  std::shared_ptr<NumericalMechanism> second =
+      LaplaceMechanism::Builder()
+          .SetL1Sensitivity(6)
+          .SetEpsilon(0.5)
+          .BuildShared()
+          .ValueOrDie();
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(NumericalMechanism::MemoryUsedPerOwner(first),
+            first->MemoryUsed() / 2);
+
+  std::shared_ptr<NumericalMechanism> other_epsilon =
+      LaplaceMechanism::Builder()
+          .SetL1Sensitivity(6)
+          .SetEpsilon(0.25)
+          .BuildShared()
+          .ValueOrDie();
+  EXPECT_NE(other_epsilon, first);
+  LaplaceMechanism::Builder decomposition;
+  decomposition.SetGeometricSampler(internal::GeometricSampler::kDecomposition)
+      .SetL1Sensitivity(6)
+      .SetEpsilon(0.5);
+  EXPECT_NE(decomposition.BuildShared().ValueOrDie(), first);
+
+  EXPECT_FALSE(
+      LaplaceMechanism::Builder().SetEpsilon(-1).BuildShared().ok());
+}
+
+TEST(NumericalMechanismsTest, LaplaceBuildSharedDoesNotShareSubclasses) {
+  test_utils::ZeroNoiseMechanism::Builder builder;
+  builder.SetL1Sensitivity(1).SetEpsilon(1);
+  std::shared_ptr<NumericalMechanism> first =
+      builder.BuildShared().ValueOrDie();
+  EXPECT_NE(builder.BuildShared().ValueOrDie(), first);
+  EXPECT_EQ(first->AddNoise(1.5), 1.5);
+}
+
+TEST(NumericalMechanismsTest, GaussianBuildSharedInternsByParameters) {
+  GaussianMechanism::Builder builder;
+  builder.SetL2Sensitivity(2).SetEpsilon(1).SetDelta(1e-5);
+  std::shared_ptr<NumericalMechanism> first =
+      builder.BuildShared().ValueOrDie();
+  EXPECT_EQ(builder.BuildShared().ValueOrDie(), first);
+  builder.SetDelta(1e-6);
+  EXPECT_NE(builder.BuildShared().ValueOrDie(), first);
+  builder.SetDelta(2);
+  EXPECT_FALSE(builder.BuildShared().ok());
+}
+
 TEST(NumericalMechanismsTest, Stddev) {
   GaussianMechanism mechanism(log(3), 0.00001, 1.0);
 
@@ -17,11 +17,14 @@
 #ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_ORDER_STATISTICS_H_
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_ORDER_STATISTICS_H_
 
+#include <cmath>
+
 #include "base/percentile.h"
 #include "base/status.h"
 #include "algorithms/algorithm.h"
 #include "algorithms/binary-search.h"
 #include "algorithms/bounded-algorithm.h"
+#include "algorithms/input-sketch.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "base/status.h"
 
@@ -42,11 +45,29 @@ class OrderStatisticsBuilder
     BoundedBuilder::SetUpper(std::numeric_limits<T>::max());
   }
 
+  // Sketches the inputs into the given number of equal-width bins over the
+  // search range instead of storing all of them. Memory and summaries then
+  // have a fixed size, at the cost of only resolving values up to the width
+  // of a bin, which is reported in the error report of results. Only useful
+  // with search bounds that are close to the range of the inputs.
+  Builder& SetInputSketchBins(int num_bins) {
+    input_sketch_bins_ = num_bins;
+    return *static_cast<Builder*>(this);
+  }
+
+  // Ends the search early once the result is known up to the given absolute
+  // tolerance, instead of only when it cannot change anymore. Saves time at
+  // the cost of accuracy; the privacy guarantee is unaffected.
+  Builder& SetSearchTolerance(double tolerance) {
+    search_tolerance_ = tolerance;
+    return *static_cast<Builder*>(this);
+  }
+
  protected:
   // Check numeric parameters and construct quantiles and mechanism. Called
   // only at build.
   base::Status ConstructDependencies() {
-    std::unique_ptr<NumericalMechanism> has_to_be_laplace;
+    std::shared_ptr<NumericalMechanism> has_to_be_laplace;
     ASSIGN_OR_RETURN(
         has_to_be_laplace,
         AlgorithmBuilder::GetMechanismBuilderClone()
@@ -55,24 +76,42 @@ class OrderStatisticsBuilder
                 AlgorithmBuilder::GetMaxPartitionsContributed().value_or(1))
             .SetLInfSensitivity(
                 AlgorithmBuilder::GetMaxContributionsPerPartition().value_or(1))
-            .Build());
+            .BuildShared());
 
     // TODO: Remove the following dynamic_cast.
-    mechanism_ = absl::WrapUnique<LaplaceMechanism>(
-        dynamic_cast<LaplaceMechanism*>(has_to_be_laplace.release()));
+    mechanism_ = std::dynamic_pointer_cast<LaplaceMechanism>(
+        std::move(has_to_be_laplace));
 
     if (mechanism_ == nullptr) {
       return base::InvalidArgumentError(
           "Order statistics are only supported for Laplace mechanism.");
     }
 
-    quantiles_ = absl::make_unique<base::Percentile<T>>();
+    if (!input_sketch_bins_.has_value()) {
+      quantiles_ = absl::make_unique<ExactInputSketch<T>>();
+    } else if (input_sketch_bins_.value() < 1) {
+      return base::InvalidArgumentError(
+          "The input sketch must have one or more bins.");
+    } else {
+      quantiles_ = absl::make_unique<BinnedInputSketch<T>>(
+          BoundedBuilder::GetLower().value(),
+          BoundedBuilder::GetUpper().value(), input_sketch_bins_.value());
+    }
+
+    if (!std::isfinite(search_tolerance_) || search_tolerance_ < 0) {
+      return base::InvalidArgumentError(
+          "Search tolerance must be finite and non-negative.");
+    }
     return base::OkStatus();
   }
 
   // Constructed when processing parameters.
-  std::unique_ptr<LaplaceMechanism> mechanism_;
-  std::unique_ptr<base::Percentile<T>> quantiles_;
+  std::shared_ptr<LaplaceMechanism> mechanism_;
+  std::unique_ptr<InputSketch<T>> quantiles_;
+  double search_tolerance_ = 0;
+
+ private:
+  absl::optional<int> input_sketch_bins_;
 };
 
 template <typename T>
@@ -91,16 +130,19 @@ class Max : public BinarySearch<T> {
                                       BoundedBuilder::GetLower().value(),
                                       BoundedBuilder::GetUpper().value(),
                                       std::move(OrderBuilder::mechanism_),
-                                      std::move(OrderBuilder::quantiles_)));
+                                      std::move(OrderBuilder::quantiles_),
+                                      OrderBuilder::search_tolerance_));
     }
   };
 
  private:
   Max(double epsilon, T lower, T upper,
-      std::unique_ptr<LaplaceMechanism> mechanism,
-      std::unique_ptr<base::Percentile<T>> quantiles)
+      std::shared_ptr<LaplaceMechanism> mechanism,
+      std::unique_ptr<InputSketch<T>> quantiles,
+      double search_tolerance)
       : BinarySearch<T>(epsilon, lower, upper, /*quantile=*/1,
-                        std::move(mechanism), std::move(quantiles)) {}
+                        std::move(mechanism), std::move(quantiles),
+                        search_tolerance) {}
 };
 
 template <typename T>
@@ -119,16 +161,19 @@ class Min : public BinarySearch<T> {
                                       BoundedBuilder::GetLower().value(),
                                       BoundedBuilder::GetUpper().value(),
                                       std::move(OrderBuilder::mechanism_),
-                                      std::move(OrderBuilder::quantiles_)));
+                                      std::move(OrderBuilder::quantiles_),
+                                      OrderBuilder::search_tolerance_));
     }
   };
 
  private:
   Min(double epsilon, T lower, T upper,
-      std::unique_ptr<LaplaceMechanism> mechanism,
-      std::unique_ptr<base::Percentile<T>> quantiles)
+      std::shared_ptr<LaplaceMechanism> mechanism,
+      std::unique_ptr<InputSketch<T>> quantiles,
+      double search_tolerance)
       : BinarySearch<T>(epsilon, lower, upper, /*quantile=*/0,
-                        std::move(mechanism), std::move(quantiles)) {}
+                        std::move(mechanism), std::move(quantiles),
+                        search_tolerance) {}
 };
 
 template <typename T>
@@ -148,16 +193,19 @@ class Median : public BinarySearch<T> {
                                          BoundedBuilder::GetLower().value(),
                                          BoundedBuilder::GetUpper().value(),
                                          std::move(OrderBuilder::mechanism_),
-                                         std::move(OrderBuilder::quantiles_)));
+                                         std::move(OrderBuilder::quantiles_),
+                                         OrderBuilder::search_tolerance_));
     }
   };
 
  private:
   Median(double epsilon, T lower, T upper,
-         std::unique_ptr<LaplaceMechanism> mechanism,
-         std::unique_ptr<base::Percentile<T>> quantiles)
+         std::shared_ptr<LaplaceMechanism> mechanism,
+         std::unique_ptr<InputSketch<T>> quantiles,
+         double search_tolerance)
       : BinarySearch<T>(epsilon, lower, upper, /*quantile=*/0.5,
-                        std::move(mechanism), std::move(quantiles)) {}
+                        std::move(mechanism), std::move(quantiles),
+                        search_tolerance) {}
 };
 
 template <typename T>
@@ -188,7 +236,8 @@ class Percentile : public BinarySearch<T> {
                          BoundedBuilder::GetLower().value(),
                          BoundedBuilder::GetUpper().value(),
                          std::move(OrderBuilder::mechanism_),
-                         std::move(OrderBuilder::quantiles_)));
+                         std::move(OrderBuilder::quantiles_),
+                         OrderBuilder::search_tolerance_));
     }
 
     double percentile_;
@@ -198,10 +247,11 @@ class Percentile : public BinarySearch<T> {
 
  private:
   Percentile(double percentile, double epsilon, T lower, T upper,
-             std::unique_ptr<LaplaceMechanism> mechanism,
-             std::unique_ptr<base::Percentile<T>> quantiles)
+             std::shared_ptr<LaplaceMechanism> mechanism,
+             std::unique_ptr<InputSketch<T>> quantiles,
+             double search_tolerance)
       : BinarySearch<T>(epsilon, lower, upper, percentile, std::move(mechanism),
-                        std::move(quantiles)),
+                        std::move(quantiles), search_tolerance),
         percentile_(percentile) {}
 
   const double percentile_;
@@ -0,0 +1,72 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/random/random.h"
+#include "algorithms/order-statistics.h"
+
+namespace differential_privacy {
+namespace continuous {
+namespace {
+
+// Latency of a percentile result. The first argument is the number of inputs,
+// the second the privacy budget of the result in thousandths, and the third the
+// number of input sketch bins, or 0 to keep the exact inputs. The Bayesian
+// search spends the budget in iterations whose budget shrinks as the noisy
+// counts become certain, so the number of iterations grows with the number of
+// inputs and the budget. The inputs are restored from a summary outside of the
+// timing, since every result consumes the privacy budget.
+template <typename T>
+void BM_PercentileResult(benchmark::State& state) {
+  const int64_t num_inputs = state.range(0);
+  const double privacy_budget = state.range(1) / 1000.0;
+  const int num_bins = state.range(2);
+  typename Percentile<T>::Builder builder;
+  builder.SetPercentile(0.9).SetEpsilon(1.0).SetLower(0).SetUpper(1000);
+  if (num_bins > 0) {
+    builder.SetInputSketchBins(num_bins);
+  }
+  std::unique_ptr<Percentile<T>> percentile = builder.Build().ValueOrDie();
+  absl::BitGen gen;
+  for (int64_t i = 0; i < num_inputs; ++i) {
+    percentile->AddEntry(static_cast<T>(absl::Gaussian(gen, 500.0, 100.0)));
+  }
+  const Summary summary = percentile->Serialize();
+  for (auto _ : state) {
+    state.PauseTiming();
+    percentile->Reset();
+    percentile->Merge(summary);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(percentile->PartialResult(privacy_budget));
+  }
+}
+
+void PercentileArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"inputs", "budget_1e-3", "bins"})
+      ->ArgsProduct(
+          {{1 << 10, 1 << 16, 1 << 22}, {10, 100, 1000}, {0, 1 << 16}})
+      ->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_TEMPLATE(BM_PercentileResult, double)->Apply(PercentileArgs);
+BENCHMARK_TEMPLATE(BM_PercentileResult, int64_t)->Apply(PercentileArgs);
+
+}  // namespace
+}  // namespace continuous
+}  // namespace differential_privacy
@@ -131,6 +131,71 @@ TEST(OrderStatisticsTest, Percentile) {
   EXPECT_EQ(GetValue<int64_t>(search->PartialResult(1.0).ValueOrDie()), 90);
 }
 
+TEST(OrderStatisticsTest, MedianFromBinnedInputs) {
+  double epsilon = std::log(3);
+  int64_t lower = 0, upper = 2048;
+  std::unique_ptr<Median<int64_t>> search =
+      typename Median<int64_t>::Builder()
+          .SetInputSketchBins(1024)
+          .SetEpsilon(epsilon)
+          .SetLower(lower)
+          .SetUpper(upper)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .ValueOrDie();
+  for (int64_t i = 0; i < kDataSize; ++i) {
+    search->AddEntry(std::round(static_cast<double>(200) * i / kDataSize));
+  }
+  Output output = search->PartialResult(1.0).ValueOrDie();
+  EXPECT_NEAR(GetValue<int64_t>(output), 100, 2);
+  EXPECT_EQ(output.error_report().input_sketch_resolution(), 2);
+}
+
+TEST(OrderStatisticsTest, BinnedInputsUseFixedMemory) {
+  std::unique_ptr<Median<double>> search = typename Median<double>::Builder()
+                                               .SetInputSketchBins(100)
+                                               .SetEpsilon(1)
+                                               .SetLower(-10)
+                                               .SetUpper(10)
+                                               .Build()
+                                               .ValueOrDie();
+  search->AddEntry(1);
+  int64_t memory = search->MemoryUsed();
+  for (int i = 0; i < kDataSize; ++i) {
+    search->AddEntry(i % 20 - 10);
+  }
+  EXPECT_EQ(search->MemoryUsed(), memory);
+}
+
+TEST(OrderStatisticsTest, SerializeMergeBinnedInputs) {
+  typename Median<double>::Builder builder;
+  builder.SetInputSketchBins(64)
+      .SetEpsilon(1)
+      .SetLower(0)
+      .SetUpper(64)
+      .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>());
+  std::unique_ptr<Median<double>> all = builder.Build().ValueOrDie();
+  std::unique_ptr<Median<double>> first = builder.Build().ValueOrDie();
+  std::unique_ptr<Median<double>> second = builder.Build().ValueOrDie();
+  for (int i = 0; i < 1000; ++i) {
+    all->AddEntry(i % 50);
+    (i < 300 ? first : second)->AddEntry(i % 50);
+  }
+  Summary summary = first->Serialize();
+  EXPECT_LT(summary.data().ByteSizeLong(), 1000);
+  EXPECT_TRUE(second->Merge(summary).ok());
+  EXPECT_EQ(GetValue<double>(second->PartialResult().ValueOrDie()),
+            GetValue<double>(all->PartialResult().ValueOrDie()));
+
+  // Binned inputs only merge with the same bins.
+  std::unique_ptr<Median<double>> other_bins =
+      builder.SetInputSketchBins(32).Build().ValueOrDie();
+  EXPECT_FALSE(other_bins->Merge(summary).ok());
+  std::unique_ptr<Median<double>> exact =
+      typename Median<double>::Builder().Build().ValueOrDie();
+  EXPECT_FALSE(exact->Merge(summary).ok());
+}
+
 TEST(OrderStatisticsTest, PercentileGetter) {
   double epsilon = std::log(3), expectedPercentile = 0.9;
   int64_t lower = 0, upper = 2048;
@@ -155,6 +220,14 @@ TEST(OrderStatisticsTest, InvalidParameters) {
   EXPECT_FALSE(builder.SetLower(3).Build().ok());
   EXPECT_FALSE(builder.SetLower(1).SetPercentile(-1).Build().ok());
   EXPECT_FALSE(builder.SetPercentile(2).Build().ok());
+  EXPECT_FALSE(
+      builder.SetPercentile(.9).SetInputSketchBins(0).Build().ok());
+  EXPECT_FALSE(builder.SetInputSketchBins(1)
+                   .SetSearchTolerance(-1)
+                   .Build()
+                   .ok());
+  EXPECT_FALSE(builder.SetSearchTolerance(std::nan("")).Build().ok());
+  EXPECT_TRUE(builder.SetSearchTolerance(0.5).Build().ok());
 }
 
 TEST(OrderStatisticsTest, Median_DefaultBounds) {
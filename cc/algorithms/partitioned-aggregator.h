@@ -0,0 +1,355 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_PARTITIONED_AGGREGATOR_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_PARTITIONED_AGGREGATOR_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "base/status.h"
+#include "base/statusor.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/partition-selection.h"
+#include "algorithms/rand.h"
+#include "proto/data.pb.h"
+#include "base/canonical_errors.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Computes a differentially private aggregate for every partition of a dataset
+// of (privacy unit, partition key, value) rows, e.g., a DP sum of purchases
+// per product, where the privacy unit is the user who made the purchase.
+//
+// Aggregate() runs in two passes over the rows, each split into shards that
+// are processed on separate threads:
+//   1. Rows are sharded by privacy unit. Contributions are bounded: each
+//      privacy unit keeps a uniformly random sample of at most
+//      max_partitions_contributed of its partitions, and in each of them a
+//      uniformly random sample of at most max_contributions_per_partition of
+//      its rows.
+//   2. The remaining rows are sharded by partition key. Partition selection
+//      decides from the number of privacy units in each partition whether to
+//      keep it. Only the kept partitions then feed their rows to an algorithm
+//      from the algorithm factory and release its result, so the cost of
+//      building algorithms scales with the kept partitions, not the
+//      candidates.
+//
+// The algorithms must be built with the same contribution bounds as the
+// aggregator, since they calibrate their noise to them, and the partition
+// selection must be built with the same max_partitions_contributed. The
+// privacy guarantee is that of the algorithms and the partition selection
+// combined, e.g., the sum of their epsilons.
+//
+// All rows are kept in memory until Aggregate() is called.
+template <typename T, typename PartitionKey = std::string>
+class PartitionedAggregator {
+ public:
+  // Returns a new, empty algorithm for a partition. Called concurrently from
+  // the threads of Aggregate(), so it must be thread-safe, e.g., by calling
+  // CloneEmpty() of a prototype algorithm, or by using a new algorithm builder
+  // for every call.
+  using AlgorithmFactory =
+      std::function<base::StatusOr<std::unique_ptr<Algorithm<T>>>()>;
+
+  struct Options {
+    // Maximum number of partitions a privacy unit contributes to.
+    int max_partitions_contributed = 1;
+    // Maximum number of rows a privacy unit contributes to a partition.
+    int max_contributions_per_partition = 1;
+    // Number of shards, each of which is processed on its own thread.
+    int num_threads = 1;
+  };
+
+  struct Row {
+    int64_t privacy_unit_id;
+    PartitionKey partition_key;
+    T value;
+  };
+
+  struct PartitionResult {
+    PartitionKey partition_key;
+    Output output;
+  };
+
+  // Creates an aggregator that uses algorithms from algorithm_factory and
+  // partition selection strategies from partition_selection, which is built
+  // once per thread.
+  static base::StatusOr<std::unique_ptr<PartitionedAggregator>> Create(
+      AlgorithmFactory algorithm_factory,
+      PartitionSelectionStrategy::Builder* partition_selection,
+      const Options& options) {
+    if (!algorithm_factory) {
+      return base::InvalidArgumentError("Algorithm factory has to be set.");
+    }
+    if (partition_selection == nullptr) {
+      return base::InvalidArgumentError("Partition selection has to be set.");
+    }
+    if (options.max_partitions_contributed <= 0) {
+      return base::InvalidArgumentError(absl::StrCat(
+          "Max number of partitions a privacy unit can contribute to has to "
+          "be positive but is ",
+          options.max_partitions_contributed));
+    }
+    if (options.max_contributions_per_partition <= 0) {
+      return base::InvalidArgumentError(absl::StrCat(
+          "Max number of contributions per partition has to be positive but "
+          "is ",
+          options.max_contributions_per_partition));
+    }
+    if (options.num_threads <= 0) {
+      return base::InvalidArgumentError(absl::StrCat(
+          "Number of threads has to be positive but is ", options.num_threads));
+    }
+
+    std::vector<std::unique_ptr<PartitionSelectionStrategy>> selections;
+    for (int i = 0; i < options.num_threads; ++i) {
+      std::unique_ptr<PartitionSelectionStrategy> selection;
+      ASSIGN_OR_RETURN(selection, partition_selection->Build());
+      if (selection->GetMaxPartitionsContributed() !=
+          options.max_partitions_contributed) {
+        return base::InvalidArgumentError(
+            "Partition selection has to be built with the same max number of "
+            "partitions contributed as the aggregator.");
+      }
+      selections.push_back(std::move(selection));
+    }
+    return absl::WrapUnique(new PartitionedAggregator(
+        std::move(algorithm_factory), std::move(selections), options));
+  }
+
+  PartitionedAggregator(const PartitionedAggregator&) = delete;
+  PartitionedAggregator& operator=(const PartitionedAggregator&) = delete;
+
+  void AddRow(int64_t privacy_unit_id, PartitionKey partition_key,
+              const T& value) {
+    rows_[PrivacyUnitShard(privacy_unit_id)].push_back(
+        {privacy_unit_id, std::move(partition_key), value});
+  }
+
+  void AddRows(absl::Span<const Row> rows) {
+    for (const Row& row : rows) {
+      rows_[PrivacyUnitShard(row.privacy_unit_id)].push_back(row);
+    }
+  }
+
+  // Bounds contributions, selects partitions and returns the results of the
+  // kept partitions, in no particular order. Consumes all rows added so far.
+  base::StatusOr<std::vector<PartitionResult>> Aggregate() {
+    const int num_shards = rows_.size();
+
+    // bounded_rows[i][j] holds the rows that shard i of the privacy units
+    // keeps for shard j of the partitions.
+    std::vector<std::vector<std::vector<BoundedRow>>> bounded_rows(
+        num_shards, std::vector<std::vector<BoundedRow>>(num_shards));
+    ForEachShard([this, &bounded_rows](int shard) {
+      BoundContributions(&rows_[shard], &bounded_rows[shard]);
+    });
+
+    std::vector<base::Status> statuses(num_shards);
+    std::vector<std::vector<PartitionResult>> results(num_shards);
+    ForEachShard([this, &bounded_rows, &statuses, &results](int shard) {
+      statuses[shard] =
+          AggregatePartitions(shard, &bounded_rows, &results[shard]);
+    });
+    for (const base::Status& status : statuses) {
+      RETURN_IF_ERROR(status);
+    }
+
+    std::vector<PartitionResult> all_results = std::move(results[0]);
+    for (int shard = 1; shard < num_shards; ++shard) {
+      std::move(results[shard].begin(), results[shard].end(),
+                std::back_inserter(all_results));
+    }
+    return all_results;
+  }
+
+  // Returns the memory used by the rows that have not been aggregated yet, not
+  // counting memory that partition keys allocate themselves.
+  int64_t MemoryUsed() {
+    int64_t memory = sizeof(PartitionedAggregator);
+    for (const std::vector<Row>& rows : rows_) {
+      memory += sizeof(std::vector<Row>) + sizeof(Row) * rows.capacity();
+    }
+    return memory;
+  }
+
+ private:
+  // A row that remains after bounding contributions.
+  struct BoundedRow {
+    PartitionKey partition_key;
+    T value;
+    // Whether this is the first row of its privacy unit in the partition.
+    bool first_of_privacy_unit;
+  };
+
+  PartitionedAggregator(
+      AlgorithmFactory algorithm_factory,
+      std::vector<std::unique_ptr<PartitionSelectionStrategy>> selections,
+      const Options& options)
+      : algorithm_factory_(std::move(algorithm_factory)),
+        selections_(std::move(selections)),
+        options_(options),
+        rows_(options.num_threads) {}
+
+  int PrivacyUnitShard(int64_t privacy_unit_id) const {
+    return absl::Hash<int64_t>()(privacy_unit_id) % rows_.size();
+  }
+
+  int PartitionShard(const PartitionKey& partition_key) const {
+    return absl::Hash<PartitionKey>()(partition_key) % rows_.size();
+  }
+
+  // Runs fn for every shard, each on its own thread.
+  void ForEachShard(const std::function<void(int)>& fn) {
+    std::vector<std::thread> threads;
+    for (int shard = 1; shard < rows_.size(); ++shard) {
+      threads.emplace_back(fn, shard);
+    }
+    fn(0);
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+
+  // Samples the contributions of every privacy unit in rows, which are
+  // consumed, and appends the sampled rows to the shard of their partition in
+  // bounded_rows.
+  void BoundContributions(std::vector<Row>* rows,
+                          std::vector<std::vector<BoundedRow>>* bounded_rows) {
+    SecureURBG& random = SecureURBG::GetThreadLocal();
+    // Shuffle before the stable sort so that the rows of a privacy unit in a
+    // partition are in random order, and the first ones are a uniform sample.
+    std::shuffle(rows->begin(), rows->end(), random);
+    std::stable_sort(rows->begin(), rows->end(),
+                     [](const Row& a, const Row& b) {
+                       return std::tie(a.privacy_unit_id, a.partition_key) <
+                              std::tie(b.privacy_unit_id, b.partition_key);
+                     });
+
+    // Index of the first row of each partition of the current privacy unit.
+    std::vector<size_t> partition_begins;
+    size_t unit_begin = 0;
+    while (unit_begin < rows->size()) {
+      const int64_t privacy_unit_id = (*rows)[unit_begin].privacy_unit_id;
+      size_t unit_end = unit_begin;
+      partition_begins.clear();
+      for (; unit_end < rows->size() &&
+             (*rows)[unit_end].privacy_unit_id == privacy_unit_id;
+           ++unit_end) {
+        if (unit_end == unit_begin || (*rows)[unit_end].partition_key !=
+                                          (*rows)[unit_end - 1].partition_key) {
+          partition_begins.push_back(unit_end);
+        }
+      }
+
+      if (partition_begins.size() > options_.max_partitions_contributed) {
+        std::shuffle(partition_begins.begin(), partition_begins.end(), random);
+        partition_begins.resize(options_.max_partitions_contributed);
+      }
+      for (size_t begin : partition_begins) {
+        const PartitionKey& partition_key = (*rows)[begin].partition_key;
+        std::vector<BoundedRow>& shard_rows =
+            (*bounded_rows)[PartitionShard(partition_key)];
+        const size_t end = std::min<size_t>(
+            unit_end, begin + options_.max_contributions_per_partition);
+        for (size_t i = begin;
+             i < end && (*rows)[i].partition_key == partition_key; ++i) {
+          shard_rows.push_back({(*rows)[i].partition_key, (*rows)[i].value,
+                                /*first_of_privacy_unit=*/i == begin});
+        }
+      }
+      unit_begin = unit_end;
+    }
+
+    // Release the memory of the consumed rows.
+    std::vector<Row>().swap(*rows);
+  }
+
+  // Aggregates the bounded rows of the given shard of the partitions, which
+  // are consumed, and appends the results of the kept partitions to results.
+  //
+  // Partition selection only needs the number of privacy units in each
+  // partition, so the partitions are selected in a first pass over the rows,
+  // and algorithms are only built and fed for the kept partitions in a second
+  // pass. Most candidate partitions are usually dropped, so this saves
+  // building their algorithms, which is far more expensive than counting.
+  base::Status AggregatePartitions(
+      int shard,
+      std::vector<std::vector<std::vector<BoundedRow>>>* bounded_rows,
+      std::vector<PartitionResult>* results) {
+    absl::flat_hash_map<PartitionKey, int> num_privacy_units;
+    for (const std::vector<std::vector<BoundedRow>>& source_rows :
+         *bounded_rows) {
+      for (const BoundedRow& row : source_rows[shard]) {
+        if (row.first_of_privacy_unit) {
+          ++num_privacy_units[row.partition_key];
+        }
+      }
+    }
+
+    absl::flat_hash_map<PartitionKey, std::unique_ptr<Algorithm<T>>> kept;
+    PartitionSelectionStrategy* selection = selections_[shard].get();
+    for (const auto& partition : num_privacy_units) {
+      if (selection->ShouldKeep(partition.second)) {
+        ASSIGN_OR_RETURN(kept[partition.first], algorithm_factory_());
+      }
+    }
+    absl::flat_hash_map<PartitionKey, int>().swap(num_privacy_units);
+
+    for (std::vector<std::vector<BoundedRow>>& source_rows : *bounded_rows) {
+      for (const BoundedRow& row : source_rows[shard]) {
+        auto partition = kept.find(row.partition_key);
+        if (partition != kept.end()) {
+          partition->second->AddEntry(row.value);
+        }
+      }
+      std::vector<BoundedRow>().swap(source_rows[shard]);
+    }
+
+    for (auto& partition : kept) {
+      Output output;
+      ASSIGN_OR_RETURN(output, partition.second->PartialResult());
+      results->push_back({partition.first, std::move(output)});
+    }
+    return base::OkStatus();
+  }
+
+  const AlgorithmFactory algorithm_factory_;
+  // One partition selection strategy per shard of the partitions.
+  std::vector<std::unique_ptr<PartitionSelectionStrategy>> selections_;
+  const Options options_;
+
+  // Rows added since the last Aggregate(), sharded by privacy unit.
+  std::vector<std::vector<Row>> rows_;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_PARTITIONED_AGGREGATOR_H_
@@ -0,0 +1,94 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/random/random.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/partition-selection.h"
+#include "algorithms/partitioned-aggregator.h"
+
+namespace differential_privacy {
+namespace {
+
+using Aggregator = PartitionedAggregator<double, int64_t>;
+
+constexpr int kMaxPartitionsContributed = 4;
+constexpr int kMaxContributionsPerPartition = 2;
+// Average number of rows of a privacy unit.
+constexpr int64_t kRowsPerPrivacyUnit = 8;
+
+base::StatusOr<std::unique_ptr<Algorithm<double>>> MakeSum() {
+  return BoundedSum<double>::Builder()
+      .SetEpsilon(1)
+      .SetLower(0)
+      .SetUpper(10)
+      .SetMaxPartitionsContributed(kMaxPartitionsContributed)
+      .SetMaxContributionsPerPartition(kMaxContributionsPerPartition)
+      .Build();
+}
+
+// Arguments are the number of rows, the number of partitions and the number of
+// threads. Rows are added outside of the timed region, so the benchmark times
+// contribution bounding, per-partition sums and partition selection.
+void BM_Aggregate(benchmark::State& state) {
+  const int64_t num_rows = state.range(0);
+  const int64_t num_partitions = state.range(1);
+  const int64_t num_privacy_units = num_rows / kRowsPerPrivacyUnit;
+
+  PreaggPartitionSelection::Builder selection;
+  selection.SetEpsilon(1).SetDelta(1e-5).SetMaxPartitionsContributed(
+      kMaxPartitionsContributed);
+  Aggregator::Options options;
+  options.max_partitions_contributed = kMaxPartitionsContributed;
+  options.max_contributions_per_partition = kMaxContributionsPerPartition;
+  options.num_threads = state.range(2);
+
+  absl::BitGen gen;
+  int64_t num_kept = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::unique_ptr<Aggregator> aggregator =
+        Aggregator::Create(&MakeSum, &selection, options).ValueOrDie();
+    for (int64_t i = 0; i < num_rows; ++i) {
+      aggregator->AddRow(absl::Uniform<int64_t>(gen, 0, num_privacy_units),
+                         absl::Uniform<int64_t>(gen, 0, num_partitions),
+                         absl::Uniform(gen, 0.0, 10.0));
+    }
+    state.ResumeTiming();
+
+    num_kept = aggregator->Aggregate().ValueOrDie().size();
+  }
+  state.SetItemsProcessed(state.iterations() * num_rows);
+  state.counters["kept_partitions"] = num_kept;
+}
+BENCHMARK(BM_Aggregate)
+    ->ArgNames({"rows", "partitions", "threads"})
+    ->Args({1 << 20, 1 << 10, 1})
+    ->Args({1 << 20, 1 << 16, 1})
+    ->Args({10000000, 1000000, 1})
+    ->Args({10000000, 1000000, 4})
+    ->Args({100000000, 1000000, 1})
+    ->Args({100000000, 1000000, 8})
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace differential_privacy
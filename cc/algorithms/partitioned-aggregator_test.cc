@@ -0,0 +1,259 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/partitioned-aggregator.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/partition-selection.h"
+
+namespace differential_privacy {
+namespace {
+
+using test_utils::ZeroNoiseMechanism;
+using ::testing::ElementsAre;
+using ::testing::Pair;
+
+// Keeps the partitions with at least a given number of privacy units.
+class ThresholdSelection : public PartitionSelectionStrategy {
+ public:
+  class Builder : public PartitionSelectionStrategy::Builder {
+   public:
+    explicit Builder(int min_privacy_units)
+        : min_privacy_units_(min_privacy_units) {}
+
+    base::StatusOr<std::unique_ptr<PartitionSelectionStrategy>> Build()
+        override {
+      return std::unique_ptr<PartitionSelectionStrategy>(new ThresholdSelection(
+          min_privacy_units_, GetMaxPartitionsContributed().value_or(1)));
+    }
+
+   private:
+    int min_privacy_units_;
+  };
+
+  bool ShouldKeep(int num_users) override {
+    return num_users >= min_privacy_units_;
+  }
+
+ private:
+  ThresholdSelection(int min_privacy_units, int max_partitions_contributed)
+      : PartitionSelectionStrategy(1, 1e-5, max_partitions_contributed),
+        min_privacy_units_(min_privacy_units) {}
+
+  int min_privacy_units_;
+};
+
+using Aggregator = PartitionedAggregator<int64_t>;
+
+base::StatusOr<std::unique_ptr<Algorithm<int64_t>>> ExactCount() {
+  return Count<int64_t>::Builder()
+      .SetEpsilon(1)
+      .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build();
+}
+
+std::unique_ptr<Aggregator> MakeAggregator(int min_privacy_units,
+                                           const Aggregator::Options& options) {
+  ThresholdSelection::Builder selection(min_privacy_units);
+  selection.SetMaxPartitionsContributed(options.max_partitions_contributed);
+  return Aggregator::Create(&ExactCount, &selection, options).ValueOrDie();
+}
+
+// Returns the counts of the kept partitions by partition key.
+std::map<std::string, int64_t> Counts(Aggregator* aggregator) {
+  std::map<std::string, int64_t> counts;
+  std::vector<Aggregator::PartitionResult> results =
+      aggregator->Aggregate().ValueOrDie();
+  for (const Aggregator::PartitionResult& result : results) {
+    counts[result.partition_key] = GetValue<int64_t>(result.output);
+  }
+  return counts;
+}
+
+TEST(PartitionedAggregatorTest, CountsPerPartition) {
+  Aggregator::Options options;
+  options.max_partitions_contributed = 2;
+  std::unique_ptr<Aggregator> aggregator = MakeAggregator(1, options);
+  aggregator->AddRow(1, "a", 0);
+  aggregator->AddRow(1, "b", 0);
+  aggregator->AddRow(2, "a", 0);
+  aggregator->AddRows({{3, "a", 0}, {3, "c", 0}});
+  EXPECT_THAT(Counts(aggregator.get()),
+              ElementsAre(Pair("a", 3), Pair("b", 1), Pair("c", 1)));
+}
+
+TEST(PartitionedAggregatorTest, BoundsContributionsPerPartition) {
+  Aggregator::Options options;
+  options.max_contributions_per_partition = 2;
+  std::unique_ptr<Aggregator> aggregator = MakeAggregator(1, options);
+  for (int64_t privacy_unit = 0; privacy_unit < 10; ++privacy_unit) {
+    for (int i = 0; i < 5; ++i) {
+      aggregator->AddRow(privacy_unit, "a", i);
+    }
+  }
+  EXPECT_THAT(Counts(aggregator.get()), ElementsAre(Pair("a", 20)));
+}
+
+TEST(PartitionedAggregatorTest, BoundsPartitionsContributed) {
+  Aggregator::Options options;
+  options.max_partitions_contributed = 3;
+  std::unique_ptr<Aggregator> aggregator = MakeAggregator(1, options);
+  for (int64_t privacy_unit = 0; privacy_unit < 100; ++privacy_unit) {
+    for (int partition = 0; partition < 10; ++partition) {
+      aggregator->AddRow(privacy_unit, absl::StrCat(partition), 0);
+    }
+  }
+  int64_t total = 0;
+  for (const auto& count : Counts(aggregator.get())) {
+    EXPECT_LE(count.second, 100);
+    total += count.second;
+  }
+  EXPECT_EQ(total, 300);
+}
+
+TEST(PartitionedAggregatorTest, SamplesPartitionsUniformly) {
+  Aggregator::Options options;
+  std::unique_ptr<Aggregator> aggregator = MakeAggregator(1, options);
+  for (int64_t privacy_unit = 0; privacy_unit < 10000; ++privacy_unit) {
+    aggregator->AddRow(privacy_unit, "a", 0);
+    aggregator->AddRow(privacy_unit, "b", 0);
+  }
+  std::map<std::string, int64_t> counts = Counts(aggregator.get());
+  EXPECT_NEAR(counts["a"], 5000, 300);
+  EXPECT_EQ(counts["a"] + counts["b"], 10000);
+}
+
+TEST(PartitionedAggregatorTest, DropsPartitionsThatSelectionRejects) {
+  Aggregator::Options options;
+  options.max_contributions_per_partition = 5;
+  std::unique_ptr<Aggregator> aggregator = MakeAggregator(3, options);
+  for (int64_t privacy_unit = 0; privacy_unit < 3; ++privacy_unit) {
+    aggregator->AddRow(privacy_unit, "kept", 0);
+  }
+  // The selection counts privacy units, not rows.
+  for (int i = 0; i < 5; ++i) {
+    aggregator->AddRow(3, "dropped", 0);
+  }
+  EXPECT_THAT(Counts(aggregator.get()), ElementsAre(Pair("kept", 3)));
+}
+
+TEST(PartitionedAggregatorTest, BuildsAlgorithmsOnlyForKeptPartitions) {
+  int num_algorithms = 0;
+  ThresholdSelection::Builder selection(3);
+  selection.SetMaxPartitionsContributed(1);
+  std::unique_ptr<Aggregator> aggregator =
+      Aggregator::Create(
+          [&num_algorithms]() {
+            ++num_algorithms;
+            return ExactCount();
+          },
+          &selection, Aggregator::Options())
+          .ValueOrDie();
+  for (int64_t privacy_unit = 0; privacy_unit < 3; ++privacy_unit) {
+    aggregator->AddRow(privacy_unit, "kept", 0);
+  }
+  for (int64_t privacy_unit = 3; privacy_unit < 103; ++privacy_unit) {
+    aggregator->AddRow(privacy_unit, absl::StrCat(privacy_unit), 0);
+  }
+  EXPECT_THAT(Counts(aggregator.get()), ElementsAre(Pair("kept", 3)));
+  EXPECT_EQ(num_algorithms, 1);
+}
+
+TEST(PartitionedAggregatorTest, ShardsMatchSingleThread) {
+  Aggregator::Options options;
+  options.max_partitions_contributed = 10;
+  options.max_contributions_per_partition = 3;
+  std::unique_ptr<Aggregator> single = MakeAggregator(2, options);
+  options.num_threads = 4;
+  std::unique_ptr<Aggregator> sharded = MakeAggregator(2, options);
+  for (int64_t privacy_unit = 0; privacy_unit < 1000; ++privacy_unit) {
+    for (int i = 0; i < privacy_unit % 7; ++i) {
+      std::string partition = absl::StrCat(privacy_unit % (i + 5));
+      single->AddRow(privacy_unit, partition, i);
+      sharded->AddRow(privacy_unit, partition, i);
+    }
+  }
+  std::map<std::string, int64_t> counts = Counts(single.get());
+  EXPECT_FALSE(counts.empty());
+  EXPECT_EQ(Counts(sharded.get()), counts);
+}
+
+TEST(PartitionedAggregatorTest, AggregateConsumesRows) {
+  Aggregator::Options options;
+  std::unique_ptr<Aggregator> aggregator = MakeAggregator(1, options);
+  aggregator->AddRow(1, "a", 0);
+  int64_t memory = aggregator->MemoryUsed();
+  EXPECT_THAT(Counts(aggregator.get()), ElementsAre(Pair("a", 1)));
+  EXPECT_LT(aggregator->MemoryUsed(), memory);
+  EXPECT_TRUE(Counts(aggregator.get()).empty());
+}
+
+TEST(PartitionedAggregatorTest, ReturnsAlgorithmErrors) {
+  ThresholdSelection::Builder selection(1);
+  selection.SetMaxPartitionsContributed(1);
+  std::unique_ptr<Aggregator> aggregator =
+      Aggregator::Create(
+          []() -> base::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+            return base::InvalidArgumentError("Bad algorithm.");
+          },
+          &selection, Aggregator::Options())
+          .ValueOrDie();
+  aggregator->AddRow(1, "a", 0);
+  EXPECT_FALSE(aggregator->Aggregate().ok());
+}
+
+TEST(PartitionedAggregatorTest, InvalidOptions) {
+  ThresholdSelection::Builder selection(1);
+  selection.SetMaxPartitionsContributed(1);
+  Aggregator::Options options;
+  EXPECT_TRUE(Aggregator::Create(&ExactCount, &selection, options).ok());
+  EXPECT_FALSE(Aggregator::Create(nullptr, &selection, options).ok());
+  EXPECT_FALSE(Aggregator::Create(&ExactCount, nullptr, options).ok());
+
+  options.max_partitions_contributed = 2;
+  EXPECT_FALSE(Aggregator::Create(&ExactCount, &selection, options).ok());
+  selection.SetMaxPartitionsContributed(2);
+  EXPECT_TRUE(Aggregator::Create(&ExactCount, &selection, options).ok());
+
+  for (int invalid : {0, -1}) {
+    Aggregator::Options invalid_options = options;
+    invalid_options.max_partitions_contributed = invalid;
+    EXPECT_FALSE(
+        Aggregator::Create(&ExactCount, &selection, invalid_options).ok());
+    invalid_options = options;
+    invalid_options.max_contributions_per_partition = invalid;
+    EXPECT_FALSE(
+        Aggregator::Create(&ExactCount, &selection, invalid_options).ok());
+    invalid_options = options;
+    invalid_options.num_threads = invalid;
+    EXPECT_FALSE(
+        Aggregator::Create(&ExactCount, &selection, invalid_options).ok());
+  }
+}
+
+}  // namespace
+}  // namespace differential_privacy
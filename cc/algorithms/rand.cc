@@ -16,16 +16,29 @@
 
 #include "algorithms/rand.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
 #include <cstdint>
+#include <atomic>
 #include <cstring>
+#include <deque>
 #include <limits>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
 
 #include "base/logging.h"
+#include "absl/base/const_init.h"
 #include "absl/synchronization/mutex.h"
+#include "openssl/crypto.h"
+#include "openssl/evp.h"
 #include "openssl/rand.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 namespace differential_privacy {
 namespace {
 // From absl/base/internal/bits.h.
@@ -47,10 +60,255 @@ static_assert(sizeof(double) == sizeof(uint64_t) &&
               "double representation is not IEEE 754 binary64.");
 const constexpr int kMantDigits = DBL_MANT_DIG - 1;
 const constexpr uint64_t kMantissaMask = (uint64_t{1} << kMantDigits) - 1ULL;
+
+// Incremented in the child process after every fork(). A SecureURBG whose
+// buffer was filled in an older generation must not hand out any of the
+// remaining bytes, since the parent process holds a copy of them.
+std::atomic<uint64_t> fork_generation{0};
+
+void IncrementForkGeneration() {
+  fork_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RegisterForkHandler() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+#ifndef _WIN32
+    pthread_atfork(/*prepare=*/nullptr, /*parent=*/nullptr,
+                   /*child=*/&IncrementForkGeneration);
+#endif
+  });
+}
+
+uint64_t ForkGeneration() {
+  return fork_generation.load(std::memory_order_relaxed);
+}
+
+// Incremented by SetEntropySourceFactory() so that SecureURBG instances notice
+// that they need to replace their entropy source.
+std::atomic<uint64_t> entropy_source_generation{0};
+
+ABSL_CONST_INIT absl::Mutex entropy_source_factory_mutex(absl::kConstInit);
+SecureURBG::EntropySourceFactory* entropy_source_factory
+    ABSL_GUARDED_BY(entropy_source_factory_mutex) = nullptr;
+
+std::unique_ptr<EntropySource> NewEntropySource() {
+  absl::MutexLock lock(&entropy_source_factory_mutex);
+  if (entropy_source_factory != nullptr) {
+    return (*entropy_source_factory)();
+  }
+  return std::make_unique<RandBytesEntropySource>();
+}
+
+// Replaces source with a new one from the current factory if it has not been
+// created yet or the factory changed since.
+void UpdateEntropySource(std::unique_ptr<EntropySource>& source,
+                         uint64_t& source_generation) {
+  uint64_t generation =
+      entropy_source_generation.load(std::memory_order_acquire);
+  if (source == nullptr || source_generation != generation) {
+    source = NewEntropySource();
+    source_generation = generation;
+  }
+}
+
+std::atomic<bool> async_refill_enabled{false};
+
+#ifdef DIFFERENTIAL_PRIVACY_DETERMINISTIC_RNG_FOR_TESTING
+// The URBG returned by SecureURBG::GetThreadLocal() while a
+// ScopedDeterministicRandomnessForTesting is alive on this thread.
+thread_local SecureURBG* deterministic_urbg = nullptr;
+
+// Counter-based PRNG: the i-th output word is the SplitMix64 finalizer applied
+// to seed + i * golden ratio. Fast and reproducible, but not secure.
+class CounterEntropySource : public EntropySource {
+ public:
+  explicit CounterEntropySource(uint64_t seed) : seed_(seed) {}
+
+  void Fill(uint8_t* buffer, size_t size) override {
+    for (size_t offset = 0; offset < size; offset += sizeof(uint64_t)) {
+      uint64_t z = seed_ + (++counter_) * 0x9e3779b97f4a7c15;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      z ^= z >> 31;
+      std::memcpy(buffer + offset, &z,
+                  std::min(sizeof(uint64_t), size - offset));
+    }
+  }
+
+ private:
+  const uint64_t seed_;
+  uint64_t counter_ = 0;
+};
+#endif
+
+// States of SecureURBG::standby_state_.
+constexpr int kStandbyEmpty = 0;
+constexpr int kStandbyPending = 1;
+constexpr int kStandbyReady = 2;
+
+// Background thread that fills the standby buffers of SecureURBG instances
+// with async refills enabled. It has its own entropy source, so it never
+// shares one with the instance whose buffer it fills.
+class BufferRefiller {
+ public:
+  // Returns the refiller of the current process and starts its thread on
+  // first use. The refiller of a parent process is leaked in a forked child,
+  // since its thread does not exist there.
+  static BufferRefiller* Get() {
+    static std::atomic<BufferRefiller*> instance{nullptr};
+    BufferRefiller* refiller = instance.load(std::memory_order_acquire);
+    if (refiller != nullptr && refiller->fork_generation_ == ForkGeneration()) {
+      return refiller;
+    }
+    ABSL_CONST_INIT static absl::Mutex mutex(absl::kConstInit);
+    absl::MutexLock lock(&mutex);
+    refiller = instance.load(std::memory_order_acquire);
+    if (refiller == nullptr || refiller->fork_generation_ != ForkGeneration()) {
+      refiller = new BufferRefiller();
+      instance.store(refiller, std::memory_order_release);
+    }
+    return refiller;
+  }
+
+  // Fills size bytes of buffer and then sets *state to kStandbyReady.
+  void Schedule(uint8_t* buffer, size_t size, std::atomic<int>* state) {
+    absl::MutexLock lock(&mutex_);
+    queue_.push_back({buffer, size, state});
+  }
+
+  // Drops a scheduled refill of the buffer belonging to state, or waits for
+  // it to finish if it is already in progress.
+  void Cancel(std::atomic<int>* state) {
+    absl::MutexLock lock(&mutex_);
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(),
+                                [state](const Request& request) {
+                                  return request.state == state;
+                                }),
+                 queue_.end());
+    auto not_in_flight = [this, state]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(
+                             mutex_) { return in_flight_ != state; };
+    mutex_.Await(absl::Condition(&not_in_flight));
+  }
+
+ private:
+  struct Request {
+    uint8_t* buffer;
+    size_t size;
+    std::atomic<int>* state;
+  };
+
+  BufferRefiller() : fork_generation_(ForkGeneration()) {
+    std::thread([this]() { Run(); }).detach();
+  }
+
+  void Run() {
+    std::unique_ptr<EntropySource> source;
+    uint64_t source_generation = 0;
+    while (true) {
+      Request request;
+      {
+        absl::MutexLock lock(&mutex_);
+        auto has_request = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+          return !queue_.empty();
+        };
+        mutex_.Await(absl::Condition(&has_request));
+        request = queue_.front();
+        queue_.pop_front();
+        in_flight_ = request.state;
+      }
+      UpdateEntropySource(source, source_generation);
+      source->Fill(request.buffer, request.size);
+      request.state->store(kStandbyReady, std::memory_order_release);
+      absl::MutexLock lock(&mutex_);
+      in_flight_ = nullptr;
+    }
+  }
+
+  const uint64_t fork_generation_;
+  absl::Mutex mutex_;
+  std::deque<Request> queue_ ABSL_GUARDED_BY(mutex_);
+  std::atomic<int>* in_flight_ ABSL_GUARDED_BY(mutex_) = nullptr;
+};
 }  // namespace
 
+void RandBytesEntropySource::Fill(uint8_t* buffer, size_t size) {
+  CHECK_EQ(RAND_bytes(buffer, size), 1);
+}
+
+AesCtrDrbgEntropySource::AesCtrDrbgEntropySource(uint64_t reseed_interval)
+    : reseed_interval_(reseed_interval),
+      fork_generation_(ForkGeneration()),
+      ctx_(EVP_CIPHER_CTX_new()) {
+  CHECK(ctx_ != nullptr);
+  RegisterForkHandler();
+  Reseed();
+}
+
+AesCtrDrbgEntropySource::~AesCtrDrbgEntropySource() {
+  EVP_CIPHER_CTX_free(ctx_);
+}
+
+void AesCtrDrbgEntropySource::Fill(uint8_t* buffer, size_t size) {
+  if (bytes_since_reseed_ >= reseed_interval_ ||
+      ABSL_PREDICT_FALSE(fork_generation_ != ForkGeneration())) {
+    Reseed();
+  }
+  Keystream(buffer, size);
+  bytes_since_reseed_ += size;
+
+  // Replace the key and counter so that the state does not reveal the output
+  // produced so far.
+  uint8_t next_seed[kSeedSize];
+  Keystream(next_seed, kSeedSize);
+  SetKeyAndCounter(next_seed);
+  OPENSSL_cleanse(next_seed, kSeedSize);
+}
+
+void AesCtrDrbgEntropySource::Reseed() {
+  uint8_t seed[kSeedSize];
+  CHECK_EQ(RAND_bytes(seed, kSeedSize), 1);
+  SetKeyAndCounter(seed);
+  OPENSSL_cleanse(seed, kSeedSize);
+  bytes_since_reseed_ = 0;
+  fork_generation_ = ForkGeneration();
+  ++reseed_count_;
+}
+
+void AesCtrDrbgEntropySource::SetKeyAndCounter(const uint8_t* seed) {
+  CHECK_EQ(EVP_EncryptInit_ex(ctx_, EVP_aes_256_ctr(), /*impl=*/nullptr,
+                              /*key=*/seed, /*iv=*/seed + 32),
+           1);
+}
+
+void AesCtrDrbgEntropySource::Keystream(uint8_t* buffer, size_t size) {
+  // Encrypting zeros in CTR mode yields the raw keystream.
+  std::memset(buffer, 0, size);
+  constexpr size_t kMaxChunk = std::numeric_limits<int>::max() & ~size_t{15};
+  while (size > 0) {
+    int chunk = static_cast<int>(std::min(size, kMaxChunk));
+    int written = 0;
+    CHECK_EQ(EVP_EncryptUpdate(ctx_, buffer, &written, buffer, chunk), 1);
+    CHECK_EQ(written, chunk);
+    buffer += chunk;
+    size -= chunk;
+  }
+}
+
+void SecureURBG::SetEntropySourceFactory(EntropySourceFactory factory) {
+  absl::MutexLock lock(&entropy_source_factory_mutex);
+  delete entropy_source_factory;
+  entropy_source_factory =
+      factory ? new EntropySourceFactory(std::move(factory)) : nullptr;
+  entropy_source_generation.fetch_add(1, std::memory_order_release);
+}
+
+void SecureURBG::SetAsyncRefill(bool enabled) {
+  async_refill_enabled.store(enabled, std::memory_order_relaxed);
+}
+
 double UniformDouble() {
-  uint64_t uint_64_number = SecureURBG::GetSingleton()();
+  uint64_t uint_64_number = SecureURBG::GetThreadLocal()();
   // A random integer of Uniform[0, 2^kMantDigits).
   uint64_t i = uint_64_number & kMantissaMask;
 
@@ -83,15 +341,68 @@ uint64_t Geometric() {
   uint64_t result = 1;
   uint64_t r = 0;
   while (r == 0 && result < 1023) {
-    r = SecureURBG::GetSingleton()();
+    r = SecureURBG::GetThreadLocal()();
     result += CountLeadingZeros64Slow(r);
   }
   return result;
 }
 
+SecureURBG::SecureURBG(bool synchronized)
+    : synchronized_(synchronized),
+      fork_generation_(ForkGeneration()),
+      buffer_(new uint8_t[kBufferSize]),
+      entropy_source_generation_(0),
+      entropy_source_fixed_(false) {
+  RegisterForkHandler();
+}
+
+SecureURBG::SecureURBG(bool synchronized,
+                       std::unique_ptr<EntropySource> entropy_source)
+    : synchronized_(synchronized),
+      fork_generation_(ForkGeneration()),
+      buffer_(new uint8_t[kBufferSize]),
+      entropy_source_(std::move(entropy_source)),
+      entropy_source_generation_(0),
+      entropy_source_fixed_(true) {
+  RegisterForkHandler();
+}
+
+ABSL_NO_THREAD_SAFETY_ANALYSIS
+SecureURBG::~SecureURBG() {
+  // A refill scheduled in this process may still write to the standby buffer.
+  // Refills scheduled before a fork() never run in the child.
+  if (standby_state_.load(std::memory_order_acquire) == kStandbyPending &&
+      standby_fork_generation_ == ForkGeneration()) {
+    BufferRefiller::Get()->Cancel(&standby_state_);
+  }
+  delete[] standby_buffer_;
+  delete[] buffer_;
+}
+
+SecureURBG& SecureURBG::GetThreadLocal() {
+#ifdef DIFFERENTIAL_PRIVACY_DETERMINISTIC_RNG_FOR_TESTING
+  if (deterministic_urbg != nullptr) {
+    return *deterministic_urbg;
+  }
+#endif
+  static thread_local SecureURBG instance(/*synchronized=*/false);
+  return instance;
+}
+
+// Thread-local instances are only accessed by their owning thread, so they
+// skip the mutex.
+ABSL_NO_THREAD_SAFETY_ANALYSIS
 SecureURBG::result_type SecureURBG::operator()() {
+  if (!synchronized_) {
+    return Next();
+  }
   absl::WriterMutexLock lock(&mutex_);
-  if (current_index_ + sizeof(result_type) > kBufferSize) {
+  return Next();
+}
+
+SecureURBG::result_type SecureURBG::Next() {
+  if (current_index_ + sizeof(result_type) > kBufferSize ||
+      ABSL_PREDICT_FALSE(fork_generation_ != ForkGeneration())) {
     RefreshBuffer();
   }
   int old_index = current_index_;
@@ -102,7 +413,66 @@ SecureURBG::result_type SecureURBG::operator()() {
 }
 
 void SecureURBG::RefreshBuffer() {
-  RAND_bytes(buffer_, kBufferSize);
+  bool async = !entropy_source_fixed_ &&
+               async_refill_enabled.load(std::memory_order_relaxed);
+  if (!async || !SwapInStandbyBuffer()) {
+    if (!entropy_source_fixed_) {
+      UpdateEntropySource(entropy_source_, entropy_source_generation_);
+    }
+    entropy_source_->Fill(buffer_, kBufferSize);
+  }
   current_index_ = 0;
+  fork_generation_ = ForkGeneration();
+  if (async) {
+    ScheduleStandbyRefill();
+  }
+}
+
+bool SecureURBG::SwapInStandbyBuffer() {
+  if (standby_fork_generation_ != ForkGeneration()) {
+    // The standby buffer was filled, or is being filled, by the parent
+    // process. Its bytes must not be used in the child, and no thread of the
+    // child will complete the refill.
+    standby_state_.store(kStandbyEmpty, std::memory_order_relaxed);
+    return false;
+  }
+  if (standby_state_.load(std::memory_order_acquire) != kStandbyReady) {
+    return false;
+  }
+  std::swap(buffer_, standby_buffer_);
+  standby_state_.store(kStandbyEmpty, std::memory_order_relaxed);
+  return true;
+}
+
+void SecureURBG::ScheduleStandbyRefill() {
+  if (standby_state_.load(std::memory_order_acquire) != kStandbyEmpty) {
+    return;
+  }
+  if (standby_buffer_ == nullptr) {
+    standby_buffer_ = new uint8_t[kBufferSize];
+  }
+  standby_state_.store(kStandbyPending, std::memory_order_relaxed);
+  standby_fork_generation_ = ForkGeneration();
+  BufferRefiller::Get()->Schedule(standby_buffer_, kBufferSize,
+                                  &standby_state_);
+}
+
+#ifdef DIFFERENTIAL_PRIVACY_DETERMINISTIC_RNG_FOR_TESTING
+ScopedDeterministicRandomnessForTesting::
+    ScopedDeterministicRandomnessForTesting(uint64_t seed)
+    : urbg_(new SecureURBG(/*synchronized=*/false,
+                           std::make_unique<CounterEntropySource>(seed))),
+      previous_(deterministic_urbg) {
+  deterministic_urbg = urbg_;
+}
+
+ScopedDeterministicRandomnessForTesting::
+    ~ScopedDeterministicRandomnessForTesting() {
+  CHECK(deterministic_urbg == urbg_)
+      << "Deterministic randomness scopes must be destroyed in reverse order "
+         "on the thread that created them.";
+  deterministic_urbg = previous_;
+  delete urbg_;
 }
+#endif
 }  // namespace differential_privacy
@@ -17,13 +17,17 @@
 #ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_RAND_H_
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_RAND_H_
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <limits>
 #include <memory>
 
-#include <cstdint>
 #include "absl/synchronization/mutex.h"
 
+struct evp_cipher_ctx_st;
+
 namespace differential_privacy {
 
 // Generates a double-valued random number of Uniform[0, 1). This has the same
@@ -35,13 +39,107 @@ double UniformDouble();
 // parameter 0.5. Will not exceed 1025.
 uint64_t Geometric();
 
+// Source of cryptographically secure random bytes from which SecureURBG fills
+// its buffer. Implementations do not need to be thread-safe, since every
+// SecureURBG owns its own instance.
+class EntropySource {
+ public:
+  virtual ~EntropySource() = default;
+
+  // Fills buffer with size random bytes.
+  virtual void Fill(uint8_t* buffer, size_t size) = 0;
+};
+
+// Reads every byte from OpenSSL's RAND_bytes. This is the default source.
+class RandBytesEntropySource : public EntropySource {
+ public:
+  void Fill(uint8_t* buffer, size_t size) override;
+};
+
+// Deterministic random bit generator that expands a 384 bit seed from
+// RAND_bytes into an AES-256-CTR keystream, which is considerably cheaper than
+// calling RAND_bytes for every buffer. OpenSSL uses AES-NI when the CPU
+// supports it and falls back to its software implementation otherwise.
+//
+// After every Fill() the key and counter are replaced by fresh keystream, so a
+// compromised state does not reveal earlier output. A new seed is drawn from
+// RAND_bytes once reseed_interval bytes have been produced, and after fork().
+class AesCtrDrbgEntropySource : public EntropySource {
+ public:
+  static constexpr uint64_t kDefaultReseedInterval = uint64_t{1} << 24;
+
+  explicit AesCtrDrbgEntropySource(
+      uint64_t reseed_interval = kDefaultReseedInterval);
+  ~AesCtrDrbgEntropySource() override;
+
+  AesCtrDrbgEntropySource(const AesCtrDrbgEntropySource&) = delete;
+  AesCtrDrbgEntropySource& operator=(const AesCtrDrbgEntropySource&) = delete;
+
+  void Fill(uint8_t* buffer, size_t size) override;
+
+  // Number of times a seed has been drawn from RAND_bytes, including the
+  // initial one.
+  int64_t ReseedCount() const { return reseed_count_; }
+
+ private:
+  // Draws a new seed from RAND_bytes.
+  void Reseed();
+  // Uses the first 32 bytes of seed as key and the last 16 as initial counter.
+  void SetKeyAndCounter(const uint8_t* seed);
+  // Writes size bytes of keystream to buffer.
+  void Keystream(uint8_t* buffer, size_t size);
+
+  static constexpr int kSeedSize = 48;
+
+  const uint64_t reseed_interval_;
+  uint64_t bytes_since_reseed_ = 0;
+  uint64_t fork_generation_;
+  int64_t reseed_count_ = 0;
+  evp_cipher_ctx_st* ctx_;
+};
+
 // Exposed for testing
+//
+// SecureURBG hands out 64 bit words read from a buffer of cryptographically
+// secure random bytes. It comes in two modes:
+//   - GetSingleton() returns one process-wide instance whose draws are
+//     serialized on a mutex.
+//   - GetThreadLocal() returns an instance owned by the calling thread. Every
+//     thread refills its own buffer, so draws never take a lock. This is the
+//     instance the noise generating functions of this library use.
+// Both modes are fork-safe: bytes buffered before a fork() are discarded in the
+// child, so the parent and the child never reuse the same noise.
+//
+// The buffer is filled from an EntropySource, which is RAND_bytes unless a
+// different factory is installed with SetEntropySourceFactory().
+//
+// By default the caller that exhausts the buffer refills it synchronously,
+// which makes every 8192nd draw much slower than the others. With
+// SetAsyncRefill(true) every instance keeps a standby buffer that a shared
+// background thread refills as soon as the active buffer has been swapped in.
+// An exhausted buffer is then replaced by swapping pointers. The caller only
+// falls back to a synchronous refill when the standby buffer is not ready yet.
 class SecureURBG {
  public:
+  using EntropySourceFactory = std::function<std::unique_ptr<EntropySource>()>;
+
+  // Sets the factory that creates the entropy source of every SecureURBG
+  // instance. Existing instances switch to a new source at their next buffer
+  // refresh. Passing nullptr restores the RAND_bytes default.
+  static void SetEntropySourceFactory(EntropySourceFactory factory);
+
+  // Enables or disables double buffering with background refills for all
+  // SecureURBG instances. Takes effect at the next buffer refresh of each
+  // instance. Disabled by default.
+  static void SetAsyncRefill(bool enabled);
+
   static SecureURBG& GetSingleton() {
-    static auto* kInstance = new SecureURBG;
+    static auto* kInstance = new SecureURBG(/*synchronized=*/true);
     return *kInstance;
   }
+
+  static SecureURBG& GetThreadLocal();
+
   using result_type = uint64_t;
   static constexpr result_type(min)() {
     return (std::numeric_limits<result_type>::min)();
@@ -52,17 +150,79 @@ class SecureURBG {
   result_type operator()() ABSL_LOCKS_EXCLUDED(mutex_);
 
  private:
-  SecureURBG() { buffer_ = new uint8_t[kBufferSize]; }
-  ~SecureURBG() { delete[] buffer_; }
+#ifdef DIFFERENTIAL_PRIVACY_DETERMINISTIC_RNG_FOR_TESTING
+  friend class ScopedDeterministicRandomnessForTesting;
+#endif
+
+  explicit SecureURBG(bool synchronized);
+  // Creates an instance that always fills its buffer from entropy_source,
+  // regardless of SetEntropySourceFactory() and SetAsyncRefill().
+  SecureURBG(bool synchronized, std::unique_ptr<EntropySource> entropy_source);
+  ~SecureURBG();
+
+  // Returns the next word of the buffer, refreshing it if needed.
+  result_type Next() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   // Refesh the cache with new random bytes.
   void RefreshBuffer() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Swaps in the standby buffer if the background thread has filled it in
+  // the current process. Returns false if it is not ready.
+  bool SwapInStandbyBuffer() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Hands the standby buffer to the background thread for refilling.
+  void ScheduleStandbyRefill() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   static constexpr int kBufferSize = 65536;
+  // Whether draws have to be serialized on mutex_. False for thread-local
+  // instances, which are only ever accessed by their owning thread.
+  const bool synchronized_;
   // The corrent index in the cache.
   int current_index_ ABSL_GUARDED_BY(mutex_) = kBufferSize;
+  // The fork generation at which the buffer was last refreshed. See
+  // ForkGeneration() in rand.cc.
+  uint64_t fork_generation_ ABSL_GUARDED_BY(mutex_);
   uint8_t* buffer_ ABSL_GUARDED_BY(mutex_);
+  std::unique_ptr<EntropySource> entropy_source_ ABSL_GUARDED_BY(mutex_);
+  // The value of the factory generation when entropy_source_ was created. See
+  // SetEntropySourceFactory().
+  uint64_t entropy_source_generation_ ABSL_GUARDED_BY(mutex_);
+  // Whether entropy_source_ was passed to the constructor and must be kept.
+  const bool entropy_source_fixed_;
+  // The standby buffer used when async refills are enabled, allocated on first
+  // use. While standby_state_ is kStandbyPending it is owned by the background
+  // thread.
+  uint8_t* standby_buffer_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  // One of the kStandby* states in rand.cc.
+  std::atomic<int> standby_state_{0};
+  // The fork generation in which the standby refill was scheduled.
+  uint64_t standby_fork_generation_ ABSL_GUARDED_BY(mutex_) = 0;
   absl::Mutex mutex_;
 };
+
+#ifdef DIFFERENTIAL_PRIVACY_DETERMINISTIC_RNG_FOR_TESTING
+// FOR TESTS AND BENCHMARKS ONLY. THE NOISE IS PREDICTABLE AND PROVIDES NO
+// PRIVACY.
+//
+// Only available when the library is built with
+// --define dp_deterministic_rng_for_testing=1. While an instance is alive,
+// SecureURBG::GetThreadLocal() on the creating thread returns a URBG backed by
+// a counter-based PRNG seeded with seed, so UniformDouble(), Geometric() and
+// the noise distributions produce the same stream on every run. Scopes nest;
+// the innermost one wins. Must be destroyed on the thread that created it.
+class ScopedDeterministicRandomnessForTesting {
+ public:
+  explicit ScopedDeterministicRandomnessForTesting(uint64_t seed);
+  ~ScopedDeterministicRandomnessForTesting();
+
+  ScopedDeterministicRandomnessForTesting(
+      const ScopedDeterministicRandomnessForTesting&) = delete;
+  ScopedDeterministicRandomnessForTesting& operator=(
+      const ScopedDeterministicRandomnessForTesting&) = delete;
+
+ private:
+  SecureURBG* urbg_;
+  SecureURBG* previous_;
+};
+#endif
+
 }  // namespace differential_privacy
 
 #endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_RAND_H_
@@ -0,0 +1,154 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "algorithms/distributions.h"
+#include "algorithms/rand.h"
+
+namespace differential_privacy {
+namespace {
+
+// Number of draws per benchmark iteration. Reported throughput is in draws per
+// second of wall time, summed over all threads.
+constexpr int64_t kDrawsPerIteration = 1000;
+
+int MaxThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void BM_SecureURBGSingleton(benchmark::State& state) {
+  SecureURBG& urbg = SecureURBG::GetSingleton();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < kDrawsPerIteration; ++i) {
+      benchmark::DoNotOptimize(urbg());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kDrawsPerIteration);
+}
+BENCHMARK(BM_SecureURBGSingleton)->ThreadRange(1, MaxThreads())->UseRealTime();
+
+void BM_SecureURBGThreadLocal(benchmark::State& state) {
+  SecureURBG& urbg = SecureURBG::GetThreadLocal();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < kDrawsPerIteration; ++i) {
+      benchmark::DoNotOptimize(urbg());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kDrawsPerIteration);
+}
+BENCHMARK(BM_SecureURBGThreadLocal)
+    ->ThreadRange(1, MaxThreads())
+    ->UseRealTime();
+
+// Compares the throughput of the entropy sources when filling one SecureURBG
+// buffer at a time.
+void BM_EntropySourceFill(benchmark::State& state,
+                          std::unique_ptr<EntropySource> source) {
+  constexpr size_t kFillSize = 65536;
+  std::vector<uint8_t> buffer(kFillSize);
+  for (auto _ : state) {
+    source->Fill(buffer.data(), buffer.size());
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kFillSize);
+}
+BENCHMARK_CAPTURE(BM_EntropySourceFill, RandBytes,
+                  std::make_unique<RandBytesEntropySource>());
+BENCHMARK_CAPTURE(BM_EntropySourceFill, AesCtrDrbg,
+                  std::make_unique<AesCtrDrbgEntropySource>());
+
+void BM_SecureURBGThreadLocalAesCtrDrbg(benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    SecureURBG::SetEntropySourceFactory(
+        []() { return std::make_unique<AesCtrDrbgEntropySource>(); });
+  }
+  SecureURBG& urbg = SecureURBG::GetThreadLocal();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < kDrawsPerIteration; ++i) {
+      benchmark::DoNotOptimize(urbg());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kDrawsPerIteration);
+  if (state.thread_index() == 0) {
+    SecureURBG::SetEntropySourceFactory(nullptr);
+  }
+}
+BENCHMARK(BM_SecureURBGThreadLocalAesCtrDrbg)
+    ->ThreadRange(1, MaxThreads())
+    ->UseRealTime();
+
+// Records the latency of every single draw from the thread-local URBG and
+// reports its percentiles. Argument 0 refills synchronously, 1 uses the
+// background refill. A buffer lasts 8192 draws, so the synchronous refill
+// shows up at the p9999 and max of the per draw latency.
+void BM_SecureURBGDrawLatency(benchmark::State& state) {
+  SecureURBG::SetAsyncRefill(state.range(0) != 0);
+  SecureURBG& urbg = SecureURBG::GetThreadLocal();
+  std::vector<int64_t> latencies;
+  latencies.reserve(state.max_iterations);
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    benchmark::DoNotOptimize(urbg());
+    auto end = std::chrono::steady_clock::now();
+    latencies.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count());
+  }
+  SecureURBG::SetAsyncRefill(false);
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return static_cast<double>(
+        latencies[static_cast<size_t>(p * (latencies.size() - 1))]);
+  };
+  state.counters["p50_ns"] = percentile(0.5);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["p999_ns"] = percentile(0.999);
+  state.counters["p9999_ns"] = percentile(0.9999);
+  state.counters["max_ns"] = percentile(1.0);
+}
+BENCHMARK(BM_SecureURBGDrawLatency)
+    ->ArgName("async")
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(1 << 22);
+
+void BM_LaplaceSample(benchmark::State& state) {
+  internal::LaplaceDistribution dist(1.0, 1.0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dist.Sample());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LaplaceSample)->ThreadRange(1, MaxThreads())->UseRealTime();
+
+void BM_GaussianSample(benchmark::State& state) {
+  internal::GaussianDistribution dist(1.0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dist.Sample());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GaussianSample)->ThreadRange(1, MaxThreads())->UseRealTime();
+
+}  // namespace
+}  // namespace differential_privacy
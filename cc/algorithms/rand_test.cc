@@ -16,11 +16,20 @@
 
 #include "algorithms/rand.h"
 
+#include <atomic>
+#include <memory>
 #include <numeric>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 namespace differential_privacy {
 namespace {
 const int sample_size = 1000000;
@@ -62,5 +71,260 @@ TEST_F(RandTest, Geometric) {
   RunTest(Geometric, /*expected_mean=*/2, /*expected_var=*/2);
 }
 
+TEST(SecureURBGTest, ThreadLocalInstanceIsPerThread) {
+  SecureURBG* main_instance = &SecureURBG::GetThreadLocal();
+  EXPECT_EQ(main_instance, &SecureURBG::GetThreadLocal());
+
+  SecureURBG* other_instance = nullptr;
+  std::thread thread(
+      [&other_instance]() { other_instance = &SecureURBG::GetThreadLocal(); });
+  thread.join();
+  EXPECT_NE(main_instance, other_instance);
+  EXPECT_NE(main_instance, &SecureURBG::GetSingleton());
+}
+
+TEST(SecureURBGTest, ConcurrentThreadLocalDrawsAreUniform) {
+  constexpr int kNumThreads = 8;
+  constexpr int kDrawsPerThread = 100000;
+  std::vector<double> means(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&means, t]() {
+      double sum = 0;
+      for (int i = 0; i < kDrawsPerThread; ++i) {
+        sum += UniformDouble();
+      }
+      means[t] = sum / kDrawsPerThread;
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (double mean : means) {
+    EXPECT_NEAR(mean, 0.5, tolerance);
+  }
+}
+
+TEST(AesCtrDrbgEntropySourceTest, OutputBytesAreUniform) {
+  constexpr int kNumBytes = 1 << 20;
+  AesCtrDrbgEntropySource source;
+  std::vector<uint8_t> bytes(kNumBytes);
+  source.Fill(bytes.data(), bytes.size());
+  std::vector<int> counts(256, 0);
+  for (uint8_t byte : bytes) {
+    ++counts[byte];
+  }
+  // Each count is Binomial(2^20, 1/256) with a standard deviation of 64.
+  for (int count : counts) {
+    EXPECT_NEAR(count, kNumBytes / 256, 6 * 64);
+  }
+}
+
+TEST(AesCtrDrbgEntropySourceTest, InstancesAndFillsDiffer) {
+  AesCtrDrbgEntropySource first;
+  AesCtrDrbgEntropySource second;
+  std::vector<uint8_t> first_bytes(64), second_bytes(64), third_bytes(64);
+  first.Fill(first_bytes.data(), first_bytes.size());
+  second.Fill(second_bytes.data(), second_bytes.size());
+  first.Fill(third_bytes.data(), third_bytes.size());
+  EXPECT_NE(first_bytes, second_bytes);
+  EXPECT_NE(first_bytes, third_bytes);
+}
+
+TEST(AesCtrDrbgEntropySourceTest, ReseedsAfterInterval) {
+  constexpr int kFillSize = 1 << 16;
+  AesCtrDrbgEntropySource source(/*reseed_interval=*/2 * kFillSize);
+  EXPECT_EQ(source.ReseedCount(), 1);
+  std::vector<uint8_t> bytes(kFillSize);
+  for (int i = 0; i < 5; ++i) {
+    source.Fill(bytes.data(), bytes.size());
+  }
+  EXPECT_EQ(source.ReseedCount(), 3);
+}
+
+TEST(SecureURBGTest, UsesInstalledEntropySource) {
+  std::atomic<int> num_sources{0};
+  SecureURBG::SetEntropySourceFactory([&num_sources]() {
+    ++num_sources;
+    return std::make_unique<AesCtrDrbgEntropySource>();
+  });
+  double sum = 0;
+  constexpr int kNumDraws = 100000;
+  std::thread thread([&sum]() {
+    for (int i = 0; i < kNumDraws; ++i) {
+      sum += UniformDouble();
+    }
+  });
+  thread.join();
+  SecureURBG::SetEntropySourceFactory(nullptr);
+
+  EXPECT_EQ(num_sources, 1);
+  EXPECT_NEAR(sum / kNumDraws, 0.5, tolerance);
+}
+
+TEST(SecureURBGTest, AsyncRefillDrawsAreUniform) {
+  SecureURBG::SetAsyncRefill(true);
+  // Enough draws to cycle through the active and standby buffers many times.
+  constexpr int kNumDraws = 200000;
+  double sum = 0;
+  std::thread thread([&sum]() {
+    for (int i = 0; i < kNumDraws; ++i) {
+      sum += UniformDouble();
+    }
+  });
+  thread.join();
+  SecureURBG::SetAsyncRefill(false);
+  EXPECT_NEAR(sum / kNumDraws, 0.5, tolerance);
+}
+
+#ifdef DIFFERENTIAL_PRIVACY_DETERMINISTIC_RNG_FOR_TESTING
+std::vector<uint64_t> DrawWords(int count) {
+  std::vector<uint64_t> words(count);
+  for (uint64_t& word : words) {
+    word = SecureURBG::GetThreadLocal()();
+  }
+  return words;
+}
+
+TEST(ScopedDeterministicRandomnessForTestingTest, SameSeedSameStream) {
+  // More than one buffer worth of words.
+  constexpr int kNumWords = 10000;
+  std::vector<uint64_t> first, second, other_seed;
+  {
+    ScopedDeterministicRandomnessForTesting scope(42);
+    first = DrawWords(kNumWords);
+  }
+  {
+    ScopedDeterministicRandomnessForTesting scope(42);
+    second = DrawWords(kNumWords);
+  }
+  {
+    ScopedDeterministicRandomnessForTesting scope(43);
+    other_seed = DrawWords(kNumWords);
+  }
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, other_seed);
+  EXPECT_NE(DrawWords(kNumWords), first);
+}
+
+TEST(ScopedDeterministicRandomnessForTestingTest, ScopesNest) {
+  SecureURBG* secure = &SecureURBG::GetThreadLocal();
+  {
+    ScopedDeterministicRandomnessForTesting outer(1);
+    SecureURBG* outer_urbg = &SecureURBG::GetThreadLocal();
+    EXPECT_NE(outer_urbg, secure);
+    {
+      ScopedDeterministicRandomnessForTesting inner(2);
+      EXPECT_NE(&SecureURBG::GetThreadLocal(), outer_urbg);
+    }
+    EXPECT_EQ(&SecureURBG::GetThreadLocal(), outer_urbg);
+  }
+  EXPECT_EQ(&SecureURBG::GetThreadLocal(), secure);
+}
+
+TEST(ScopedDeterministicRandomnessForTestingTest, OnlyAffectsCreatingThread) {
+  ScopedDeterministicRandomnessForTesting scope(42);
+  SecureURBG* scoped = &SecureURBG::GetThreadLocal();
+  SecureURBG* other = nullptr;
+  std::thread thread([&other]() { other = &SecureURBG::GetThreadLocal(); });
+  thread.join();
+  EXPECT_NE(scoped, other);
+}
+
+TEST(ScopedDeterministicRandomnessForTestingTest, UniformDoubleIsUniform) {
+  ScopedDeterministicRandomnessForTesting scope(7);
+  RandTest::RunTest(UniformDouble, /*expected_mean=*/0.5,
+                    /*expected_var=*/1.0 / 12.0);
+}
+#endif
+
+#ifndef _WIN32
+// The child process of a fork must not replay the bytes that the parent still
+// has buffered.
+TEST(SecureURBGTest, ForkDoesNotShareBufferedBytes) {
+  for (SecureURBG* urbg :
+       {&SecureURBG::GetThreadLocal(), &SecureURBG::GetSingleton()}) {
+    // Make sure the buffer is filled before forking.
+    (*urbg)();
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      SecureURBG::result_type child_draw = (*urbg)();
+      ssize_t written = write(fds[1], &child_draw, sizeof(child_draw));
+      _exit(written == sizeof(child_draw) ? 0 : 1);
+    }
+    SecureURBG::result_type parent_draw = (*urbg)();
+    SecureURBG::result_type child_draw = 0;
+    ASSERT_EQ(read(fds[0], &child_draw, sizeof(child_draw)),
+              sizeof(child_draw));
+    int status;
+    waitpid(pid, &status, 0);
+    close(fds[0]);
+    close(fds[1]);
+    EXPECT_NE(parent_draw, child_draw);
+  }
+}
+
+TEST(SecureURBGTest, ForkDoesNotShareStandbyBuffer) {
+  SecureURBG::SetAsyncRefill(true);
+  std::thread thread([]() {
+    SecureURBG& urbg = SecureURBG::GetThreadLocal();
+    // Exhaust the first buffer so that the standby buffer gets filled.
+    for (int i = 0; i < 65536 / sizeof(SecureURBG::result_type); ++i) {
+      urbg();
+    }
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      SecureURBG::result_type child_draw = urbg();
+      ssize_t written = write(fds[1], &child_draw, sizeof(child_draw));
+      _exit(written == sizeof(child_draw) ? 0 : 1);
+    }
+    SecureURBG::result_type parent_draw = urbg();
+    SecureURBG::result_type child_draw = 0;
+    ASSERT_EQ(read(fds[0], &child_draw, sizeof(child_draw)),
+              sizeof(child_draw));
+    int status;
+    waitpid(pid, &status, 0);
+    close(fds[0]);
+    close(fds[1]);
+    EXPECT_NE(parent_draw, child_draw);
+  });
+  thread.join();
+  SecureURBG::SetAsyncRefill(false);
+}
+
+TEST(AesCtrDrbgEntropySourceTest, ForkReseeds) {
+  AesCtrDrbgEntropySource source;
+  uint64_t draw;
+  source.Fill(reinterpret_cast<uint8_t*>(&draw), sizeof(draw));
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    uint64_t child_draw;
+    source.Fill(reinterpret_cast<uint8_t*>(&child_draw), sizeof(child_draw));
+    ssize_t written = write(fds[1], &child_draw, sizeof(child_draw));
+    _exit(written == sizeof(child_draw) ? 0 : 1);
+  }
+  uint64_t parent_draw;
+  source.Fill(reinterpret_cast<uint8_t*>(&parent_draw), sizeof(parent_draw));
+  uint64_t child_draw = 0;
+  ASSERT_EQ(read(fds[0], &child_draw, sizeof(child_draw)), sizeof(child_draw));
+  int status;
+  waitpid(pid, &status, 0);
+  close(fds[0]);
+  close(fds[1]);
+  EXPECT_NE(parent_draw, child_draw);
+}
+#endif
+
 }  // namespace
 }  // namespace differential_privacy
@@ -0,0 +1,231 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_SEARCH_WEIGHTS_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_SEARCH_WEIGHTS_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace differential_privacy {
+namespace internal {
+
+// The probability map of the Bayesian search of BinarySearch. The search range
+// [lower, upper] is partitioned into buckets, each holding the probability
+// that the target value is in it. The buckets start as a single one holding
+// all of the probability, and every search iteration splits one bucket in two
+// and scales the buckets below and above some value.
+//
+// The buckets are the nodes of a treap ordered by their lower bounds. Each node
+// holds the total weight of its subtree and a pending multiplier for the
+// subtrees of its children, so that scaling all buckets below or above a value
+// only touches the nodes on one path. Scaling, splitting a bucket and finding
+// the bucket at a cumulative weight take O(log n) expected time for n buckets.
+// The nodes are kept in a vector, which only allocates when it grows.
+class SearchWeights {
+ public:
+  // A subrange [lower, upper) of the search range, its weight, and the total
+  // weight of the buckets up to and including it.
+  struct Bucket {
+    double lower;
+    double upper;
+    double weight;
+    double cumulative;
+  };
+
+  SearchWeights(double lower, double upper) : upper_(upper) {
+    nodes_.reserve(kInitialCapacity);
+    root_ = NewNode(lower, 1);
+  }
+
+  // Number of buckets.
+  int size() const { return nodes_.size(); }
+
+  // Multiplies the weights of the buckets below m by left and the weights of
+  // the others by right, then normalizes the weights so they sum to 1. m must
+  // be the lower bound of a bucket.
+  void Scale(double m, double left, double right) {
+    std::pair<int, int> halves = Split(root_, m);
+    Apply(halves.first, left);
+    Apply(halves.second, right);
+    const double total = Sum(halves.first) + Sum(halves.second);
+    root_ = Merge(halves.first, halves.second);
+    Apply(root_, 1 / total);
+  }
+
+  // Returns the first bucket whose cumulative weight is at least target, or
+  // the last bucket if the total weight is less than target.
+  Bucket FindCumulative(double target) const {
+    Bucket bucket = {0, upper_, 0, 0};
+    // Product of the pending multipliers of the ancestors of node t.
+    double scale = 1;
+    int t = root_;
+    while (true) {
+      const Node& node = nodes_[t];
+      const double child_scale = scale * node.scale;
+      const double left_sum = child_scale * Sum(node.left);
+      if (node.left >= 0 && bucket.cumulative + left_sum >= target) {
+        bucket.upper = node.lower;
+        scale = child_scale;
+        t = node.left;
+        continue;
+      }
+      bucket.cumulative += left_sum;
+      const double weight = scale * node.weight;
+      if (bucket.cumulative + weight >= target || node.right < 0) {
+        bucket.lower = node.lower;
+        bucket.weight = weight;
+        bucket.cumulative += weight;
+        if (node.right >= 0) {
+          bucket.upper = Leftmost(node.right);
+        }
+        return bucket;
+      }
+      bucket.cumulative += weight;
+      scale = child_scale;
+      t = node.right;
+    }
+  }
+
+  // Splits the bucket at value at, lower < at < upper, assuming its weight is
+  // uniformly distributed over its subrange. The bucket must have been
+  // returned by FindCumulative with no changes since.
+  void Split(const Bucket& bucket, double at) {
+    const double width = bucket.upper - bucket.lower;
+    std::pair<int, int> halves = Split(root_, at);
+    SetLastWeight(halves.first, bucket.weight * (at - bucket.lower) / width);
+    const int split =
+        NewNode(at, bucket.weight * (bucket.upper - at) / width);
+    root_ = Merge(Merge(halves.first, split), halves.second);
+  }
+
+ private:
+  // Number of buckets to reserve, enough for the iterations of a typical
+  // search without reallocating.
+  static constexpr int kInitialCapacity = 64;
+
+  struct Node {
+    double lower;
+    // Weight of the bucket and total weight of its subtree, both already
+    // multiplied by scale.
+    double weight;
+    double sum;
+    // Multiplier not yet applied to the subtrees of the children.
+    double scale;
+    uint64_t priority;
+    int left;
+    int right;
+  };
+
+  int NewNode(double lower, double weight) {
+    const int index = nodes_.size();
+    nodes_.push_back({lower, weight, weight, 1, Priority(index), -1, -1});
+    return index;
+  }
+
+  // Deterministic heap priorities, spread by a SplitMix64 finalizer so the
+  // treap stays balanced whatever order the buckets are split in.
+  static uint64_t Priority(uint64_t index) {
+    uint64_t z = index + 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  double Sum(int t) const { return t < 0 ? 0 : nodes_[t].sum; }
+
+  double Leftmost(int t) const {
+    while (nodes_[t].left >= 0) {
+      t = nodes_[t].left;
+    }
+    return nodes_[t].lower;
+  }
+
+  void Apply(int t, double scale) {
+    if (t < 0) return;
+    Node& node = nodes_[t];
+    node.weight *= scale;
+    node.sum *= scale;
+    node.scale *= scale;
+  }
+
+  void Push(int t) {
+    Node& node = nodes_[t];
+    if (node.scale != 1) {
+      Apply(node.left, node.scale);
+      Apply(node.right, node.scale);
+      node.scale = 1;
+    }
+  }
+
+  void Pull(int t) {
+    Node& node = nodes_[t];
+    node.sum = Sum(node.left) + node.weight + Sum(node.right);
+  }
+
+  // Splits the subtree t into the buckets below m and the others.
+  std::pair<int, int> Split(int t, double m) {
+    if (t < 0) return {-1, -1};
+    Push(t);
+    if (nodes_[t].lower < m) {
+      std::pair<int, int> halves = Split(nodes_[t].right, m);
+      nodes_[t].right = halves.first;
+      Pull(t);
+      return {t, halves.second};
+    }
+    std::pair<int, int> halves = Split(nodes_[t].left, m);
+    nodes_[t].left = halves.second;
+    Pull(t);
+    return {halves.first, t};
+  }
+
+  // Merges subtrees a and b, where all buckets of a are below those of b.
+  int Merge(int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    if (nodes_[a].priority > nodes_[b].priority) {
+      Push(a);
+      nodes_[a].right = Merge(nodes_[a].right, b);
+      Pull(a);
+      return a;
+    }
+    Push(b);
+    nodes_[b].left = Merge(a, nodes_[b].left);
+    Pull(b);
+    return b;
+  }
+
+  // Sets the weight of the last bucket of subtree t.
+  void SetLastWeight(int t, double weight) {
+    Push(t);
+    if (nodes_[t].right >= 0) {
+      SetLastWeight(nodes_[t].right, weight);
+    } else {
+      nodes_[t].weight = weight;
+    }
+    Pull(t);
+  }
+
+  double upper_;
+  std::vector<Node> nodes_;
+  int root_;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_SEARCH_WEIGHTS_H_
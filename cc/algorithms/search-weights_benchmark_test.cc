@@ -0,0 +1,76 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cmath>
+#include <cstdint>
+
+#include "benchmark/benchmark.h"
+#include "absl/random/random.h"
+#include "algorithms/search-weights.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+// Time of the weight updates of a Bayesian search. The first argument is the
+// number of iterations, up to kMaxBayesianIterations. Each iteration scales the
+// buckets around the last split point, splits the bucket at the median, and
+// finds the central 99% interval, as BinarySearch does. The updates are
+// decisive and point towards a fixed target, as in a search over many equal
+// inputs. The splits stop once the buckets around the target are as narrow as
+// doubles allow, so the number of buckets is bounded by the resolution. The
+// second argument is 0 for a target of 314.159 in [0, 1000], where this takes
+// about 60 buckets, and 1 for a target of 1e-300 in [0, 1e300], where it takes
+// thousands.
+void BM_SearchIterations(benchmark::State& state) {
+  const int64_t num_iterations = state.range(0);
+  const bool wide = state.range(1);
+  const double upper = wide ? 1e300 : 1000;
+  const double target = wide ? 1e-300 : 314.159;
+  absl::BitGen gen;
+  int num_buckets = 0;
+  for (auto _ : state) {
+    SearchWeights weights(0, upper);
+    double m = upper / 2;
+    weights.Split(weights.FindCumulative(.5), m);
+    for (int64_t i = 0; i < num_iterations; ++i) {
+      const double certainty = absl::Uniform(gen, 0.9, 1.0);
+      const double update_left = m > target ? certainty : 1 - certainty;
+      weights.Scale(m, update_left, 1 - update_left);
+      const SearchWeights::Bucket bucket = weights.FindCumulative(.5);
+      m = (.5 - bucket.cumulative + bucket.weight) / bucket.weight *
+              (bucket.upper - bucket.lower) +
+          bucket.lower;
+      if (bucket.lower < m && m < bucket.upper) {
+        weights.Split(bucket, m);
+      }
+      benchmark::DoNotOptimize(weights.FindCumulative(.005));
+      benchmark::DoNotOptimize(
+          weights.FindCumulative(std::nextafter(.995, 1.0)));
+    }
+    num_buckets = weights.size();
+  }
+  state.SetItemsProcessed(state.iterations() * num_iterations);
+  state.counters["buckets"] = num_buckets;
+}
+BENCHMARK(BM_SearchIterations)
+    ->ArgNames({"iterations", "wide"})
+    ->ArgsProduct({{100, 1000, 10000}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
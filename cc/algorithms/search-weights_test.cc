@@ -0,0 +1,125 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/search-weights.h"
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using Bucket = SearchWeights::Bucket;
+
+void ExpectBucket(const Bucket& bucket, double lower, double upper,
+                  double weight, double cumulative) {
+  EXPECT_DOUBLE_EQ(bucket.lower, lower);
+  EXPECT_DOUBLE_EQ(bucket.upper, upper);
+  EXPECT_DOUBLE_EQ(bucket.weight, weight);
+  EXPECT_DOUBLE_EQ(bucket.cumulative, cumulative);
+}
+
+TEST(SearchWeightsTest, StartsWithOneBucket) {
+  SearchWeights weights(0, 10);
+  EXPECT_EQ(weights.size(), 1);
+  ExpectBucket(weights.FindCumulative(.5), 0, 10, 1, 1);
+}
+
+TEST(SearchWeightsTest, SplitsUniformly) {
+  SearchWeights weights(0, 10);
+  weights.Split(weights.FindCumulative(.5), 4);
+  EXPECT_EQ(weights.size(), 2);
+  ExpectBucket(weights.FindCumulative(.4), 0, 4, .4, .4);
+  ExpectBucket(weights.FindCumulative(.41), 4, 10, .6, 1);
+
+  weights.Split(weights.FindCumulative(.5), 7);
+  EXPECT_EQ(weights.size(), 3);
+  ExpectBucket(weights.FindCumulative(.1), 0, 4, .4, .4);
+  ExpectBucket(weights.FindCumulative(.5), 4, 7, .3, .7);
+  ExpectBucket(weights.FindCumulative(.9), 7, 10, .3, 1);
+}
+
+TEST(SearchWeightsTest, ScalesAndNormalizes) {
+  SearchWeights weights(0, 10);
+  weights.Split(weights.FindCumulative(.5), 5);
+  weights.Split(weights.FindCumulative(.75), 8);
+  // Weights .5, .3 and .2. Scaling by 3 below 5 gives 1.5, .3 and .2.
+  weights.Scale(5, 3, 1);
+  ExpectBucket(weights.FindCumulative(.5), 0, 5, .75, .75);
+  ExpectBucket(weights.FindCumulative(.8), 5, 8, .15, .9);
+  ExpectBucket(weights.FindCumulative(.95), 8, 10, .1, 1);
+}
+
+TEST(SearchWeightsTest, ReturnsLastBucketPastTotalWeight) {
+  SearchWeights weights(0, 10);
+  weights.Split(weights.FindCumulative(.5), 5);
+  ExpectBucket(weights.FindCumulative(2), 5, 10, .5, 1);
+}
+
+// Compares against flat vectors of lower bounds and weights under the
+// operations of a Bayesian search.
+TEST(SearchWeightsTest, MatchesFlatVectors) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::vector<double> lowers = {0};
+  std::vector<double> weights = {1};
+  SearchWeights search_weights(0, 1);
+  for (int i = 0; i < 2000; ++i) {
+    // Split the bucket at a random cumulative weight.
+    const double target = uniform(gen);
+    const Bucket bucket = search_weights.FindCumulative(target);
+    double cumulative = 0;
+    size_t j = 0;
+    while (j + 1 < weights.size() && cumulative + weights[j] < target) {
+      cumulative += weights[j++];
+    }
+    const double upper = j + 1 < lowers.size() ? lowers[j + 1] : 1;
+    ASSERT_EQ(bucket.lower, lowers[j]);
+    ASSERT_EQ(bucket.upper, upper);
+    ASSERT_NEAR(bucket.weight, weights[j], 1e-9);
+    ASSERT_NEAR(bucket.cumulative, cumulative + weights[j], 1e-9);
+
+    const double at = (bucket.lower + bucket.upper) / 2;
+    if (bucket.lower < at && at < bucket.upper) {
+      search_weights.Split(bucket, at);
+      const double w = weights[j];
+      weights[j] = w / 2;
+      lowers.insert(lowers.begin() + j + 1, at);
+      weights.insert(weights.begin() + j + 1, w / 2);
+    }
+    ASSERT_EQ(search_weights.size(), lowers.size());
+
+    // Scale around a random bucket.
+    const size_t k = gen() % lowers.size();
+    const double left = uniform(gen);
+    search_weights.Scale(lowers[k], left, 1 - left);
+    double total = 0;
+    for (size_t l = 0; l < weights.size(); ++l) {
+      weights[l] *= l < k ? left : 1 - left;
+      total += weights[l];
+    }
+    for (double& w : weights) {
+      w /= total;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
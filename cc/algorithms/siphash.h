@@ -0,0 +1,116 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_SIPHASH_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_SIPHASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace differential_privacy {
+namespace internal {
+
+// SipHash-2-4, a pseudorandom function keyed by 128 bits. Unlike an unkeyed
+// hash mixed with a salt, its outputs for distinct messages are
+// indistinguishable from independent uniform values to anyone who does not
+// know the key, so they can be used as random priorities that are the same
+// every time the same message is seen.
+class SipHash {
+ public:
+  // The key is k0 and k1, the little-endian words of the 16 key bytes.
+  SipHash(uint64_t k0, uint64_t k1) : k0_(k0), k1_(k1) {}
+
+  // Returns the 64-bit SipHash-2-4 of the size bytes at data.
+  uint64_t Hash(const void* data, size_t size) const {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    State state(k0_, k1_);
+    const size_t end = size - size % 8;
+    for (size_t i = 0; i < end; i += 8) {
+      state.Compress(LoadWord(bytes + i, 8));
+    }
+    state.Compress(LoadWord(bytes + end, size % 8) |
+                   (static_cast<uint64_t>(size) << 56));
+    return state.Finalize();
+  }
+
+ private:
+  class State {
+   public:
+    State(uint64_t k0, uint64_t k1)
+        : v0_(k0 ^ 0x736f6d6570736575),
+          v1_(k1 ^ 0x646f72616e646f6d),
+          v2_(k0 ^ 0x6c7967656e657261),
+          v3_(k1 ^ 0x7465646279746573) {}
+
+    void Compress(uint64_t m) {
+      v3_ ^= m;
+      Round();
+      Round();
+      v0_ ^= m;
+    }
+
+    uint64_t Finalize() {
+      v2_ ^= 0xff;
+      Round();
+      Round();
+      Round();
+      Round();
+      return v0_ ^ v1_ ^ v2_ ^ v3_;
+    }
+
+   private:
+    static uint64_t Rotl(uint64_t x, int b) {
+      return (x << b) | (x >> (64 - b));
+    }
+
+    void Round() {
+      v0_ += v1_;
+      v1_ = Rotl(v1_, 13) ^ v0_;
+      v0_ = Rotl(v0_, 32);
+      v2_ += v3_;
+      v3_ = Rotl(v3_, 16) ^ v2_;
+      v0_ += v3_;
+      v3_ = Rotl(v3_, 21) ^ v0_;
+      v2_ += v1_;
+      v1_ = Rotl(v1_, 17) ^ v2_;
+      v2_ = Rotl(v2_, 32);
+    }
+
+    uint64_t v0_;
+    uint64_t v1_;
+    uint64_t v2_;
+    uint64_t v3_;
+  };
+
+  // Reads n <= 8 bytes as a little-endian word, whatever the byte order of the
+  // platform.
+  static uint64_t LoadWord(const unsigned char* bytes, size_t n) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < n; ++i) {
+      word |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return word;
+  }
+
+  const uint64_t k0_;
+  const uint64_t k1_;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_SIPHASH_H_
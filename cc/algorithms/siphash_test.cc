@@ -0,0 +1,91 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "algorithms/siphash.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+// The key and messages of the reference test vectors: key bytes 00, ..., 0f
+// and messages 00, ..., n - 1.
+const SipHash& ReferenceHash() {
+  static const SipHash* hash =
+      new SipHash(0x0706050403020100, 0x0f0e0d0c0b0a0908);
+  return *hash;
+}
+
+uint64_t HashOfPrefix(size_t n) {
+  std::vector<unsigned char> message(n);
+  for (size_t i = 0; i < n; ++i) message[i] = i;
+  return ReferenceHash().Hash(message.data(), n);
+}
+
+TEST(SipHashTest, MatchesReferenceVectors) {
+  EXPECT_EQ(HashOfPrefix(0), 0x726fdb47dd0e0e31);
+  EXPECT_EQ(HashOfPrefix(1), 0x74f839c593dc67fd);
+  EXPECT_EQ(HashOfPrefix(15), 0xa129ca6149be45e5);
+}
+
+TEST(SipHashTest, DependsOnKey) {
+  const int64_t message = 1;
+  EXPECT_NE(SipHash(1, 2).Hash(&message, sizeof(message)),
+            SipHash(1, 3).Hash(&message, sizeof(message)));
+  EXPECT_NE(SipHash(1, 2).Hash(&message, sizeof(message)),
+            SipHash(2, 2).Hash(&message, sizeof(message)));
+}
+
+// With a fixed key, the hashes of the (privacy unit, partition) pairs that
+// ContributionBounder ranks must pick every partition as the smallest about
+// equally often. The key is fixed, so the counts are deterministic, and they
+// are compared against a chi-square bound with a p-value of 1e-4 for uniform
+// outcomes.
+TEST(SipHashTest, RanksPartitionsUniformly) {
+  const int num_units = 100000;
+  const int num_partitions = 10;
+  std::vector<int> counts(num_partitions, 0);
+  for (int64_t unit = 0; unit < num_units; ++unit) {
+    int smallest = 0;
+    uint64_t smallest_hash = UINT64_MAX;
+    for (int64_t partition = 0; partition < num_partitions; ++partition) {
+      const int64_t message[2] = {unit, partition};
+      const uint64_t hash = ReferenceHash().Hash(message, sizeof(message));
+      if (hash < smallest_hash) {
+        smallest = partition;
+        smallest_hash = hash;
+      }
+    }
+    ++counts[smallest];
+  }
+  const double expected = static_cast<double>(num_units) / num_partitions;
+  double chi_square = 0;
+  for (int count : counts) {
+    chi_square += (count - expected) * (count - expected) / expected;
+  }
+  // 99.99th percentile of the chi-square distribution with 9 degrees of
+  // freedom.
+  EXPECT_LT(chi_square, 33.72);
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,164 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_SPARSE_BINS_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_SPARSE_BINS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace differential_privacy {
+namespace internal {
+
+// A fixed number of bins holding values of type V, all of them initially 0.
+// Used for the logarithmic histogram of ApproxBounds and the per-bin partial
+// values of the algorithms built on it, of which typically only a few bins are
+// ever non-zero.
+//
+// Only the bins that have been written are stored, in a vector sorted by bin
+// index. Once the stored bins would take more than half the memory of all
+// bins, the values are moved to a dense vector, in which each bin is accessed
+// in constant time.
+template <typename V>
+class SparseBins {
+ public:
+  explicit SparseBins(int size = 0) : size_(size) {}
+
+  // Number of bins, including the ones that are not stored.
+  int size() const { return size_; }
+
+  // Returns the value of the bin, which is 0 for a bin that was never written.
+  V operator[](int index) const {
+    if (dense_) {
+      return values_[index];
+    }
+    auto it = LowerBound(index);
+    return it != entries_.end() && it->index == index ? it->value : V(0);
+  }
+
+  // Returns a mutable reference to the value of the bin, storing the bin if it
+  // is not already. The reference is invalidated by the next call to Mutable.
+  V& Mutable(int index) {
+    if (dense_) {
+      return values_[index];
+    }
+    auto it = LowerBound(index);
+    if (it != entries_.end() && it->index == index) {
+      return it->value;
+    }
+    if (ShouldBeDense(entries_.size() + 1)) {
+      MakeDense();
+      return values_[index];
+    }
+    return entries_.insert(it, Entry{index, V(0)})->value;
+  }
+
+  // Calls f(index, value) for each stored bin in increasing order of index.
+  // Bins that are not stored are 0, but a stored bin can be 0 as well.
+  template <typename F>
+  void ForEachStored(F f) const {
+    if (dense_) {
+      for (int i = 0; i < size_; ++i) {
+        f(i, values_[i]);
+      }
+    } else {
+      for (const Entry& entry : entries_) {
+        f(entry.index, entry.value);
+      }
+    }
+  }
+
+  // Returns the values of all bins.
+  template <typename U = V>
+  std::vector<U> ToVector() const {
+    std::vector<U> result(size_, U(0));
+    ForEachStored([&result](int index, V value) {
+      result[index] = static_cast<U>(value);
+    });
+    return result;
+  }
+
+  // Sets all bins to 0 and releases the memory holding them.
+  void Clear() {
+    dense_ = false;
+    std::vector<Entry>().swap(entries_);
+    std::vector<V>().swap(values_);
+  }
+
+  bool dense() const { return dense_; }
+
+  // Heap memory used for the bins, in bytes.
+  int64_t MemoryUsed() const {
+    return sizeof(Entry) * entries_.capacity() + sizeof(V) * values_.capacity();
+  }
+
+ private:
+  struct Entry {
+    int index;
+    V value;
+  };
+
+  typename std::vector<Entry>::iterator LowerBound(int index) {
+    return entries_.begin() + LowerBoundOffset(index);
+  }
+
+  typename std::vector<Entry>::const_iterator LowerBound(int index) const {
+    return entries_.begin() + LowerBoundOffset(index);
+  }
+
+  // Offset of the first stored bin with an index not less than the given one.
+  // The bins are usually looked up in no particular order, so the search
+  // avoids data-dependent branches, which would mostly be mispredicted.
+  size_t LowerBoundOffset(int index) const {
+    const Entry* first = entries_.data();
+    size_t length = entries_.size();
+    while (length > 1) {
+      size_t half = length / 2;
+      first += (first[half - 1].index < index) * half;
+      length -= half;
+    }
+    return (first - entries_.data()) +
+           (length == 1 && first->index < index ? 1 : 0);
+  }
+
+  bool ShouldBeDense(int64_t num_entries) const {
+    return 2 * sizeof(Entry) * num_entries > sizeof(V) * size_;
+  }
+
+  void MakeDense() {
+    values_.assign(size_, V(0));
+    for (const Entry& entry : entries_) {
+      values_[entry.index] = entry.value;
+    }
+    std::vector<Entry>().swap(entries_);
+    dense_ = true;
+  }
+
+  int size_;
+  bool dense_ = false;
+
+  // Stored bins in increasing order of index, if not dense.
+  std::vector<Entry> entries_;
+
+  // Values of all bins, if dense.
+  std::vector<V> values_;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_SPARSE_BINS_H_
@@ -0,0 +1,113 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/sparse-bins.h"
+
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/random/random.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::Pair;
+
+TEST(SparseBinsTest, StartsEmpty) {
+  SparseBins<int64_t> bins(10);
+  EXPECT_EQ(bins.size(), 10);
+  EXPECT_FALSE(bins.dense());
+  EXPECT_EQ(bins.MemoryUsed(), 0);
+  EXPECT_THAT(bins.ToVector(), ElementsAreArray(std::vector<int64_t>(10, 0)));
+}
+
+TEST(SparseBinsTest, StoresOnlyWrittenBins) {
+  SparseBins<int64_t> bins(100);
+  bins.Mutable(42) += 3;
+  bins.Mutable(7) += 1;
+  bins.Mutable(42) += 2;
+  EXPECT_FALSE(bins.dense());
+  EXPECT_EQ(bins[42], 5);
+  EXPECT_EQ(bins[7], 1);
+  EXPECT_EQ(bins[8], 0);
+
+  std::vector<std::pair<int, int64_t>> stored;
+  bins.ForEachStored(
+      [&stored](int index, int64_t value) { stored.push_back({index, value}); });
+  EXPECT_THAT(stored, ElementsAre(Pair(7, 1), Pair(42, 5)));
+}
+
+TEST(SparseBinsTest, BecomesDenseAboveFillThreshold) {
+  SparseBins<int64_t> bins(64);
+  std::vector<int64_t> expected(64, 0);
+  for (int i = 0; i < 64 && !bins.dense(); i += 3) {
+    bins.Mutable(i) = i + 1;
+    expected[i] = i + 1;
+  }
+  EXPECT_TRUE(bins.dense());
+  EXPECT_THAT(bins.ToVector(), ElementsAreArray(expected));
+}
+
+TEST(SparseBinsTest, SparseUsesLessMemoryThanDense) {
+  SparseBins<double> bins(2048);
+  for (int i = 0; i < 10; ++i) {
+    bins.Mutable(100 * i) = i;
+  }
+  EXPECT_FALSE(bins.dense());
+  EXPECT_LT(bins.MemoryUsed(), 2048 * sizeof(double) / 10);
+}
+
+TEST(SparseBinsTest, MatchesDenseVector) {
+  absl::BitGen gen;
+  SparseBins<int64_t> bins(500);
+  std::vector<int64_t> expected(500, 0);
+  for (int i = 0; i < 2000; ++i) {
+    int index = absl::Uniform(gen, 0, 500);
+    bins.Mutable(index) += i;
+    expected[index] += i;
+    EXPECT_EQ(bins[index], expected[index]);
+  }
+  EXPECT_TRUE(bins.dense());
+  EXPECT_THAT(bins.ToVector(), ElementsAreArray(expected));
+}
+
+TEST(SparseBinsTest, ToVectorConverts) {
+  SparseBins<int64_t> bins(3);
+  bins.Mutable(1) = 4;
+  EXPECT_THAT(bins.ToVector<double>(), ElementsAre(0.0, 4.0, 0.0));
+}
+
+TEST(SparseBinsTest, ClearReleasesMemory) {
+  SparseBins<int64_t> bins(4);
+  for (int i = 0; i < 4; ++i) {
+    bins.Mutable(i) = 1;
+  }
+  EXPECT_TRUE(bins.dense());
+  bins.Clear();
+  EXPECT_FALSE(bins.dense());
+  EXPECT_EQ(bins.MemoryUsed(), 0);
+  EXPECT_EQ(bins.size(), 4);
+  EXPECT_THAT(bins.ToVector(), ElementsAre(0, 0, 0, 0));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
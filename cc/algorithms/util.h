@@ -156,6 +156,25 @@ inline bool SafeCastFromDouble(const double in, T& out) {
   return true;
 }
 
+// Converts between integral types, saturating at the limits of To instead of
+// wrapping around.
+template <typename To, typename From,
+          std::enable_if_t<std::is_integral<To>::value &&
+                           std::is_integral<From>::value>* = nullptr>
+inline To SaturatingCast(From in) {
+  if (in < 0) {
+    if (std::is_unsigned<To>::value) return 0;
+    if (static_cast<intmax_t>(in) <
+        static_cast<intmax_t>(std::numeric_limits<To>::lowest())) {
+      return std::numeric_limits<To>::lowest();
+    }
+  } else if (static_cast<uintmax_t>(in) >
+             static_cast<uintmax_t>(std::numeric_limits<To>::max())) {
+    return std::numeric_limits<To>::max();
+  }
+  return static_cast<To>(in);
+}
+
 template <typename T>
 inline double Mean(const std::vector<T>& v) {
   return std::accumulate(v.begin(), v.end(), 0.0) / v.size();
@@ -298,5 +298,21 @@ TEST(SafeCastFromDoubleTest, ForFloat) {
   EXPECT_TRUE(std::isinf(floating_point));
 }
 
+TEST(SaturatingCastTest, ConvertsValuesInRange) {
+  EXPECT_EQ(SaturatingCast<int32_t>(int64_t{-345}), -345);
+  EXPECT_EQ(SaturatingCast<uint64_t>(int64_t{345}), 345);
+  EXPECT_EQ(SaturatingCast<int64_t>(uint64_t{345}), 345);
+}
+
+TEST(SaturatingCastTest, SaturatesOutOfRangeValues) {
+  EXPECT_EQ(SaturatingCast<int32_t>(std::numeric_limits<int64_t>::max()),
+            std::numeric_limits<int32_t>::max());
+  EXPECT_EQ(SaturatingCast<int32_t>(std::numeric_limits<int64_t>::lowest()),
+            std::numeric_limits<int32_t>::lowest());
+  EXPECT_EQ(SaturatingCast<uint32_t>(int64_t{-1}), 0);
+  EXPECT_EQ(SaturatingCast<int64_t>(std::numeric_limits<uint64_t>::max()),
+            std::numeric_limits<int64_t>::max());
+}
+
 }  // namespace
 }  // namespace differential_privacy
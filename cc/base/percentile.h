@@ -17,7 +17,10 @@
 #ifndef DIFFERENTIAL_PRIVACY_BASE_PERCENTILE_H_
 #define DIFFERENTIAL_PRIVACY_BASE_PERCENTILE_H_
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
+#include <vector>
 
 #include "google/protobuf/repeated_field.h"
 #include "proto/util.h"
@@ -42,10 +45,10 @@ namespace base {
 // this value. This is useful to ascertain when an input list has many
 // instances of the same value, for example.
 //
-// Adding inputs is an O(1) operation. Retrieving a percentile sorts the
-// underlying vector only if there has been an addition since the previous sort.
-// Thus, retrieving a percentile is O(nlog n) worst case and O(log n) if no
-// additional inputs have been added.
+// Adding inputs is an O(1) operation. Retrieving a percentile sorts only the k
+// inputs added since the previous sort and merges them into the already sorted
+// ones. Thus, retrieving a percentile is O(k log k + n) worst case and O(log n)
+// if no additional inputs have been added.
 template <typename T>
 class Percentile {
  public:
@@ -56,13 +59,12 @@ class Percentile {
     // https://stackoverflow.com/questions/61646166/how-to-resolve-fpclassify-ambiguous-call-to-overloaded-function
     if (!std::isnan(static_cast<double>(t))) {
       inputs_.push_back(t);
-      sorted_ = false;
     }
   }
 
   void Reset() {
     inputs_.clear();
-    sorted_ = true;
+    num_sorted_ = 0;
   }
 
   void SerializeToProto(google::protobuf::RepeatedPtrField<ValueType>* values) {
@@ -71,11 +73,10 @@ class Percentile {
     }
   }
 
-  void MergeFromProto(google::protobuf::RepeatedPtrField<ValueType> values) {
-    for (const ValueType v : values) {
-      inputs_.push_back(GetValue<T>(v));
-      sorted_ = false;
-    }
+  void MergeFromProto(
+      const google::protobuf::RepeatedPtrField<ValueType>& values) {
+    std::transform(values.begin(), values.end(), std::back_inserter(inputs_),
+                   [](const ValueType& v) { return GetValue<T>(v); });
   }
 
   int64_t Memory() {
@@ -90,10 +91,13 @@ class Percentile {
       return std::make_pair(0, 1);
     }
 
-    // If something has been added since the last sort, sort again.
-    if (!sorted_) {
-      std::sort(inputs_.begin(), inputs_.end());
-      sorted_ = true;
+    // If something has been added since the last sort, sort the additions and
+    // merge them into the sorted inputs.
+    if (num_sorted_ < inputs_.size()) {
+      auto unsorted = inputs_.begin() + num_sorted_;
+      std::sort(unsorted, inputs_.end());
+      std::inplace_merge(inputs_.begin(), unsorted, inputs_.end());
+      num_sorted_ = inputs_.size();
     }
     auto lb = std::lower_bound(inputs_.begin(), inputs_.end(), t);
     auto ub = std::upper_bound(lb, inputs_.end(), t);
@@ -104,7 +108,8 @@ class Percentile {
 
  private:
   std::vector<T> inputs_;
-  bool sorted_ = true;
+  // inputs_[0, num_sorted_) is sorted; later inputs were added since.
+  size_t num_sorted_ = 0;
 };
 
 }  // namespace base
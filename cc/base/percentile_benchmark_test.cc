@@ -0,0 +1,64 @@
+//
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cstdint>
+
+#include "benchmark/benchmark.h"
+#include "absl/random/random.h"
+#include "base/percentile.h"
+#include "proto/util.h"
+
+namespace differential_privacy {
+namespace base {
+namespace {
+
+// Merges many serialized summaries into one Percentile, as when combining the
+// partial results of many workers. The first argument is the number of
+// summaries, the second the number of values per summary, and the third is 1
+// to retrieve a rank after every merge and 0 to retrieve one only at the end.
+void BM_MergeSummaries(benchmark::State& state) {
+  const int64_t num_summaries = state.range(0);
+  const int64_t summary_size = state.range(1);
+  const bool rank_between_merges = state.range(2);
+  absl::BitGen gen;
+  Percentile<double> source;
+  for (int64_t i = 0; i < summary_size; ++i) {
+    source.Add(absl::Uniform(gen, 0.0, 1.0));
+  }
+  google::protobuf::RepeatedPtrField<ValueType> summary;
+  source.SerializeToProto(&summary);
+
+  for (auto _ : state) {
+    Percentile<double> merged;
+    for (int64_t i = 0; i < num_summaries; ++i) {
+      merged.MergeFromProto(summary);
+      if (rank_between_merges) {
+        benchmark::DoNotOptimize(merged.GetRelativeRank(0.5));
+      }
+    }
+    benchmark::DoNotOptimize(merged.GetRelativeRank(0.5));
+  }
+  state.SetItemsProcessed(state.iterations() * num_summaries * summary_size);
+}
+
+BENCHMARK(BM_MergeSummaries)
+    ->ArgNames({"summaries", "size", "rank"})
+    ->ArgsProduct({{100, 400}, {100000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace base
+}  // namespace differential_privacy
@@ -79,6 +79,34 @@ TYPED_TEST(PercentileTest, LargeInputSet) {
             percentile.GetRelativeRank(num_values));
 }
 
+TYPED_TEST(PercentileTest, InterleavedAddsAndRanks) {
+  Percentile<TypeParam> percentile;
+  int num_values = 1000;
+  for (int i = 0; i < num_values; ++i) {
+    // Adds a permutation of 1, ..., num_values.
+    percentile.Add(i * 7919 % num_values + 1);
+    if (i % 100 == 0) {
+      // Ranks between additions sort only the inputs added since.
+      percentile.GetRelativeRank(i);
+    }
+  }
+  for (int i = 1; i <= num_values; ++i) {
+    EXPECT_EQ(std::make_pair((i - 1.0) / num_values, 1.0 * i / num_values),
+              percentile.GetRelativeRank(i));
+  }
+}
+
+TYPED_TEST(PercentileTest, AddAfterReset) {
+  Percentile<TypeParam> percentile;
+  percentile.Add(3);
+  percentile.Add(1);
+  EXPECT_EQ(std::make_pair(.5, 1.0), percentile.GetRelativeRank(3));
+  percentile.Reset();
+  percentile.Add(2);
+  percentile.Add(0);
+  EXPECT_EQ(std::make_pair(.5, 1.0), percentile.GetRelativeRank(2));
+}
+
 TYPED_TEST(PercentileTest, Reset) {
   Percentile<TypeParam> percentile;
   percentile.Add(1);